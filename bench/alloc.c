@@ -0,0 +1,205 @@
+// Compare arena_alloc_align() against malloc() and free() across size and
+// alignment patterns, on a single thread and on several threads at once.
+// Build and run with `./compile.sh --bench-alloc`.
+//
+// Both paths allocate in batches, like a frame's worth of scratch memory, and
+// then free the whole batch: the arena by restoring a checkpoint of the
+// thread's arena, malloc() by freeing every allocation. The arena zeroes what
+// it allocates, so the malloc() path zeroes it as well.
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "timer.h"
+#include "util.h"
+
+// Payload bytes allocated per thread per pattern and path.
+#define BENCH_BYTES_PER_THREAD	((size_t)1 << 28)
+
+// A batch stays within a thread arena's initial buffer, padding included, so
+// the arena path measures allocation rather than chaining blocks.
+#define BENCH_BATCH_BYTES	(ARENA_THREAD_BUFFER_LENGTH / 2)
+
+#define BENCH_MAX_THREADS	8
+
+// Sizes cycle through a table this long, the same for both paths.
+#define BENCH_SIZES_LENGTH	1024
+
+typedef struct {
+	const char *name;
+	size_t min_size;
+	size_t max_size;
+	size_t alignment;
+} Pattern;
+
+static const Pattern patterns[] = {
+	{ "16 B", 16, 16, 16 },
+	{ "64 B", 64, 64, 16 },
+	{ "256 B", 256, 256, 16 },
+	{ "4 KiB", 4096, 4096, 16 },
+	{ "64 B @ 64", 64, 64, 64 },
+	{ "64 B @ 256", 64, 64, 256 },
+	{ "64 B @ 4 KiB", 64, 64, 4096 },
+	{ "16 B-4 KiB", 16, 4096, 16 },
+	{ "16 B-4 KiB @ 64", 16, 4096, 64 },
+};
+#define PATTERNS_LENGTH	(sizeof(patterns) / sizeof(Pattern))
+
+typedef struct {
+	const Pattern *pattern;
+	const size_t *sizes;
+	bool arena;
+	pthread_barrier_t *barrier;
+	size_t n_allocations;
+	unsigned char sum;
+} Worker;
+
+// Sum of a byte from every allocation, so the compiler can't discard any of
+// them.
+static volatile unsigned char sink;
+
+static void *
+allocate(const Worker *worker, Arena *arena, size_t size)
+{
+	size_t alignment = worker->pattern->alignment;
+	if (worker->arena) return arena_alloc_align(arena, size, alignment);
+
+	// aligned_alloc() requires the size to be a multiple of the alignment.
+	void *p = alignment <= _Alignof(max_align_t) ? malloc(size) :
+		aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+	if (p) memset(p, 0, size);
+	return p;
+}
+
+// Allocate and free a batch, and return the number of allocations.
+static size_t
+run_batch(Worker *worker, size_t first)
+{
+	const Pattern *pattern = worker->pattern;
+	size_t n_batch = MAX(BENCH_BATCH_BYTES / (pattern->max_size + pattern->alignment), 1);
+	unsigned char *allocations[BENCH_BATCH_BYTES / 32];
+	assert(n_batch <= sizeof(allocations) / sizeof(unsigned char *));
+
+	Arena_Checkpoint checkpoint = arena_scratch_begin();
+	for (size_t i = 0; i < n_batch; ++i) {
+		size_t size = worker->sizes[(first + i) % BENCH_SIZES_LENGTH];
+		unsigned char *p = allocate(worker, checkpoint.arena, size);
+		if (!p) {
+			fprintf(stderr, "[ERROR] failed to allocate %zu bytes\n", size);
+			exit(EXIT_FAILURE);
+		}
+		p[size - 1] = (unsigned char)i;
+		worker->sum += p[0] + p[size - 1];
+		allocations[i] = p;
+	}
+
+	if (worker->arena) {
+		arena_restore(checkpoint);
+	} else {
+		for (size_t i = 0; i < n_batch; ++i) free(allocations[i]);
+	}
+	return n_batch;
+}
+
+static void *
+worker_main(void *argument)
+{
+	Worker *worker = argument;
+
+	// Warm up the thread's arena and malloc()'s per-thread caches before the
+	// clock starts.
+	run_batch(worker, 0);
+
+	size_t average_size = (worker->pattern->min_size + worker->pattern->max_size) / 2;
+	size_t target = BENCH_BYTES_PER_THREAD / average_size;
+
+	pthread_barrier_wait(worker->barrier);
+	size_t n = 0;
+	while (n < target) n += run_batch(worker, n);
+	worker->n_allocations = n;
+	return NULL;
+}
+
+// Run the pattern on `n_threads` threads at once, and return the combined
+// throughput in millions of allocations per second.
+static double
+bench(const Pattern *pattern, const size_t *sizes, bool arena, uint32_t n_threads)
+{
+	pthread_barrier_t barrier;
+	pthread_barrier_init(&barrier, NULL, n_threads + 1);
+
+	pthread_t threads[BENCH_MAX_THREADS];
+	Worker workers[BENCH_MAX_THREADS] = {0};
+	for (uint32_t i = 0; i < n_threads; ++i) {
+		workers[i] = (Worker){
+			.pattern = pattern,
+			.sizes = sizes,
+			.arena = arena,
+			.barrier = &barrier,
+		};
+		if (pthread_create(&threads[i], NULL, worker_main, &workers[i]) != 0) {
+			fprintf(stderr, "[ERROR] failed to create benchmark thread\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	pthread_barrier_wait(&barrier);
+	uint64_t start = timer_now();
+	size_t n_allocations = 0;
+	unsigned char sum = 0;
+	for (uint32_t i = 0; i < n_threads; ++i) {
+		pthread_join(threads[i], NULL);
+		n_allocations += workers[i].n_allocations;
+		sum += workers[i].sum;
+	}
+	uint64_t end = timer_now();
+
+	pthread_barrier_destroy(&barrier);
+	sink = sum;
+	return n_allocations / (timer_elapsed_ms(start, end) * 1e3);
+}
+
+// A fixed xorshift sequence, so every run draws the same sizes.
+static void
+fill_sizes(const Pattern *pattern, size_t sizes[BENCH_SIZES_LENGTH])
+{
+	uint32_t state = 0x9e3779b9;
+	for (size_t i = 0; i < BENCH_SIZES_LENGTH; ++i) {
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		sizes[i] = pattern->min_size + state % (pattern->max_size - pattern->min_size + 1);
+	}
+}
+
+int
+main(void)
+{
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	uint32_t n_contended = n_cpus > 1 ? MIN((uint32_t)n_cpus, BENCH_MAX_THREADS) : 2;
+
+	printf("%-18s %8s %12s %12s %8s\n", "pattern", "threads", "arena M/s", "malloc M/s", "speedup");
+	for (size_t i = 0; i < PATTERNS_LENGTH; ++i) {
+		const Pattern *pattern = &patterns[i];
+		size_t sizes[BENCH_SIZES_LENGTH];
+		fill_sizes(pattern, sizes);
+
+		uint32_t thread_counts[] = { 1, n_contended };
+		for (size_t j = 0; j < 2; ++j) {
+			double arena = bench(pattern, sizes, true, thread_counts[j]);
+			double heap = bench(pattern, sizes, false, thread_counts[j]);
+			printf("%-18s %8u %12.1f %12.1f %7.1fx\n", pattern->name, thread_counts[j], arena, heap,
+				arena / heap);
+		}
+	}
+
+	exit(EXIT_SUCCESS);
+}
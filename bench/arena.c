@@ -0,0 +1,74 @@
+// Compare the zeroing and the uninitialized arena allocation paths across
+// allocation size classes. Build and run with `./compile.sh --bench-arena`.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arena.h"
+#include "timer.h"
+
+#define BENCH_ARENA_LENGTH	(16 << 20)
+
+// Bytes allocated per size class per path, so small and large classes take
+// comparable time.
+#define BENCH_BYTES_PER_CLASS	((size_t)1 << 30)
+
+static const size_t size_classes[] = { 16, 64, 256, 1024, 4096, 16384, 65536, 262144 };
+#define SIZE_CLASSES_LENGTH	(sizeof(size_classes) / sizeof(size_t))
+
+// Sum of a byte from every allocation, so the compiler can't discard any of
+// them.
+static volatile unsigned char sink;
+
+// Fill the arena with allocations of `size` bytes, and free it whenever it's
+// full, like a per-frame arena. Returns the average cost of an allocation in
+// nanoseconds.
+static double
+bench(Arena *arena, size_t size, void *(*alloc)(Arena *, size_t))
+{
+	size_t n_allocations = BENCH_BYTES_PER_CLASS / size;
+	size_t per_reset = BENCH_ARENA_LENGTH / size;
+	unsigned char sum = 0;
+
+	arena_free(arena);
+	uint64_t start = timer_now();
+	for (size_t i = 0; i < n_allocations; ++i) {
+		if (i % per_reset == 0) arena_free(arena);
+
+		unsigned char *p = alloc(arena, size);
+		sum += p[size - 1];
+	}
+	uint64_t end = timer_now();
+
+	sink = sum;
+	return timer_elapsed_ms(start, end) * 1e6 / n_allocations;
+}
+
+int
+main(void)
+{
+	void *buffer = malloc(BENCH_ARENA_LENGTH);
+	if (!buffer) {
+		fprintf(stderr, "[ERROR] failed to allocate benchmark arena\n");
+		exit(EXIT_FAILURE);
+	}
+
+	Arena arena = {0};
+	arena_init(&arena, buffer, BENCH_ARENA_LENGTH);
+
+	// Touch every page up front so page faults don't count toward the first
+	// size class.
+	bench(&arena, BENCH_ARENA_LENGTH, arena_alloc);
+
+	printf("%10s %14s %14s %8s\n", "size", "zeroing ns", "uninit ns", "speedup");
+	for (size_t i = 0; i < SIZE_CLASSES_LENGTH; ++i) {
+		size_t size = size_classes[i];
+		double zeroing = bench(&arena, size, arena_alloc);
+		double uninitialized = bench(&arena, size, arena_alloc_uninitialized);
+		printf("%10zu %14.2f %14.2f %7.1fx\n", size, zeroing, uninitialized, zeroing / uninitialized);
+	}
+
+	free(buffer);
+	exit(EXIT_SUCCESS);
+}
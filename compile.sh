@@ -9,10 +9,17 @@ COMPILER="gcc"
 FLAGS="-Wall -Wextra -Werror -pedantic-errors -Wfatal-errors"
 LIBS="-lglfw -lvulkan -ldl -lpthread -lX11 -lXxf86vm -lXrandr -lXi"
 
+SHADERDIR="./shaders"
+SHADER_COMPILER="glslc"
+
 case "$1" in
 	"--debug")
 		FLAGS="${FLAGS} -DDEBUG -g"
 		;;
+	"--bench")
+		# An optimized build for benchmark mode, e.g. `./triangle --bench-frames=1000`.
+		FLAGS="${FLAGS} -O2"
+		;;
 	"--clean")
 		rm -rv $BUILDDIR
 		exit $?
@@ -21,6 +28,27 @@ case "$1" in
 		rm -v $INSTALLDIR/$BIN
 		exit $?
 		;;
+	"--bench-arena")
+		mkdir -p $BUILDDIR
+		$COMPILER $FLAGS -O2 -I$SRCDIR -o $BUILDDIR/bench_arena ./bench/arena.c $SRCDIR/arena.c $SRCDIR/timer.c \
+			-lpthread || exit $?
+		$BUILDDIR/bench_arena
+		exit $?
+		;;
+	"--bench-alloc")
+		mkdir -p $BUILDDIR
+		$COMPILER $FLAGS -O2 -I$SRCDIR -o $BUILDDIR/bench_alloc ./bench/alloc.c $SRCDIR/arena.c $SRCDIR/timer.c \
+			-lpthread || exit $?
+		$BUILDDIR/bench_alloc
+		exit $?
+		;;
+	"--shaders")
+		$SHADER_COMPILER -o $SHADERDIR/vert.spv $SHADERDIR/shader.vert || exit $?
+		$SHADER_COMPILER -o $SHADERDIR/frag.spv $SHADERDIR/shader.frag || exit $?
+		$SHADER_COMPILER -o $SHADERDIR/cull.spv $SHADERDIR/cull.comp || exit $?
+		echo "compiled shaders in '$SHADERDIR'"
+		exit 0
+		;;
 	"--install")
 		install -v -m755 ./$BIN $INSTALLDIR/$BIN
 		exit $?
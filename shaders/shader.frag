@@ -1,8 +1,13 @@
 #version 450
 
+// Specialized per pipeline variant, so the unused path is compiled out
+// instead of branched around.
+layout(constant_id = 0) const bool TRANSLUCENT = false;
+
 layout(location = 0) in vec3 fragColor;
+layout(location = 1) in float fragAlpha;
 layout(location = 0) out vec4 outColor;
 
 void main() {
-	outColor = vec4(fragColor, 1.0);
+	outColor = vec4(fragColor, TRANSLUCENT ? fragAlpha : 1.0);
 }
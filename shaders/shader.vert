@@ -1,20 +1,31 @@
 #version 450
 
-layout(location = 0) out vec3 fragColor;
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
+
+// Per-instance attributes.
+layout(location = 2) in vec2 inOffset;
+layout(location = 3) in float inScale;
+layout(location = 4) in vec3 inInstanceColor;
 
-vec2 positions[3] = vec2[](
-	vec2(0.0, -0.5),
-	vec2(0.5, 0.5),
-	vec2(-0.5, 0.5)
-);
+// Per-draw uniforms, selected with a dynamic offset.
+layout(set = 0, binding = 0) uniform DrawUniforms {
+	vec2 scale;
+	vec2 offset;
+	float depth;
+} draw;
 
-vec3 colors[3] = vec3[](
-	vec3(1.0, 0.0, 0.0),
-	vec3(0.0, 1.0, 0.0),
-	vec3(0.0, 0.0, 1.0)
-);
+// Per-draw push constants.
+layout(push_constant) uniform DrawConstants {
+	vec4 tint;
+} constants;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out float fragAlpha;
 
 void main() {
-	gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-	fragColor = colors[gl_VertexIndex];
+	vec2 position = inPosition * inScale + inOffset;
+	gl_Position = vec4(position * draw.scale + draw.offset, draw.depth, 1.0);
+	fragColor = inColor * inInstanceColor * constants.tint.rgb;
+	fragAlpha = constants.tint.a;
 }
@@ -1,5 +1,7 @@
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
@@ -10,6 +12,30 @@
 #	define DEFAULT_ALIGNMENT	(sizeof(void *) * 2)
 #endif
 
+// Header at the start of every chained block. It saves the state of the
+// buffer that was current before the block, so restoring a checkpoint can
+// walk the chain back.
+struct Arena_Block {
+	Arena_Block *prev;
+	unsigned char *buffer;
+	size_t buffer_length;
+	size_t previous_offset;
+	size_t current_offset;
+};
+
+// Blocks start with their header, padded to keep the buffer after it as
+// aligned as malloc() returned it.
+#define ARENA_BLOCK_HEADER_LENGTH	((sizeof(Arena_Block) + DEFAULT_ALIGNMENT - 1) & ~(DEFAULT_ALIGNMENT - 1))
+
+static _Thread_local Arena thread_arena;
+static _Thread_local bool thread_arena_initialized;
+
+// The key only exists for its destructor, which frees a thread's arena when
+// the thread exits. The main thread's arena lives until the process exits.
+static pthread_once_t thread_arena_key_once = PTHREAD_ONCE_INIT;
+static pthread_key_t thread_arena_key;
+static bool thread_arena_key_created;
+
 static bool
 is_power_of_two(uintptr_t x)
 {
@@ -31,32 +57,110 @@ align(uintptr_t pointer, size_t alignment)
 	return p;
 }
 
-void *
-arena_alloc_align(Arena *arena, size_t size, size_t alignment)
+static void
+update_high_water_mark(Arena *arena)
+{
+	size_t length = arena->previous_blocks_length + arena->current_offset;
+	if (length > arena->high_water_mark) arena->high_water_mark = length;
+}
+
+// Chain a new block that fits at least `size` bytes at `alignment`, and make
+// it the current buffer.
+static bool
+arena_grow(Arena *arena, size_t size, size_t alignment)
 {
-	// Align current offset to the specified alignment by pushing it forward if
-	// necessary.
-	uintptr_t current_pointer = (uintptr_t)arena->buffer + (uintptr_t)arena->current_offset;
-	uintptr_t offset = align(current_pointer, alignment);
-	offset -= (uintptr_t)arena->buffer;
+	size_t buffer_length = size + alignment;
+	if (buffer_length < ARENA_BLOCK_LENGTH) buffer_length = ARENA_BLOCK_LENGTH;
 
-	// Ensure remaining capacity exists in backing buffer.
-	if (offset + size <= arena->buffer_length) {
-		void *p = &arena->buffer[offset];
-		arena->previous_offset = offset;
-		arena->current_offset = offset + size;
+	Arena_Block *block = malloc(ARENA_BLOCK_HEADER_LENGTH + buffer_length);
+	if (!block) return false;
+
+	*block = (Arena_Block){
+		.prev = arena->blocks,
+		.buffer = arena->buffer,
+		.buffer_length = arena->buffer_length,
+		.previous_offset = arena->previous_offset,
+		.current_offset = arena->current_offset,
+	};
 
-		memset(p, 0, size);
-		return p;
+	arena->previous_blocks_length += arena->current_offset;
+	arena->blocks = block;
+	arena->buffer = (unsigned char *)block + ARENA_BLOCK_HEADER_LENGTH;
+	arena->buffer_length = buffer_length;
+	arena->previous_offset = 0;
+	arena->current_offset = 0;
+	return true;
+}
+
+// Free the newest block, and make the buffer before it current again.
+static void
+arena_pop_block(Arena *arena)
+{
+	Arena_Block *block = arena->blocks;
+	assert(block);
+
+	arena->blocks = block->prev;
+	arena->buffer = block->buffer;
+	arena->buffer_length = block->buffer_length;
+	arena->previous_offset = block->previous_offset;
+	arena->current_offset = block->current_offset;
+	arena->previous_blocks_length -= block->current_offset;
+	free(block);
+}
+
+static void *
+arena_push(Arena *arena, size_t size, size_t alignment, bool zero)
+{
+	for (;;) {
+		// Align current offset to the specified alignment by pushing it forward
+		// if necessary.
+		uintptr_t current_pointer = (uintptr_t)arena->buffer + (uintptr_t)arena->current_offset;
+		uintptr_t offset = align(current_pointer, alignment);
+		offset -= (uintptr_t)arena->buffer;
+
+		// Ensure remaining capacity exists in backing buffer.
+		if (offset + size <= arena->buffer_length) {
+			void *p = &arena->buffer[offset];
+			arena->previous_offset = offset;
+			arena->current_offset = offset + size;
+			update_high_water_mark(arena);
+
+			if (zero) memset(p, 0, size);
+			return p;
+		}
+
+		if (!arena->growable || !arena_grow(arena, size, alignment)) break;
 	}
 
+	fprintf(stderr, "[ERROR] arena out of memory: failed to allocate %zu bytes with %zu of %zu bytes in use\n",
+		size, arena->current_offset, arena->buffer_length);
 	return NULL;
 }
 
+void *
+arena_alloc_align(Arena *arena, size_t size, size_t alignment)
+{
+	return arena_push(arena, size, alignment, true);
+}
+
 void *
 arena_alloc(Arena *arena, size_t size)
 {
-	return arena_alloc_align(arena, size, DEFAULT_ALIGNMENT);
+	return arena_push(arena, size, DEFAULT_ALIGNMENT, true);
+}
+
+// Variants of the above that skip zeroing the memory, for callers that
+// overwrite all of it right away, e.g. with the results of a Vulkan query.
+void *
+arena_alloc_align_uninitialized(Arena *arena, size_t size, size_t alignment)
+{
+	return arena_push(arena, size, alignment, false);
+}
+
+void *
+arena_alloc_uninitialized(Arena *arena, size_t size)
+{
+	return arena_push(arena, size, DEFAULT_ALIGNMENT, false);
 }
 
 void
@@ -66,11 +170,25 @@ arena_init(Arena *arena, void *buffer, size_t buffer_length)
 	arena->buffer_length = buffer_length;
 	arena->current_offset = 0;
 	arena->previous_offset = 0;
+	arena->growable = false;
+	arena->blocks = NULL;
+	arena->previous_blocks_length = 0;
+	arena->high_water_mark = 0;
+}
+
+// Initialize an arena that starts out in `buffer`, and chains blocks from the
+// heap once that's full.
+void
+arena_init_growable(Arena *arena, void *buffer, size_t buffer_length)
+{
+	arena_init(arena, buffer, buffer_length);
+	arena->growable = true;
 }
 
 void
 arena_free(Arena *arena)
 {
+	while (arena->blocks) arena_pop_block(arena);
 	arena->current_offset = 0;
 	arena->previous_offset = 0;
 }
@@ -80,6 +198,7 @@ arena_create_checkpoint(Arena *arena)
 {
 	return (Arena_Checkpoint){
 		.arena = arena,
+		.blocks = arena->blocks,
 		.previous_offset = arena->previous_offset,
 		.current_offset = arena->current_offset,
 	};
@@ -88,6 +207,55 @@ arena_create_checkpoint(Arena *arena)
 void
 arena_restore(Arena_Checkpoint checkpoint)
 {
+	// Free every block chained since the checkpoint to get back to the buffer
+	// it was taken in.
+	while (checkpoint.arena->blocks != checkpoint.blocks) arena_pop_block(checkpoint.arena);
+
 	checkpoint.arena->previous_offset = checkpoint.previous_offset;
 	checkpoint.arena->current_offset = checkpoint.current_offset;
 }
+
+static void
+destroy_thread_arena(void *argument)
+{
+	Arena *arena = argument;
+
+	// Freeing the chained blocks makes the initial buffer current again.
+	arena_free(arena);
+	free(arena->buffer);
+	arena_init(arena, NULL, 0);
+	thread_arena_initialized = false;
+}
+
+static void
+create_thread_arena_key(void)
+{
+	thread_arena_key_created = pthread_key_create(&thread_arena_key, destroy_thread_arena) == 0;
+	if (!thread_arena_key_created) {
+		fprintf(stderr, "[WARNING] failed to create thread arena key, thread arenas leak at thread exit\n");
+	}
+}
+
+// Return the calling thread's arena, which is created on first use. It's
+// growable, so it only runs out of memory when malloc() does.
+Arena *
+arena_thread_local(void)
+{
+	if (thread_arena_initialized) return &thread_arena;
+
+	// Without an initial buffer, the arena still works, chaining blocks from
+	// the first allocation on.
+	unsigned char *buffer = malloc(ARENA_THREAD_BUFFER_LENGTH);
+	arena_init_growable(&thread_arena, buffer, buffer ? ARENA_THREAD_BUFFER_LENGTH : 0);
+
+	pthread_once(&thread_arena_key_once, create_thread_arena_key);
+	if (thread_arena_key_created) pthread_setspecific(thread_arena_key, &thread_arena);
+	thread_arena_initialized = true;
+	return &thread_arena;
+}
+
+Arena_Checkpoint
+arena_scratch_begin(void)
+{
+	return arena_create_checkpoint(arena_thread_local());
+}
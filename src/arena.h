@@ -1,25 +1,63 @@
 #ifndef ARENA_H
 #define ARENA_H
 
+#include <stdbool.h>
+#include <stddef.h>
+
+// Default length of the blocks a growable arena chains once its initial buffer
+// is full. Larger allocations get a block of their own size.
+#define ARENA_BLOCK_LENGTH	65536
+
+// Length of the buffer every thread's arena starts out with. It's kept for
+// the life of the thread, so scratch memory that fits never touches malloc().
+#define ARENA_THREAD_BUFFER_LENGTH	65536
+
+typedef struct Arena_Block Arena_Block;
+
 typedef struct {
 	unsigned char *buffer;
 	size_t buffer_length;
 	size_t previous_offset;
 	size_t current_offset;
+
+	// A growable arena chains additional blocks from malloc() when the current
+	// buffer is full, rather than failing. `blocks` is the chain of blocks, the
+	// newest first, and NULL while the initial buffer is in use.
+	bool growable;
+	Arena_Block *blocks;
+
+	// Bytes in use in the blocks before the current buffer.
+	size_t previous_blocks_length;
+
+	// The most bytes that were ever in use at once, across all blocks. It
+	// includes padding for alignment, so it's the length of a single buffer
+	// that would have sufficed.
+	size_t high_water_mark;
 } Arena;
 
 typedef struct {
 	Arena *arena;
+	Arena_Block *blocks;
 	size_t previous_offset;
 	size_t current_offset;
 } Arena_Checkpoint;
 
 void *arena_alloc_align(Arena *arena, size_t size, size_t alignment);
 void *arena_alloc(Arena *arena, size_t size);
+void *arena_alloc_align_uninitialized(Arena *arena, size_t size, size_t alignment);
+void *arena_alloc_uninitialized(Arena *arena, size_t size);
 void arena_init(Arena *arena, void *buffer, size_t buffer_length);
+void arena_init_growable(Arena *arena, void *buffer, size_t buffer_length);
 void arena_free(Arena *arena);
 
 Arena_Checkpoint arena_create_checkpoint(Arena *arena);
 void arena_restore(Arena_Checkpoint checkpoint);
 
+// Every thread has an arena of its own for scratch memory, so threads never
+// contend over it, and nothing needs a lock. Scratch allocations go in
+// between arena_scratch_begin() and an arena_restore() of the checkpoint it
+// returns, which nest like any other checkpoints.
+Arena *arena_thread_local(void);
+Arena_Checkpoint arena_scratch_begin(void);
+
 #endif
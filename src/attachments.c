@@ -0,0 +1,174 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "attachments.h"
+#include "gpu_memory.h"
+#include "image.h"
+
+#define MULTISAMPLE_COLOR_USAGE	(VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+#define DEPTH_USAGE	(VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSIENT_ATTACHMENT_BIT)
+
+// Every implementation supports D16_UNORM, and either X8_D24_UNORM_PACK32 or
+// D32_SFLOAT.
+static const VkFormat depth_formats[] = {
+	VK_FORMAT_D32_SFLOAT,
+	VK_FORMAT_X8_D24_UNORM_PACK32,
+	VK_FORMAT_D32_SFLOAT_S8_UINT,
+	VK_FORMAT_D24_UNORM_S8_UINT,
+	VK_FORMAT_D16_UNORM,
+};
+
+const char *
+depth_format_name(VkFormat format)
+{
+	switch (format) {
+	case VK_FORMAT_D32_SFLOAT: return "D32_SFLOAT";
+	case VK_FORMAT_X8_D24_UNORM_PACK32: return "X8_D24_UNORM_PACK32";
+	case VK_FORMAT_D32_SFLOAT_S8_UINT: return "D32_SFLOAT_S8_UINT";
+	case VK_FORMAT_D24_UNORM_S8_UINT: return "D24_UNORM_S8_UINT";
+	case VK_FORMAT_D16_UNORM: return "D16_UNORM";
+	default: return "unknown";
+	}
+}
+
+bool
+format_has_stencil(VkFormat format)
+{
+	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+static bool
+is_lazily_allocated(const Gpu_Allocator *allocator, const Gpu_Image *image)
+{
+	uint32_t memory_type = image->allocation.memory_type;
+	VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+	return (flags & VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT) != 0;
+}
+
+VkSampleCountFlagBits
+choose_sample_count(const VkPhysicalDeviceLimits *limits, uint32_t requested)
+{
+	VkSampleCountFlags supported = limits->framebufferColorSampleCounts & limits->framebufferDepthSampleCounts;
+
+	VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+	for (uint32_t count = 2; count <= requested && count <= VK_SAMPLE_COUNT_64_BIT; count <<= 1) {
+		if (supported & count) samples = (VkSampleCountFlagBits)count;
+	}
+	return samples;
+}
+
+VkFormat
+choose_depth_format(VkPhysicalDevice physical_device)
+{
+	for (size_t i = 0; i < sizeof(depth_formats) / sizeof(depth_formats[0]); ++i) {
+		VkFormatProperties properties = {0};
+		vkGetPhysicalDeviceFormatProperties(physical_device, depth_formats[i], &properties);
+		if (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT) {
+			return depth_formats[i];
+		}
+	}
+
+	fprintf(stderr, "[ERROR] failed to find a supported depth format\n");
+	exit(EXIT_FAILURE);
+}
+
+void
+render_attachments_init(Render_Attachments *attachments, Gpu_Allocator *allocator, VkFormat color_format,
+	VkFormat depth_format, VkSampleCountFlagBits samples)
+{
+	*attachments = (Render_Attachments){
+		.allocator = allocator,
+		.color_format = color_format,
+		.depth_format = depth_format,
+		.samples = samples,
+	};
+}
+
+void
+render_attachments_create(Render_Attachments *attachments, VkExtent2D extent)
+{
+	render_attachments_destroy(attachments);
+	attachments->extent = extent;
+
+	if (attachments->samples != VK_SAMPLE_COUNT_1_BIT) {
+		attachments->color = gpu_image_create(attachments->allocator, extent, attachments->color_format,
+			MULTISAMPLE_COLOR_USAGE, VK_IMAGE_ASPECT_COLOR_BIT, attachments->samples,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+		attachments->views[attachments->n_views++] = attachments->color.view;
+	}
+
+	// A view of a depth/stencil attachment covers both aspects.
+	VkImageAspectFlags depth_aspect = VK_IMAGE_ASPECT_DEPTH_BIT;
+	if (format_has_stencil(attachments->depth_format)) depth_aspect |= VK_IMAGE_ASPECT_STENCIL_BIT;
+	attachments->depth = gpu_image_create(attachments->allocator, extent, attachments->depth_format, DEPTH_USAGE,
+		depth_aspect, attachments->samples, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+		VK_MEMORY_PROPERTY_LAZILY_ALLOCATED_BIT);
+	attachments->views[attachments->n_views++] = attachments->depth.view;
+
+	attachments->lazily_allocated = is_lazily_allocated(attachments->allocator, &attachments->depth);
+}
+
+void
+render_attachments_destroy(Render_Attachments *attachments)
+{
+	if (attachments->color.handle != VK_NULL_HANDLE) gpu_image_destroy(attachments->allocator, &attachments->color);
+	if (attachments->depth.handle != VK_NULL_HANDLE) gpu_image_destroy(attachments->allocator, &attachments->depth);
+	attachments->lazily_allocated = false;
+	attachments->n_views = 0;
+}
+
+void
+render_attachments_print_costs(const Render_Attachments *attachments, VkSampleCountFlags supported)
+{
+	VkDevice device = attachments->allocator->device;
+	VkExtent2D extent = attachments->extent;
+
+	// Query each sample count on an image that's never bound to memory.
+	for (uint32_t count = 2; count <= VK_SAMPLE_COUNT_64_BIT; count <<= 1) {
+		if (!(supported & count)) continue;
+
+		VkImageCreateInfo image_info = {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = attachments->color_format,
+			.extent = { extent.width, extent.height, 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = (VkSampleCountFlagBits)count,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = MULTISAMPLE_COLOR_USAGE,
+			.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+		VkImage image = VK_NULL_HANDLE;
+		if (vkCreateImage(device, &image_info, NULL, &image) != VK_SUCCESS) continue;
+
+		VkMemoryRequirements requirements = {0};
+		vkGetImageMemoryRequirements(device, image, &requirements);
+		vkDestroyImage(device, image, NULL);
+
+		printf("[INFO] %ux multisampled color attachment at %ux%u: %.2f MiB%s\n", count, extent.width,
+			extent.height, requirements.size / (1024.0 * 1024.0),
+			count == (uint32_t)attachments->samples ? " (in use)" : "");
+	}
+
+	printf("[INFO] depth attachment: %s at %ux%u with %u samples per pixel: %.2f MiB\n",
+		depth_format_name(attachments->depth_format), extent.width, extent.height, (uint32_t)attachments->samples,
+		attachments->depth.allocation.size / (1024.0 * 1024.0));
+
+	if (attachments->lazily_allocated) {
+		// Commitment is tracked per VkDeviceMemory, so this counts the entire
+		// block the images were carved out of, but only transient attachments
+		// can live in lazily allocated memory anyway.
+		VkDeviceSize committed = 0;
+		vkGetDeviceMemoryCommitment(device, attachments->depth.allocation.memory, &committed);
+		printf("[INFO] transient attachments: %.2f MiB of lazily allocated memory committed\n",
+			committed / (1024.0 * 1024.0));
+	} else {
+		printf("[INFO] transient attachments: no lazily allocated memory, fully backed in device memory\n");
+	}
+}
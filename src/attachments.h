@@ -0,0 +1,69 @@
+#ifndef ATTACHMENTS_H
+#define ATTACHMENTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.h"
+#include "image.h"
+
+// Upper bound on the images shared by every framebuffer.
+#define RENDER_ATTACHMENTS_MAX	2
+
+// Images that every framebuffer shares, sized to the render extent. Only one
+// frame renders to them at a time, so one of each is enough however many
+// frames are in flight, and they're rebuilt along with the swapchain.
+typedef struct {
+	Gpu_Allocator *allocator;
+	VkFormat color_format;
+	VkFormat depth_format;
+	VkSampleCountFlagBits samples;
+	VkExtent2D extent;
+
+	// With more than one sample, the subpass renders into this image and
+	// resolves it into the framebuffer's own color image at its end. Its
+	// contents are never stored, so it's transient, and lives in lazily
+	// allocated memory where the device has any -- on tiled GPUs, the samples
+	// then never leave tile memory.
+	Gpu_Image color;
+
+	// The depth image, at the same sample count as the color image. Like it,
+	// it's cleared on load and never stored.
+	Gpu_Image depth;
+
+	// Whether the images above live in lazily allocated memory.
+	bool lazily_allocated;
+
+	// Views in the order they follow the framebuffer's own color image: the
+	// multisampled color image, if any, and the depth image last.
+	uint32_t n_views;
+	VkImageView views[RENDER_ATTACHMENTS_MAX];
+} Render_Attachments;
+
+// Return the highest sample count up to `requested` that framebuffers
+// support for both color and depth.
+VkSampleCountFlagBits choose_sample_count(const VkPhysicalDeviceLimits *limits, uint32_t requested);
+
+const char *depth_format_name(VkFormat format);
+bool format_has_stencil(VkFormat format);
+
+// Return the most precise depth format that the device can render to with
+// optimal tiling. Stencil is unused, so formats without it come first.
+VkFormat choose_depth_format(VkPhysicalDevice physical_device);
+
+void render_attachments_init(Render_Attachments *attachments, Gpu_Allocator *allocator, VkFormat color_format,
+	VkFormat depth_format, VkSampleCountFlagBits samples);
+
+// Create the images for `extent`, replacing any created before. The caller
+// must ensure the GPU no longer uses the old ones.
+void render_attachments_create(Render_Attachments *attachments, VkExtent2D extent);
+void render_attachments_destroy(Render_Attachments *attachments);
+
+// Print the memory a multisampled color image of the current extent takes at
+// each sample count in `supported`, and how much of the images in use the
+// device has actually committed.
+void render_attachments_print_costs(const Render_Attachments *attachments, VkSampleCountFlags supported);
+
+#endif
@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "debug.h"
+#include "gpu_memory.h"
+
+// Buffers shared between several queue families use concurrent sharing,
+// which avoids explicit ownership transfers for the static data this is used
+// for.
+static VkBuffer
+create_buffer_handle(VkDevice device, VkDeviceSize size, VkBufferUsageFlags usage, uint32_t n_queue_families,
+	const uint32_t *queue_families)
+{
+	VkBufferCreateInfo buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+		.size = size,
+		.usage = usage,
+		.sharingMode = n_queue_families > 1 ? VK_SHARING_MODE_CONCURRENT : VK_SHARING_MODE_EXCLUSIVE,
+		.queueFamilyIndexCount = n_queue_families > 1 ? n_queue_families : 0,
+		.pQueueFamilyIndices = n_queue_families > 1 ? queue_families : NULL,
+	};
+
+	VkBuffer buffer = VK_NULL_HANDLE;
+	if (vkCreateBuffer(device, &buffer_info, NULL, &buffer) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create buffer\n");
+		exit(EXIT_FAILURE);
+	}
+	return buffer;
+}
+
+// Create a long-lived buffer with memory from the allocator's free lists.
+Gpu_Buffer
+gpu_buffer_create(Gpu_Allocator *allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+	uint32_t n_queue_families, const uint32_t *queue_families)
+{
+	Gpu_Buffer buffer = {
+		.handle = create_buffer_handle(allocator->device, size, usage, n_queue_families, queue_families),
+		.size = size,
+	};
+
+	VkMemoryRequirements requirements = {0};
+	vkGetBufferMemoryRequirements(allocator->device, buffer.handle, &requirements);
+	if (!gpu_alloc(allocator, &requirements, required, preferred, GPU_RESOURCE_LINEAR, &buffer.allocation)) {
+		fprintf(stderr, "[ERROR] failed to allocate buffer memory\n");
+		exit(EXIT_FAILURE);
+	}
+	vkBindBufferMemory(allocator->device, buffer.handle, buffer.allocation.memory, buffer.allocation.offset);
+
+	return buffer;
+}
+
+// Create a buffer with memory from a linear arena. Its memory is reclaimed
+// along with the arena's, but the buffer itself must still be destroyed.
+Gpu_Buffer
+gpu_buffer_create_in_arena(Gpu_Arena *arena, VkDeviceSize size, VkBufferUsageFlags usage,
+	uint32_t n_queue_families, const uint32_t *queue_families)
+{
+	VkDevice device = arena->allocator->device;
+	Gpu_Buffer buffer = {
+		.handle = create_buffer_handle(device, size, usage, n_queue_families, queue_families),
+		.size = size,
+	};
+
+	VkMemoryRequirements requirements = {0};
+	vkGetBufferMemoryRequirements(device, buffer.handle, &requirements);
+	if (!gpu_arena_alloc(arena, &requirements, GPU_RESOURCE_LINEAR, &buffer.allocation)) {
+		fprintf(stderr, "[ERROR] failed to allocate buffer memory from gpu arena\n");
+		exit(EXIT_FAILURE);
+	}
+	vkBindBufferMemory(device, buffer.handle, buffer.allocation.memory, buffer.allocation.offset);
+
+	return buffer;
+}
+
+void
+gpu_buffer_destroy(Gpu_Allocator *allocator, Gpu_Buffer *buffer)
+{
+	vkDestroyBuffer(allocator->device, buffer->handle, NULL);
+	gpu_free(allocator, &buffer->allocation);
+	*buffer = (Gpu_Buffer){0};
+}
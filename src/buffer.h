@@ -0,0 +1,28 @@
+#ifndef BUFFER_H
+#define BUFFER_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.h"
+
+// A buffer bound to a range of a block owned by a Gpu_Allocator.
+typedef struct {
+	VkBuffer handle;
+	VkDeviceSize size;
+
+	// Host-visible memory stays mapped for the lifetime of the buffer, so
+	// writing to it never costs a vkMapMemory() call; `allocation.mapped` is
+	// NULL otherwise.
+	Gpu_Allocation allocation;
+} Gpu_Buffer;
+
+Gpu_Buffer gpu_buffer_create(Gpu_Allocator *allocator, VkDeviceSize size, VkBufferUsageFlags usage,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred,
+	uint32_t n_queue_families, const uint32_t *queue_families);
+Gpu_Buffer gpu_buffer_create_in_arena(Gpu_Arena *arena, VkDeviceSize size, VkBufferUsageFlags usage,
+	uint32_t n_queue_families, const uint32_t *queue_families);
+void gpu_buffer_destroy(Gpu_Allocator *allocator, Gpu_Buffer *buffer);
+
+#endif
@@ -0,0 +1,268 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "culling.h"
+#include "debug.h"
+#include "gpu_memory.h"
+#include "shader.h"
+
+// Must match the push constants in shaders/cull.comp.
+typedef struct {
+	float draw_scale[2];
+	float draw_offset[2];
+	uint32_t n_instances;
+	uint32_t n_indices;
+	uint32_t compact;
+} Cull_Parameters;
+
+#define CULL_BINDINGS	3
+
+void
+culler_create(Culler *culler, VkDevice device, Gpu_Allocator *allocator, Shader_Cache *shaders,
+	Shader *cull_shader, VkPipelineCache pipeline_cache, uint32_t n_frames, uint32_t n_instances,
+	uint32_t n_indices, VkBuffer instance_buffer, VkDeviceSize instance_region_size,
+	PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count, bool multi_draw_indirect, Arena *arena)
+{
+	*culler = (Culler){
+		.device = device,
+		.n_frames = n_frames,
+		.n_instances = n_instances,
+		.n_indices = n_indices,
+		.draw_indexed_indirect_count = draw_indexed_indirect_count,
+		.multi_draw_indirect = multi_draw_indirect,
+	};
+
+	/* Pipeline. */
+	VkDescriptorSetLayoutBinding bindings[CULL_BINDINGS] = {0};
+	for (uint32_t i = 0; i < CULL_BINDINGS; ++i) {
+		bindings[i] = (VkDescriptorSetLayoutBinding){
+			.binding = i,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		};
+	}
+	VkDescriptorSetLayoutCreateInfo set_layout_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+		.bindingCount = CULL_BINDINGS,
+		.pBindings = bindings,
+	};
+	if (vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &culler->set_layout) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create culling descriptor set layout\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkPushConstantRange push_constant_range = {
+		.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+		.offset = 0,
+		.size = sizeof(Cull_Parameters),
+	};
+	VkPipelineLayoutCreateInfo layout_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+		.setLayoutCount = 1,
+		.pSetLayouts = &culler->set_layout,
+		.pushConstantRangeCount = 1,
+		.pPushConstantRanges = &push_constant_range,
+	};
+	if (vkCreatePipelineLayout(device, &layout_info, NULL, &culler->layout) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create culling pipeline layout\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkComputePipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+		.layout = culler->layout,
+	};
+	VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifier_info = {0};
+	shader_stage_info(shaders, cull_shader, VK_SHADER_STAGE_COMPUTE_BIT, false, &pipeline_info.stage,
+		&identifier_info);
+	if (vkCreateComputePipelines(device, pipeline_cache, 1, &pipeline_info, NULL, &culler->pipeline) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create culling pipeline\n");
+		exit(EXIT_FAILURE);
+	}
+
+	/* Buffers. */
+	culler->commands = arena_alloc(arena, n_frames * sizeof(Gpu_Buffer));
+	culler->counts = arena_alloc(arena, n_frames * sizeof(Gpu_Buffer));
+	culler->descriptor_sets = arena_alloc(arena, n_frames * sizeof(VkDescriptorSet));
+	assert(culler->commands && culler->counts && culler->descriptor_sets);
+
+	for (uint32_t i = 0; i < n_frames; ++i) {
+		culler->commands[i] = gpu_buffer_create(allocator, n_instances * sizeof(VkDrawIndexedIndirectCommand),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, NULL);
+		culler->counts[i] = gpu_buffer_create(allocator, sizeof(uint32_t),
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+				VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, 0, NULL);
+	}
+
+	/* Descriptor sets. */
+	VkDescriptorPoolSize pool_size = {
+		.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+		.descriptorCount = CULL_BINDINGS * n_frames,
+	};
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = n_frames,
+		.poolSizeCount = 1,
+		.pPoolSizes = &pool_size,
+	};
+	if (vkCreateDescriptorPool(device, &pool_info, NULL, &culler->descriptor_pool) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create culling descriptor pool\n");
+		exit(EXIT_FAILURE);
+	}
+
+	for (uint32_t i = 0; i < n_frames; ++i) {
+		VkDescriptorSetAllocateInfo set_info = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+			.descriptorPool = culler->descriptor_pool,
+			.descriptorSetCount = 1,
+			.pSetLayouts = &culler->set_layout,
+		};
+		if (vkAllocateDescriptorSets(device, &set_info, &culler->descriptor_sets[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to allocate culling descriptor set\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// The regions are fixed, so the descriptors never change afterwards.
+		VkDescriptorBufferInfo buffer_infos[CULL_BINDINGS] = {
+			{
+				.buffer = instance_buffer,
+				.offset = i * instance_region_size,
+				.range = instance_region_size,
+			},
+			{
+				.buffer = culler->commands[i].handle,
+				.offset = 0,
+				.range = VK_WHOLE_SIZE,
+			},
+			{
+				.buffer = culler->counts[i].handle,
+				.offset = 0,
+				.range = VK_WHOLE_SIZE,
+			},
+		};
+		VkWriteDescriptorSet writes[CULL_BINDINGS] = {0};
+		for (uint32_t j = 0; j < CULL_BINDINGS; ++j) {
+			writes[j] = (VkWriteDescriptorSet){
+				.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+				.dstSet = culler->descriptor_sets[i],
+				.dstBinding = j,
+				.descriptorCount = 1,
+				.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+				.pBufferInfo = &buffer_infos[j],
+			};
+		}
+		vkUpdateDescriptorSets(device, CULL_BINDINGS, writes, 0, NULL);
+	}
+}
+
+void
+culler_destroy(Culler *culler, Gpu_Allocator *allocator)
+{
+	vkDestroyDescriptorPool(culler->device, culler->descriptor_pool, NULL);
+	for (uint32_t i = 0; i < culler->n_frames; ++i) {
+		gpu_buffer_destroy(allocator, &culler->counts[i]);
+		gpu_buffer_destroy(allocator, &culler->commands[i]);
+	}
+	vkDestroyPipeline(culler->device, culler->pipeline, NULL);
+	vkDestroyPipelineLayout(culler->device, culler->layout, NULL);
+	vkDestroyDescriptorSetLayout(culler->device, culler->set_layout, NULL);
+}
+
+void
+culler_dispatch(Culler *culler, uint32_t frame, const float draw_scale[2], const float draw_offset[2],
+	VkCommandBuffer command_buffer)
+{
+	assert(frame < culler->n_frames);
+
+	bool compact = culler->draw_indexed_indirect_count != NULL;
+
+	// The compacting shader appends to the count, which starts at zero.
+	if (compact) {
+		vkCmdFillBuffer(command_buffer, culler->counts[frame].handle, 0, sizeof(uint32_t), 0);
+
+		VkBufferMemoryBarrier clear_barrier = {
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = culler->counts[frame].handle,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE,
+		};
+		vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+			0, NULL, 1, &clear_barrier, 0, NULL);
+	}
+
+	// NOTE The instances were written by the host before the submission,
+	// which makes them visible to the whole queue without a barrier.
+	Cull_Parameters parameters = {
+		.draw_scale = { draw_scale[0], draw_scale[1] },
+		.draw_offset = { draw_offset[0], draw_offset[1] },
+		.n_instances = culler->n_instances,
+		.n_indices = culler->n_indices,
+		.compact = compact,
+	};
+	vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->pipeline);
+	vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_COMPUTE, culler->layout, 0, 1,
+		&culler->descriptor_sets[frame], 0, NULL);
+	vkCmdPushConstants(command_buffer, culler->layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(Cull_Parameters),
+		&parameters);
+	vkCmdDispatch(command_buffer, (culler->n_instances + CULLING_WORKGROUP_SIZE - 1) / CULLING_WORKGROUP_SIZE, 1, 1);
+
+	// Make the commands and the count visible to the indirect draws.
+	VkBufferMemoryBarrier barriers[] = {
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = culler->commands[frame].handle,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE,
+		},
+		{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+			.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+			.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+			.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+			.buffer = culler->counts[frame].handle,
+			.offset = 0,
+			.size = VK_WHOLE_SIZE,
+		},
+	};
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0,
+		0, NULL, compact ? 2 : 1, barriers, 0, NULL);
+}
+
+void
+culler_draw(const Culler *culler, uint32_t frame, VkCommandBuffer command_buffer)
+{
+	assert(frame < culler->n_frames);
+
+	VkBuffer commands = culler->commands[frame].handle;
+	uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+	if (culler->draw_indexed_indirect_count) {
+		culler->draw_indexed_indirect_count(command_buffer, commands, 0, culler->counts[frame].handle, 0,
+			culler->n_instances, stride);
+	} else if (culler->multi_draw_indirect) {
+		vkCmdDrawIndexedIndirect(command_buffer, commands, 0, culler->n_instances, stride);
+	} else {
+		// Without multiDrawIndirect, an indirect draw reads a single command.
+		for (uint32_t i = 0; i < culler->n_instances; ++i) {
+			vkCmdDrawIndexedIndirect(command_buffer, commands, (VkDeviceSize)i * stride, 1, stride);
+		}
+	}
+}
@@ -0,0 +1,68 @@
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "gpu_memory.h"
+#include "shader.h"
+
+#define CULLING_WORKGROUP_SIZE	64
+
+// GPU-driven drawing of the instances. A compute shader culls the instances
+// against the viewport, and writes one VkDrawIndexedIndirectCommand per
+// instance for the graphics queue to draw indirectly, so the CPU records the
+// same few commands however many instances there are.
+typedef struct {
+	VkDevice device;
+	uint32_t n_frames;
+	uint32_t n_instances;
+	uint32_t n_indices;
+
+	VkDescriptorSetLayout set_layout;
+	VkPipelineLayout layout;
+	VkPipeline pipeline;
+
+	// Each frame culls its own region of the instance ring into its own
+	// command buffers, so frames in flight never share any of them.
+	VkDescriptorPool descriptor_pool;
+	VkDescriptorSet *descriptor_sets;
+	Gpu_Buffer *commands;
+	Gpu_Buffer *counts;
+
+	// vkCmdDrawIndexedIndirectCount() from VK_KHR_draw_indirect_count, or
+	// NULL without it. With it, the compute shader compacts the visible
+	// instances and counts them, and the GPU reads the count. Without it,
+	// every instance keeps a command, and culled ones draw nothing.
+	PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count;
+
+	// Whether a single indirect draw may read several commands.
+	bool multi_draw_indirect;
+} Culler;
+
+// Create the compute pipeline and the per-frame buffers. Frame i culls the
+// `n_instances` instances at `instance_buffer` + i * `instance_region_size`,
+// which must be a multiple of minStorageBufferOffsetAlignment. The arrays are
+// allocated from `arena`.
+void culler_create(Culler *culler, VkDevice device, Gpu_Allocator *allocator, Shader_Cache *shaders,
+	Shader *cull_shader, VkPipelineCache pipeline_cache, uint32_t n_frames, uint32_t n_instances,
+	uint32_t n_indices, VkBuffer instance_buffer, VkDeviceSize instance_region_size,
+	PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count, bool multi_draw_indirect, Arena *arena);
+void culler_destroy(Culler *culler, Gpu_Allocator *allocator);
+
+// Record the culling dispatch for the frame. The instances are transformed by
+// the draws' `draw_scale` and `draw_offset`, as in shaders/shader.vert, before
+// they're tested against the viewport. This must be recorded outside of a
+// render pass, ahead of the frame's culler_draw().
+void culler_dispatch(Culler *culler, uint32_t frame, const float draw_scale[2], const float draw_offset[2],
+	VkCommandBuffer command_buffer);
+
+// Draw the frame's visible instances with the bound graphics pipeline and
+// vertex and index buffers.
+void culler_draw(const Culler *culler, uint32_t frame, VkCommandBuffer command_buffer);
+
+#endif
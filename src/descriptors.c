@@ -0,0 +1,158 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "debug.h"
+#include "descriptors.h"
+#include "gpu_memory.h"
+#include "util.h"
+
+void
+descriptor_allocator_create(Descriptor_Allocator *allocator, VkDevice device, uint32_t n_frames,
+	uint32_t max_sets, uint32_t n_pool_sizes, const VkDescriptorPoolSize *pool_sizes, Arena *arena)
+{
+	*allocator = (Descriptor_Allocator){
+		.device = device,
+		.n_frames = n_frames,
+		.max_sets = max_sets,
+	};
+
+	allocator->pools = arena_alloc(arena, n_frames * sizeof(VkDescriptorPool));
+	allocator->n_allocated = arena_alloc(arena, n_frames * sizeof(uint32_t));
+	assert(allocator->pools && allocator->n_allocated);
+
+	// NOTE Without VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT, the
+	// driver may allocate sets linearly, since they're only ever freed by
+	// resetting the pool.
+	VkDescriptorPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+		.maxSets = max_sets,
+		.poolSizeCount = n_pool_sizes,
+		.pPoolSizes = pool_sizes,
+	};
+	for (uint32_t i = 0; i < n_frames; ++i) {
+		if (vkCreateDescriptorPool(device, &pool_info, NULL, &allocator->pools[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create descriptor pool\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void
+descriptor_allocator_destroy(Descriptor_Allocator *allocator)
+{
+	for (uint32_t i = 0; i < allocator->n_frames; ++i) {
+		vkDestroyDescriptorPool(allocator->device, allocator->pools[i], NULL);
+	}
+}
+
+void
+descriptor_allocator_reset(Descriptor_Allocator *allocator, uint32_t frame)
+{
+	assert(frame < allocator->n_frames);
+	if (allocator->n_allocated[frame] == 0) return;
+
+	vkResetDescriptorPool(allocator->device, allocator->pools[frame], 0);
+	allocator->n_allocated[frame] = 0;
+}
+
+VkDescriptorSet
+descriptor_allocator_allocate(Descriptor_Allocator *allocator, uint32_t frame, VkDescriptorSetLayout set_layout)
+{
+	assert(frame < allocator->n_frames);
+	if (allocator->n_allocated[frame] == allocator->max_sets) {
+		fprintf(stderr, "[ERROR] frame %u allocated more than %u descriptor sets\n", frame, allocator->max_sets);
+		exit(EXIT_FAILURE);
+	}
+
+	VkDescriptorSetAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+		.descriptorPool = allocator->pools[frame],
+		.descriptorSetCount = 1,
+		.pSetLayouts = &set_layout,
+	};
+	VkDescriptorSet set = VK_NULL_HANDLE;
+	if (vkAllocateDescriptorSets(allocator->device, &allocate_info, &set) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to allocate descriptor set\n");
+		exit(EXIT_FAILURE);
+	}
+
+	++allocator->n_allocated[frame];
+	return set;
+}
+
+static VkDeviceSize
+align_up(VkDeviceSize size, VkDeviceSize alignment)
+{
+	return (size + alignment - 1) / alignment * alignment;
+}
+
+void
+uniform_ring_create(Uniform_Ring *ring, Gpu_Allocator *allocator, const VkPhysicalDeviceLimits *limits,
+	VkDeviceSize region_size, uint32_t n_frames)
+{
+	VkDeviceSize alignment = MAX(limits->minUniformBufferOffsetAlignment, 1);
+	*ring = (Uniform_Ring){
+		.n_frames = n_frames,
+		.region_size = align_up(region_size, alignment),
+		.alignment = alignment,
+	};
+
+	// Prefer memory that's both device-local and host-visible, e.g. with
+	// resizable BAR, like the instance ring does.
+	ring->buffer = gpu_buffer_create(allocator, n_frames * ring->region_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, NULL);
+	assert(ring->buffer.allocation.mapped);
+}
+
+void
+uniform_ring_destroy(Uniform_Ring *ring, Gpu_Allocator *allocator)
+{
+	gpu_buffer_destroy(allocator, &ring->buffer);
+}
+
+void
+uniform_ring_reset(Uniform_Ring *ring, uint32_t frame)
+{
+	assert(frame < ring->n_frames);
+	ring->frame = frame;
+	ring->offset = 0;
+}
+
+VkDeviceSize
+uniform_ring_aligned_size(const Uniform_Ring *ring, VkDeviceSize size)
+{
+	return align_up(size, ring->alignment);
+}
+
+void *
+uniform_ring_push(Uniform_Ring *ring, VkDeviceSize size, uint32_t *dynamic_offset)
+{
+	VkDeviceSize aligned_size = uniform_ring_aligned_size(ring, size);
+	if (ring->offset + aligned_size > ring->region_size) {
+		fprintf(stderr, "[ERROR] uniform ring out of memory: failed to push %" PRIu64 " bytes with %" PRIu64
+			" of %" PRIu64 " bytes in use\n", (uint64_t)size, (uint64_t)ring->offset, (uint64_t)ring->region_size);
+		exit(EXIT_FAILURE);
+	}
+
+	*dynamic_offset = (uint32_t)ring->offset;
+	void *p = (unsigned char *)ring->buffer.allocation.mapped + ring->frame * ring->region_size + ring->offset;
+	ring->offset += aligned_size;
+	return p;
+}
+
+VkDescriptorBufferInfo
+uniform_ring_descriptor(const Uniform_Ring *ring, uint32_t frame, VkDeviceSize range)
+{
+	return (VkDescriptorBufferInfo){
+		.buffer = ring->buffer.handle,
+		.offset = frame * ring->region_size,
+		.range = range,
+	};
+}
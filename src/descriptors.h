@@ -0,0 +1,78 @@
+#ifndef DESCRIPTORS_H
+#define DESCRIPTORS_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "gpu_memory.h"
+
+// A descriptor pool per frame in flight. Sets are allocated from the frame's
+// pool while the frame is recorded, and the whole pool is reset at once when
+// the frame comes around again, just like the frame arena. Sets are never
+// freed one by one.
+typedef struct {
+	VkDevice device;
+	uint32_t n_frames;
+	uint32_t max_sets;
+
+	VkDescriptorPool *pools;
+
+	// Sets allocated from each pool since its last reset.
+	uint32_t *n_allocated;
+} Descriptor_Allocator;
+
+// Create pools that each hold up to `max_sets` sets with the given number of
+// descriptors of each type. The arrays are allocated from `arena`.
+void descriptor_allocator_create(Descriptor_Allocator *allocator, VkDevice device, uint32_t n_frames,
+	uint32_t max_sets, uint32_t n_pool_sizes, const VkDescriptorPoolSize *pool_sizes, Arena *arena);
+void descriptor_allocator_destroy(Descriptor_Allocator *allocator);
+
+// Free every set of the frame. The frame's previous submission must be
+// complete.
+void descriptor_allocator_reset(Descriptor_Allocator *allocator, uint32_t frame);
+
+VkDescriptorSet descriptor_allocator_allocate(Descriptor_Allocator *allocator, uint32_t frame,
+	VkDescriptorSetLayout set_layout);
+
+// Uniform data for the frames in flight, in a single persistently mapped
+// buffer with a region per frame. Data is pushed linearly into the frame's
+// region, and is addressed with dynamic offsets into the region, so a single
+// VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC descriptor serves every push.
+typedef struct {
+	Gpu_Buffer buffer;
+	uint32_t n_frames;
+
+	// Both are multiples of minUniformBufferOffsetAlignment, as dynamic
+	// offsets have to be.
+	VkDeviceSize region_size;
+	VkDeviceSize alignment;
+
+	uint32_t frame;
+	VkDeviceSize offset;
+} Uniform_Ring;
+
+void uniform_ring_create(Uniform_Ring *ring, Gpu_Allocator *allocator, const VkPhysicalDeviceLimits *limits,
+	VkDeviceSize region_size, uint32_t n_frames);
+void uniform_ring_destroy(Uniform_Ring *ring, Gpu_Allocator *allocator);
+
+// Start pushing into the frame's region. The frame's previous submission must
+// be complete.
+void uniform_ring_reset(Uniform_Ring *ring, uint32_t frame);
+
+// Return the space that pushing `size` bytes takes up, i.e. the distance
+// between the dynamic offsets of consecutive pushes of that size.
+VkDeviceSize uniform_ring_aligned_size(const Uniform_Ring *ring, VkDeviceSize size);
+
+// Reserve `size` bytes in the current frame's region, and return where to
+// write them. Their dynamic offset relative to the region is stored in
+// `dynamic_offset`.
+void *uniform_ring_push(Uniform_Ring *ring, VkDeviceSize size, uint32_t *dynamic_offset);
+
+// Describe the given frame's region for a dynamic uniform buffer descriptor
+// whose uniform block is `range` bytes long.
+VkDescriptorBufferInfo uniform_ring_descriptor(const Uniform_Ring *ring, uint32_t frame, VkDeviceSize range);
+
+#endif
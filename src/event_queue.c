@@ -0,0 +1,124 @@
+#include <errno.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "event_queue.h"
+
+void
+event_queue_init(Event_Queue *queue)
+{
+	atomic_init(&queue->tail, 0);
+	queue->n_dropped = 0;
+	atomic_init(&queue->head, 0);
+	atomic_init(&queue->framebuffer_size, 0);
+	atomic_init(&queue->resized, false);
+	atomic_init(&queue->close_requested, false);
+
+	if (sem_init(&queue->wakeup, 0, 0) != 0) {
+		fprintf(stderr, "[ERROR] failed to create event queue semaphore\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+event_queue_destroy(Event_Queue *queue)
+{
+	sem_destroy(&queue->wakeup);
+}
+
+// NOTE sem_post() only enters the kernel when the consumer is asleep in
+// event_queue_wait(), so posting stays cheap while it's busy rendering.
+static void
+wake_consumer(Event_Queue *queue)
+{
+	sem_post(&queue->wakeup);
+}
+
+bool
+event_queue_push(Event_Queue *queue, const Event *event)
+{
+	// Only the producer writes the tail, so it reads its own writes relaxed.
+	// The head has to be acquired so the slot it frees isn't overwritten
+	// before the consumer is done reading it.
+	uint_fast32_t tail = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+	uint_fast32_t head = atomic_load_explicit(&queue->head, memory_order_acquire);
+	if (tail - head == EVENT_QUEUE_CAPACITY) {
+		++queue->n_dropped;
+		return false;
+	}
+
+	queue->events[tail & (EVENT_QUEUE_CAPACITY - 1)] = *event;
+
+	// Publish the event itself along with the new tail.
+	atomic_store_explicit(&queue->tail, tail + 1, memory_order_release);
+	wake_consumer(queue);
+	return true;
+}
+
+void
+event_queue_post_resize(Event_Queue *queue, uint32_t width, uint32_t height)
+{
+	atomic_store_explicit(&queue->framebuffer_size, (uint_fast64_t)width << 32 | height, memory_order_relaxed);
+	atomic_store_explicit(&queue->resized, true, memory_order_release);
+	wake_consumer(queue);
+}
+
+void
+event_queue_post_close(Event_Queue *queue)
+{
+	atomic_store_explicit(&queue->close_requested, true, memory_order_release);
+	wake_consumer(queue);
+}
+
+bool
+event_queue_pop(Event_Queue *queue, Event *event)
+{
+	uint_fast32_t head = atomic_load_explicit(&queue->head, memory_order_relaxed);
+	uint_fast32_t tail = atomic_load_explicit(&queue->tail, memory_order_acquire);
+	if (head == tail) return false;
+
+	*event = queue->events[head & (EVENT_QUEUE_CAPACITY - 1)];
+	atomic_store_explicit(&queue->head, head + 1, memory_order_release);
+	return true;
+}
+
+bool
+event_queue_take_resize(Event_Queue *queue, uint32_t *width, uint32_t *height)
+{
+	if (!atomic_exchange_explicit(&queue->resized, false, memory_order_acquire)) return false;
+
+	// NOTE A resize posted between the exchange and this load is taken early,
+	// and taken again on the next call, which is harmless.
+	uint_fast64_t size = atomic_load_explicit(&queue->framebuffer_size, memory_order_relaxed);
+	*width = (uint32_t)(size >> 32);
+	*height = (uint32_t)size;
+	return true;
+}
+
+bool
+event_queue_close_requested(Event_Queue *queue)
+{
+	return atomic_load_explicit(&queue->close_requested, memory_order_acquire);
+}
+
+void
+event_queue_wait(Event_Queue *queue, double timeout)
+{
+	// sem_timedwait() only takes a deadline on the realtime clock.
+	struct timespec deadline = {0};
+	clock_gettime(CLOCK_REALTIME, &deadline);
+	uint64_t ns = (uint64_t)deadline.tv_nsec + (uint64_t)(timeout * 1e9);
+	deadline.tv_sec += ns / 1000000000ull;
+	deadline.tv_nsec = ns % 1000000000ull;
+
+	while (sem_timedwait(&queue->wakeup, &deadline) != 0 && errno == EINTR);
+
+	// Every post that arrived meanwhile is handled along with the one that
+	// woke the consumer, so don't let them wake it again one by one.
+	while (sem_trywait(&queue->wakeup) == 0);
+}
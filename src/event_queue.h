@@ -0,0 +1,86 @@
+#ifndef EVENT_QUEUE_H
+#define EVENT_QUEUE_H
+
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Must be a power of two.
+#define EVENT_QUEUE_CAPACITY	256
+
+// Keep the fields each side writes on cache lines of their own, so the
+// producer and the consumer don't contend over them.
+#define EVENT_QUEUE_CACHE_LINE	64
+
+typedef enum {
+	EVENT_KEY,
+	EVENT_CURSOR_POSITION,
+	EVENT_MOUSE_BUTTON,
+	EVENT_FOCUS,
+	EVENT_REFRESH,
+} Event_Type;
+
+typedef struct {
+	Event_Type type;
+
+	// When the event was posted, as a timer_now() timestamp.
+	uint64_t time;
+
+	union {
+		struct { int key, scancode, action, mods; } key;
+		struct { double x, y; } cursor_position;
+		struct { int button, action, mods; } mouse_button;
+		int focused;
+	};
+} Event;
+
+// A lock-free queue of window events from a single producer, the thread that
+// pumps GLFW events, to a single consumer, the thread that renders. They may
+// be the same thread.
+//
+// Input events are queued in order, and dropped if the consumer falls so far
+// behind that the queue is full. Resizes and close requests can't be dropped,
+// so they skip the queue: they're posted to slots of their own where the
+// latest one replaces any the consumer hasn't taken yet.
+typedef struct {
+	// Written by the producer.
+	_Alignas(EVENT_QUEUE_CACHE_LINE) atomic_uint_fast32_t tail;
+	uint64_t n_dropped;
+
+	// Written by the consumer.
+	_Alignas(EVENT_QUEUE_CACHE_LINE) atomic_uint_fast32_t head;
+
+	// The latest framebuffer size, packed as width << 32 | height, and
+	// whether it changed since the consumer last took it.
+	_Alignas(EVENT_QUEUE_CACHE_LINE) atomic_uint_fast64_t framebuffer_size;
+	atomic_bool resized;
+	atomic_bool close_requested;
+
+	// Counts posts, so the consumer can sleep until the next one.
+	sem_t wakeup;
+
+	Event events[EVENT_QUEUE_CAPACITY];
+} Event_Queue;
+
+void event_queue_init(Event_Queue *queue);
+void event_queue_destroy(Event_Queue *queue);
+
+// Producer side. Return whether the event was queued.
+bool event_queue_push(Event_Queue *queue, const Event *event);
+void event_queue_post_resize(Event_Queue *queue, uint32_t width, uint32_t height);
+void event_queue_post_close(Event_Queue *queue);
+
+// Consumer side. Pop the oldest queued event, or return false if there are
+// none.
+bool event_queue_pop(Event_Queue *queue, Event *event);
+
+// Take the latest framebuffer size if it changed since the last call.
+bool event_queue_take_resize(Event_Queue *queue, uint32_t *width, uint32_t *height);
+bool event_queue_close_requested(Event_Queue *queue);
+
+// Sleep until anything is posted, or until the timeout in seconds expires.
+// Whatever was posted before this returns is visible to the calls above.
+void event_queue_wait(Event_Queue *queue, double timeout);
+
+#endif
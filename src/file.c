@@ -0,0 +1,91 @@
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "file.h"
+
+bool
+map_file(const char *filename, Mapped_File *file)
+{
+	*file = (Mapped_File){0};
+
+	int fd = open(filename, O_RDONLY);
+	if (fd == -1) return false;
+
+	struct stat st = {0};
+	if (fstat(fd, &st) == -1 || st.st_size == 0) {
+		close(fd);
+		return false;
+	}
+
+	void *contents = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+	// The mapping remains valid after the file descriptor is closed.
+	close(fd);
+	if (contents == MAP_FAILED) return false;
+
+	file->length = st.st_size;
+	file->contents = contents;
+	return true;
+}
+
+void
+unmap_file(Mapped_File *file)
+{
+	if (file->contents) munmap(file->contents, file->length);
+	*file = (Mapped_File){0};
+}
+
+// Read one byte of every page of the mapping, so that whoever reads it next
+// doesn't block on the disk.
+void
+prefault_file(const Mapped_File *file)
+{
+	long page_length = sysconf(_SC_PAGESIZE);
+	if (page_length <= 0) return;
+
+	const volatile unsigned char *bytes = file->contents;
+	for (size_t i = 0; i < file->length; i += (size_t)page_length) (void)bytes[i];
+}
+
+bool
+write_file_atomic(const char *filename, const void *contents, size_t length)
+{
+	char temporary_filename[4096] = {0};
+	int n = snprintf(temporary_filename, sizeof(temporary_filename), "%s.tmp", filename);
+	if (n < 0 || (size_t)n >= sizeof(temporary_filename)) return false;
+
+	int fd = open(temporary_filename, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (fd == -1) return false;
+
+	const unsigned char *p = contents;
+	size_t remaining = length;
+	while (remaining > 0) {
+		ssize_t written = write(fd, p, remaining);
+		if (written == -1) {
+			close(fd);
+			unlink(temporary_filename);
+			return false;
+		}
+		p += written;
+		remaining -= written;
+	}
+
+	// Flush the data to disk before the rename so a crash can't leave behind a
+	// truncated file under the final name.
+	bool synced = fsync(fd) == 0;
+	if (close(fd) == -1 || !synced) {
+		unlink(temporary_filename);
+		return false;
+	}
+
+	if (rename(temporary_filename, filename) == -1) {
+		unlink(temporary_filename);
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,22 @@
+#ifndef FILE_H
+#define FILE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct {
+	size_t length;
+	void *contents;
+} Mapped_File;
+
+// Map the entire file read-only into memory. A missing file is not fatal;
+// the caller checks the return value instead.
+bool map_file(const char *filename, Mapped_File *file);
+void unmap_file(Mapped_File *file);
+void prefault_file(const Mapped_File *file);
+
+// Replace the contents of a file such that readers observe either the old
+// contents or the new contents, never a partial write.
+bool write_file_atomic(const char *filename, const void *contents, size_t length);
+
+#endif
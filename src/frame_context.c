@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "frame_context.h"
+
+void
+frame_context_create(Frame_Context *context, VkDevice device, uint32_t queue_family,
+	VkCommandBufferLevel level)
+{
+	*context = (Frame_Context){
+		.device = device,
+		.level = level,
+	};
+
+	// Without VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, the driver may
+	// manage the pool's memory as a single linear allocator.
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
+		.queueFamilyIndex = queue_family,
+	};
+	if (vkCreateCommandPool(device, &pool_info, NULL, &context->command_pool) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create command pool\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+void
+frame_context_destroy(Frame_Context *context)
+{
+	// Destroying the pool frees its command buffers too.
+	vkDestroyCommandPool(context->device, context->command_pool, NULL);
+	*context = (Frame_Context){0};
+}
+
+void
+frame_context_reset(Frame_Context *context)
+{
+	// Skip the call for frames that never recorded anything.
+	if (context->n_used == 0) return;
+
+	vkResetCommandPool(context->device, context->command_pool, 0);
+	context->n_used = 0;
+}
+
+VkCommandBuffer
+frame_context_allocate(Frame_Context *context)
+{
+	if (context->n_used == context->n_command_buffers) {
+		if (context->n_command_buffers == FRAME_CONTEXT_MAX_COMMAND_BUFFERS) {
+			fprintf(stderr, "[ERROR] too many command buffers in a single frame\n");
+			exit(EXIT_FAILURE);
+		}
+
+		VkCommandBufferAllocateInfo command_buffer_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+			.commandPool = context->command_pool,
+			.level = context->level,
+			.commandBufferCount = 1,
+		};
+		VkCommandBuffer *command_buffer = &context->command_buffers[context->n_command_buffers];
+		if (vkAllocateCommandBuffers(context->device, &command_buffer_info, command_buffer) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to allocate command buffer\n");
+			exit(EXIT_FAILURE);
+		}
+		++context->n_command_buffers;
+	}
+
+	return context->command_buffers[context->n_used++];
+}
@@ -0,0 +1,39 @@
+#ifndef FRAME_CONTEXT_H
+#define FRAME_CONTEXT_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#define FRAME_CONTEXT_MAX_COMMAND_BUFFERS	8
+
+// The command buffers of a single frame in flight, which all share its
+// lifetime. They're allocated linearly from a transient command pool, and the
+// whole pool is reset at once when the frame comes around again, much like
+// restoring an arena checkpoint. Command buffers are kept across resets, so
+// steady-state frames allocate nothing from the driver.
+typedef struct {
+	VkDevice device;
+	VkCommandPool command_pool;
+	VkCommandBufferLevel level;
+
+	VkCommandBuffer command_buffers[FRAME_CONTEXT_MAX_COMMAND_BUFFERS];
+	uint32_t n_command_buffers;
+
+	// Command buffers handed out since the last reset.
+	uint32_t n_used;
+} Frame_Context;
+
+void frame_context_create(Frame_Context *context, VkDevice device, uint32_t queue_family,
+	VkCommandBufferLevel level);
+void frame_context_destroy(Frame_Context *context);
+
+// Return every command buffer of the frame to the initial state. The frame's
+// previous submission must be complete.
+void frame_context_reset(Frame_Context *context);
+
+// Return the next unused command buffer of the frame, which is ready to begin
+// recording.
+VkCommandBuffer frame_context_allocate(Frame_Context *context);
+
+#endif
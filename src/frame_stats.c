@@ -0,0 +1,201 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "file.h"
+#include "frame_stats.h"
+#include "util.h"
+
+#define FRAME_SUMMARY_BUFFER_LENGTH	4096
+
+void
+frame_stats_init(Frame_Stats *stats, uint32_t capacity, Arena *arena)
+{
+	assert(capacity > 0);
+
+	*stats = (Frame_Stats){
+		.capacity = capacity,
+	};
+	stats->frame_ms = arena_alloc_uninitialized(arena, capacity * sizeof(double));
+	assert(stats->frame_ms);
+}
+
+void
+frame_stats_add(Frame_Stats *stats, double frame_ms)
+{
+	stats->frame_ms[stats->n_frames % stats->capacity] = frame_ms;
+	++stats->n_frames;
+}
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+	double x = *(const double *)a;
+	double y = *(const double *)b;
+	return (x > y) - (x < y);
+}
+
+// The nearest-rank percentile of sorted values.
+static double
+percentile(const double *sorted, uint32_t n, uint32_t p)
+{
+	uint32_t rank = (uint32_t)(((uint64_t)p * n + 99) / 100);
+	return sorted[MAX(rank, 1) - 1];
+}
+
+bool
+frame_stats_summarize(const Frame_Stats *stats, Arena *arena, Frame_Summary *summary)
+{
+	uint32_t n = (uint32_t)MIN(stats->n_frames, stats->capacity);
+	if (n == 0) return false;
+
+	Arena_Checkpoint checkpoint = arena_create_checkpoint(arena);
+	double *sorted = arena_alloc_uninitialized(arena, n * sizeof(double));
+	assert(sorted);
+	memcpy(sorted, stats->frame_ms, n * sizeof(double));
+	qsort(sorted, n, sizeof(double), compare_doubles);
+
+	double sum = 0.0;
+	for (uint32_t i = 0; i < n; ++i) sum += sorted[i];
+
+	*summary = (Frame_Summary){
+		.n_frames = n,
+		.mean_ms = sum / n,
+		.median_ms = n % 2 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2.0,
+		.p95_ms = percentile(sorted, n, 95),
+		.p99_ms = percentile(sorted, n, 99),
+		.max_ms = sorted[n - 1],
+		.fps = sum > 0.0 ? n / (sum / 1e3) : 0.0,
+	};
+
+	arena_restore(checkpoint);
+	return true;
+}
+
+void
+frame_summary_print(const Frame_Summary *summary)
+{
+	printf("[INFO] %u frames: mean %.3f ms, median %.3f ms, p95 %.3f ms, p99 %.3f ms, max %.3f ms, %.1f fps\n",
+		summary->n_frames, summary->mean_ms, summary->median_ms, summary->p95_ms, summary->p99_ms,
+		summary->max_ms, summary->fps);
+}
+
+static bool
+has_suffix(const char *s, const char *suffix)
+{
+	size_t length = strlen(s);
+	size_t suffix_length = strlen(suffix);
+	return length >= suffix_length && strcmp(s + length - suffix_length, suffix) == 0;
+}
+
+// Append `s` to `buffer` as a JSON string, escaping quotes, backslashes, and
+// control characters. This fails once the buffer is full.
+static bool
+append_json_string(char *buffer, size_t capacity, size_t *length, const char *s)
+{
+	size_t n = *length;
+	if (n >= capacity) return false;
+	buffer[n++] = '"';
+	for (; *s; ++s) {
+		unsigned char c = *s;
+		const char *escape = NULL;
+		if (c == '"') escape = "\\\"";
+		else if (c == '\\') escape = "\\\\";
+		else if (c == '\n') escape = "\\n";
+		else if (c == '\t') escape = "\\t";
+
+		if (escape) {
+			if (n + 2 >= capacity) return false;
+			memcpy(buffer + n, escape, 2);
+			n += 2;
+		} else if (c < 0x20) {
+			if (n + 6 >= capacity) return false;
+			snprintf(buffer + n, capacity - n, "\\u%04x", c);
+			n += 6;
+		} else {
+			if (n + 1 >= capacity) return false;
+			buffer[n++] = c;
+		}
+	}
+	if (n + 1 >= capacity) return false;
+	buffer[n++] = '"';
+	buffer[n] = '\0';
+	*length = n;
+	return true;
+}
+
+// Append `s` to `buffer` as a quoted CSV field, doubling any quotes in it as
+// RFC 4180 asks, so that commas and line breaks in e.g. device names stay
+// inside the field. This fails once the buffer is full.
+static bool
+append_csv_field(char *buffer, size_t capacity, size_t *length, const char *s)
+{
+	size_t n = *length;
+	if (n >= capacity) return false;
+	buffer[n++] = '"';
+	for (; *s; ++s) {
+		if (n + 2 >= capacity) return false;
+		if (*s == '"') buffer[n++] = '"';
+		buffer[n++] = *s;
+	}
+	if (n + 1 >= capacity) return false;
+	buffer[n++] = '"';
+	buffer[n] = '\0';
+	*length = n;
+	return true;
+}
+
+bool
+frame_summary_write(const Frame_Summary *summary, const char *filename, uint32_t n_labels,
+	const char *const labels[][2])
+{
+	char buffer[FRAME_SUMMARY_BUFFER_LENGTH] = {0};
+	size_t length = 0;
+
+	// Append to the buffer, and fail once it's full instead of truncating.
+#define APPEND(...) \
+	do { \
+		int n = snprintf(buffer + length, sizeof(buffer) - length, __VA_ARGS__); \
+		if (n < 0 || (size_t)n >= sizeof(buffer) - length) return false; \
+		length += n; \
+	} while (0)
+
+	if (has_suffix(filename, ".json")) {
+		APPEND("{\n");
+		for (uint32_t i = 0; i < n_labels; ++i) {
+			APPEND("\t");
+			if (!append_json_string(buffer, sizeof(buffer), &length, labels[i][0])) return false;
+			APPEND(": ");
+			if (!append_json_string(buffer, sizeof(buffer), &length, labels[i][1])) return false;
+			APPEND(",\n");
+		}
+		APPEND("\t\"frames\": %u,\n", summary->n_frames);
+		APPEND("\t\"mean_ms\": %.6f,\n", summary->mean_ms);
+		APPEND("\t\"median_ms\": %.6f,\n", summary->median_ms);
+		APPEND("\t\"p95_ms\": %.6f,\n", summary->p95_ms);
+		APPEND("\t\"p99_ms\": %.6f,\n", summary->p99_ms);
+		APPEND("\t\"max_ms\": %.6f,\n", summary->max_ms);
+		APPEND("\t\"fps\": %.3f\n", summary->fps);
+		APPEND("}\n");
+	} else {
+		for (uint32_t i = 0; i < n_labels; ++i) {
+			if (!append_csv_field(buffer, sizeof(buffer), &length, labels[i][0])) return false;
+			APPEND(",");
+		}
+		APPEND("frames,mean_ms,median_ms,p95_ms,p99_ms,max_ms,fps\n");
+		for (uint32_t i = 0; i < n_labels; ++i) {
+			if (!append_csv_field(buffer, sizeof(buffer), &length, labels[i][1])) return false;
+			APPEND(",");
+		}
+		APPEND("%u,%.6f,%.6f,%.6f,%.6f,%.6f,%.3f\n", summary->n_frames, summary->mean_ms, summary->median_ms,
+			summary->p95_ms, summary->p99_ms, summary->max_ms, summary->fps);
+	}
+
+#undef APPEND
+
+	return write_file_atomic(filename, buffer, length);
+}
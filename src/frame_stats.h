@@ -0,0 +1,42 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "arena.h"
+
+// Frame times in a ring that's allocated once up front, so recording a frame
+// never allocates. Once the ring is full, the oldest frames are overwritten.
+typedef struct {
+	double *frame_ms;
+	uint32_t capacity;
+	uint64_t n_frames;
+} Frame_Stats;
+
+typedef struct {
+	uint32_t n_frames;
+	double mean_ms;
+	double median_ms;
+	double p95_ms;
+	double p99_ms;
+	double max_ms;
+	double fps;
+} Frame_Summary;
+
+void frame_stats_init(Frame_Stats *stats, uint32_t capacity, Arena *arena);
+void frame_stats_add(Frame_Stats *stats, double frame_ms);
+
+// Summarize the frames in the ring. Sorting them needs scratch memory, which
+// is taken from `arena` and released before returning.
+bool frame_stats_summarize(const Frame_Stats *stats, Arena *arena, Frame_Summary *summary);
+void frame_summary_print(const Frame_Summary *summary);
+
+// Write the summary as JSON if the filename ends in ".json", and as a CSV
+// header and row otherwise. Every key but the summary's own is taken from the
+// `n_labels` pairs of `labels`, e.g. to record the configuration. Labels are
+// escaped as JSON strings, or quoted as CSV fields.
+bool frame_summary_write(const Frame_Summary *summary, const char *filename, uint32_t n_labels,
+	const char *const labels[][2]);
+
+#endif
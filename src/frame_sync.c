@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "frame_sync.h"
+
+void
+frame_sync_create(Frame_Sync *sync, VkDevice device, Sync_Backend backend, uint32_t n_frames, Arena *arena)
+{
+	assert(backend == SYNC_BACKEND_BINARY || backend == SYNC_BACKEND_TIMELINE);
+
+	*sync = (Frame_Sync){
+		.device = device,
+		.backend = backend,
+		.n_frames = n_frames,
+	};
+
+	sync->image_available = arena_alloc(arena, n_frames * sizeof(VkSemaphore));
+	sync->render_finished = arena_alloc(arena, n_frames * sizeof(VkSemaphore));
+	sync->frame_submissions = arena_alloc(arena, n_frames * sizeof(uint64_t));
+	assert(sync->image_available && sync->render_finished && sync->frame_submissions);
+
+	VkSemaphoreCreateInfo semaphore_info = {
+		.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+	};
+	for (size_t i = 0; i < n_frames; ++i) {
+		if (vkCreateSemaphore(device, &semaphore_info, NULL, &sync->image_available[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create semaphore\n");
+			exit(EXIT_FAILURE);
+		}
+		if (vkCreateSemaphore(device, &semaphore_info, NULL, &sync->render_finished[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create semaphore\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (backend == SYNC_BACKEND_BINARY) {
+		sync->in_flight_fences = arena_alloc(arena, n_frames * sizeof(VkFence));
+		assert(sync->in_flight_fences);
+
+		// Initialize the fence in a signaled state so the CPU doesn't block on
+		// the first frame.
+		VkFenceCreateInfo fence_info = {
+			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+			.flags = VK_FENCE_CREATE_SIGNALED_BIT,
+		};
+		for (size_t i = 0; i < n_frames; ++i) {
+			if (vkCreateFence(device, &fence_info, NULL, &sync->in_flight_fences[i]) != VK_SUCCESS) {
+				fprintf(stderr, "[ERROR] failed to create fence\n");
+				exit(EXIT_FAILURE);
+			}
+		}
+	} else {
+		// The counter starts at 0, which is already "signaled", so there's no
+		// need for the signaled-fence trick on the first frame.
+		VkSemaphoreTypeCreateInfo type_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO,
+			.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE,
+			.initialValue = 0,
+		};
+		VkSemaphoreCreateInfo timeline_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
+			.pNext = &type_info,
+		};
+		if (vkCreateSemaphore(device, &timeline_info, NULL, &sync->graphics_timeline.semaphore) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create timeline semaphore\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// NOTE vkWaitSemaphores is core in Vulkan 1.2, but a loader built for
+		// an older version doesn't export it, so look it up from the device.
+		sync->wait_semaphores = (PFN_vkWaitSemaphores)vkGetDeviceProcAddr(device, "vkWaitSemaphores");
+		assert(sync->wait_semaphores);
+	}
+}
+
+void
+frame_sync_destroy(Frame_Sync *sync)
+{
+	for (size_t i = 0; i < sync->n_frames; ++i) {
+		if (sync->backend == SYNC_BACKEND_BINARY) vkDestroyFence(sync->device, sync->in_flight_fences[i], NULL);
+		vkDestroySemaphore(sync->device, sync->render_finished[i], NULL);
+		vkDestroySemaphore(sync->device, sync->image_available[i], NULL);
+	}
+	if (sync->backend == SYNC_BACKEND_TIMELINE) {
+		vkDestroySemaphore(sync->device, sync->graphics_timeline.semaphore, NULL);
+	}
+}
+
+void
+frame_sync_wait(Frame_Sync *sync, uint64_t submission)
+{
+	if (submission <= sync->completed) return;
+
+	if (sync->backend == SYNC_BACKEND_TIMELINE) {
+		VkSemaphoreWaitInfo wait_info = {
+			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO,
+			.semaphoreCount = 1,
+			.pSemaphores = &sync->graphics_timeline.semaphore,
+			.pValues = &submission,
+		};
+		sync->wait_semaphores(sync->device, &wait_info, UINT64_MAX);
+	} else {
+		// Find the frame whose fence signals soonest after the submission. A
+		// fence signals only once all earlier work on the queue is complete, so
+		// waiting on a later submission than the one asked for is safe, just
+		// conservative.
+		uint32_t frame = sync->n_frames;
+		for (uint32_t i = 0; i < sync->n_frames; ++i) {
+			uint64_t this_submission = sync->frame_submissions[i];
+			if (this_submission < submission) continue;
+			if (frame == sync->n_frames || this_submission < sync->frame_submissions[frame]) frame = i;
+		}
+		assert(frame < sync->n_frames);
+
+		vkWaitForFences(sync->device, 1, &sync->in_flight_fences[frame], VK_TRUE, UINT64_MAX);
+		submission = sync->frame_submissions[frame];
+	}
+
+	sync->completed = submission;
+}
+
+void
+frame_sync_wait_frame(Frame_Sync *sync, uint32_t frame)
+{
+	frame_sync_wait(sync, sync->frame_submissions[frame]);
+}
+
+uint64_t
+frame_sync_submit(Frame_Sync *sync, uint32_t frame, VkQueue queue, uint32_t n_command_buffers,
+	const VkCommandBuffer *command_buffers, VkPipelineStageFlags wait_stage)
+{
+	uint64_t submission = sync->graphics_timeline.value + 1;
+
+	VkSemaphore signal_semaphores[] = {
+		sync->render_finished[frame],
+		sync->graphics_timeline.semaphore,
+	};
+
+	// The value for the binary semaphore is ignored.
+	uint64_t signal_values[] = { 0, submission };
+
+	// Without a swapchain, there's no image to wait for and no presentation
+	// to signal, so only the timeline is left.
+	bool presenting = wait_stage != 0;
+	uint32_t first_signal = presenting ? 0 : 1;
+	uint32_t n_signals = sync->backend == SYNC_BACKEND_TIMELINE ? 2 - first_signal : 1 - first_signal;
+
+	VkTimelineSemaphoreSubmitInfo timeline_info = {
+		.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO,
+		.signalSemaphoreValueCount = n_signals,
+		.pSignalSemaphoreValues = &signal_values[first_signal],
+	};
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.pNext = sync->backend == SYNC_BACKEND_TIMELINE ? &timeline_info : NULL,
+		.waitSemaphoreCount = presenting ? 1 : 0,
+		.pWaitSemaphores = presenting ? &sync->image_available[frame] : NULL,
+		.pWaitDstStageMask = presenting ? &wait_stage : NULL,
+		.signalSemaphoreCount = n_signals,
+		.pSignalSemaphores = n_signals > 0 ? &signal_semaphores[first_signal] : NULL,
+		.commandBufferCount = n_command_buffers,
+		.pCommandBuffers = command_buffers,
+	};
+
+	VkFence fence = VK_NULL_HANDLE;
+	if (sync->backend == SYNC_BACKEND_BINARY) {
+		// Only reset the fence once work is certain to be submitted with it.
+		// Otherwise, a wait on it would deadlock.
+		fence = sync->in_flight_fences[frame];
+		vkResetFences(sync->device, 1, &fence);
+	}
+
+	if (vkQueueSubmit(queue, 1, &submit_info, fence) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to submit draw command buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// NOTE The binary backend reuses the value as a plain submission counter.
+	sync->graphics_timeline.value = submission;
+	sync->frame_submissions[frame] = submission;
+	return submission;
+}
+
+const char *
+sync_backend_name(Sync_Backend backend)
+{
+	switch (backend) {
+	case SYNC_BACKEND_BINARY: return "binary";
+	case SYNC_BACKEND_TIMELINE: return "timeline";
+	default: return "auto";
+	}
+}
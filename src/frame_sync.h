@@ -0,0 +1,86 @@
+#ifndef FRAME_SYNC_H
+#define FRAME_SYNC_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+
+typedef enum {
+	// Pick the timeline backend if the device supports it.
+	SYNC_BACKEND_AUTO,
+
+	// One fence per frame in flight, reset before every submission.
+	SYNC_BACKEND_BINARY,
+
+	// One Vulkan 1.2 timeline semaphore per queue. The CPU waits on counter
+	// values with vkWaitSemaphores(), and nothing ever needs a reset.
+	SYNC_BACKEND_TIMELINE,
+} Sync_Backend;
+
+// A monotonically increasing counter that a queue signals once per
+// submission.
+typedef struct {
+	VkSemaphore semaphore;
+
+	// The value signaled by the latest submission to the queue.
+	uint64_t value;
+} Timeline;
+
+// Synchronization between the CPU and the GPU for a ring of frames in flight.
+//
+// Every submission is identified by a serial number that increases by one
+// per submission, starting at 1; 0 never refers to a submission. With the
+// timeline backend, the serial is the value the submission signals on the
+// queue's timeline. With the binary backend, it's resolved to the fence of
+// the frame that made the submission.
+typedef struct {
+	VkDevice device;
+	Sync_Backend backend;
+	uint32_t n_frames;
+
+	// Both backends synchronize with the swapchain through binary semaphores
+	// since presentation doesn't support timeline semaphores.
+	VkSemaphore *image_available;
+	VkSemaphore *render_finished;
+
+	// The serial of the latest submission by each frame.
+	uint64_t *frame_submissions;
+
+	// Every serial up to and including this one is known to be complete.
+	uint64_t completed;
+
+	// The binary backend signals one fence per frame.
+	VkFence *in_flight_fences;
+
+	// The timeline backend signals a single counter for the graphics queue.
+	Timeline graphics_timeline;
+	PFN_vkWaitSemaphores wait_semaphores;
+} Frame_Sync;
+
+// Create the synchronization objects for `n_frames` frames in flight. The
+// arrays are allocated from `arena`. The backend must be a concrete one, i.e.
+// not SYNC_BACKEND_AUTO, and for the timeline backend, the device must have
+// been created with the timelineSemaphore feature.
+void frame_sync_create(Frame_Sync *sync, VkDevice device, Sync_Backend backend, uint32_t n_frames,
+	Arena *arena);
+void frame_sync_destroy(Frame_Sync *sync);
+
+// Block until the given submission, and thus every earlier one, is complete.
+void frame_sync_wait(Frame_Sync *sync, uint64_t submission);
+
+// Block until the previous submission of the frame is complete, so that the
+// frame's resources may be reused.
+void frame_sync_wait_frame(Frame_Sync *sync, uint32_t frame);
+
+// Submit command buffers for the frame to the graphics queue. The submission
+// waits on the frame's image available semaphore at `wait_stage` and signals
+// its render finished semaphore, unless `wait_stage` is 0 for frames that
+// aren't presented. Return the serial of the submission.
+uint64_t frame_sync_submit(Frame_Sync *sync, uint32_t frame, VkQueue queue, uint32_t n_command_buffers,
+	const VkCommandBuffer *command_buffers, VkPipelineStageFlags wait_stage);
+
+const char *sync_backend_name(Sync_Backend backend);
+
+#endif
@@ -0,0 +1,414 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "debug.h"
+#include "gpu_memory.h"
+#include "util.h"
+
+// A range of a block, either free or in use by one allocation. The ranges of
+// a block are kept in order of their offsets and cover the entire block.
+// Adjacent free ranges are always merged.
+struct Gpu_Memory_Range {
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	bool free;
+	Gpu_Resource_Kind kind;
+
+	Gpu_Memory_Block *block;
+	Gpu_Memory_Range *prev;
+	Gpu_Memory_Range *next;
+};
+
+struct Gpu_Memory_Block {
+	VkDeviceMemory memory;
+	VkDeviceSize size;
+	uint32_t memory_type;
+	void *mapped;
+
+	// Blocks made for a single oversized allocation are freed with it.
+	bool dedicated;
+
+	Gpu_Memory_Range *ranges;
+	Gpu_Memory_Block *next;
+};
+
+static uint32_t
+count_bits(uint32_t x)
+{
+	uint32_t n = 0;
+	for (; x; x &= x - 1) ++n;
+	return n;
+}
+
+static VkDeviceSize
+align_up(VkDeviceSize x, VkDeviceSize alignment)
+{
+	assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+	return (x + alignment - 1) & ~(alignment - 1);
+}
+
+static bool
+kinds_conflict(Gpu_Resource_Kind a, Gpu_Resource_Kind b)
+{
+	return a != b || a == GPU_RESOURCE_MIXED;
+}
+
+// True if the byte at `a` and the byte at `b` share a "page" of
+// bufferImageGranularity bytes.
+static bool
+on_same_page(VkDeviceSize a, VkDeviceSize b, VkDeviceSize granularity)
+{
+	return a / granularity == b / granularity;
+}
+
+// Find the memory type that's allowed by `type_bits`, has every `required`
+// property, and has the most `preferred` properties. Among equally good types,
+// the first one wins since drivers list the fastest types first. Returns
+// MEMORY_TYPE_NONE if no memory type qualifies.
+uint32_t
+find_memory_type(const VkPhysicalDeviceMemoryProperties *memory_properties, uint32_t type_bits,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+	uint32_t best_type = MEMORY_TYPE_NONE;
+	uint32_t best_score = 0;
+
+	for (uint32_t i = 0; i < memory_properties->memoryTypeCount; ++i) {
+		if (!(type_bits & (1u << i))) continue;
+
+		VkMemoryPropertyFlags flags = memory_properties->memoryTypes[i].propertyFlags;
+		if ((flags & required) != required) continue;
+
+		uint32_t score = count_bits(flags & preferred);
+		if (best_type == MEMORY_TYPE_NONE || score > best_score) {
+			best_type = i;
+			best_score = score;
+		}
+	}
+
+	return best_type;
+}
+
+void
+gpu_allocator_init(Gpu_Allocator *allocator, VkPhysicalDevice physical_device, VkDevice device)
+{
+	*allocator = (Gpu_Allocator){ .device = device };
+
+	VkPhysicalDeviceProperties properties = {0};
+	vkGetPhysicalDeviceProperties(physical_device, &properties);
+	allocator->buffer_image_granularity = MAX(properties.limits.bufferImageGranularity, 1);
+	allocator->max_memory_allocation_count = properties.limits.maxMemoryAllocationCount;
+
+	vkGetPhysicalDeviceMemoryProperties(physical_device, &allocator->memory_properties);
+}
+
+static void
+destroy_block(Gpu_Allocator *allocator, Gpu_Memory_Block *block)
+{
+	for (Gpu_Memory_Range *range = block->ranges; range;) {
+		Gpu_Memory_Range *next = range->next;
+		free(range);
+		range = next;
+	}
+
+	// NOTE Freeing the memory implicitly unmaps it.
+	vkFreeMemory(allocator->device, block->memory, NULL);
+	allocator->stats.reserved -= block->size;
+	--allocator->stats.n_blocks;
+	free(block);
+}
+
+void
+gpu_allocator_destroy(Gpu_Allocator *allocator)
+{
+	if (allocator->stats.n_allocations > 0) {
+		fprintf(stderr, "[WARNING] destroying gpu allocator with %u live allocations\n",
+			allocator->stats.n_allocations);
+	}
+
+	for (size_t i = 0; i < VK_MAX_MEMORY_TYPES; ++i) {
+		for (Gpu_Memory_Block *block = allocator->blocks[i]; block;) {
+			Gpu_Memory_Block *next = block->next;
+			destroy_block(allocator, block);
+			block = next;
+		}
+		allocator->blocks[i] = NULL;
+	}
+}
+
+void
+gpu_allocator_print_stats(const Gpu_Allocator *allocator)
+{
+	const Gpu_Memory_Stats *stats = &allocator->stats;
+	printf("[INFO] gpu memory: %.2f MiB used of %.2f MiB reserved in %u blocks, %u allocations\n",
+		stats->used / (1024.0 * 1024.0), stats->reserved / (1024.0 * 1024.0), stats->n_blocks,
+		stats->n_allocations);
+}
+
+static Gpu_Memory_Block *
+create_block(Gpu_Allocator *allocator, uint32_t memory_type, VkDeviceSize minimum_size)
+{
+	if (allocator->stats.n_blocks >= allocator->max_memory_allocation_count) return NULL;
+
+	// Keep blocks to at most an eighth of their heap so a small heap, e.g. the
+	// 256 MiB host-visible window into VRAM without resizable BAR, isn't
+	// exhausted by a few blocks.
+	uint32_t heap = allocator->memory_properties.memoryTypes[memory_type].heapIndex;
+	VkDeviceSize block_size = MIN(GPU_MEMORY_BLOCK_SIZE, allocator->memory_properties.memoryHeaps[heap].size / 8);
+	bool dedicated = minimum_size > block_size;
+	if (dedicated) block_size = minimum_size;
+
+	VkMemoryAllocateInfo allocate_info = {
+		.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+		.allocationSize = block_size,
+		.memoryTypeIndex = memory_type,
+	};
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	if (vkAllocateMemory(allocator->device, &allocate_info, NULL, &memory) != VK_SUCCESS) return NULL;
+
+	Gpu_Memory_Block *block = malloc(sizeof(Gpu_Memory_Block));
+	Gpu_Memory_Range *range = malloc(sizeof(Gpu_Memory_Range));
+	assert(block && range);
+
+	*range = (Gpu_Memory_Range){
+		.offset = 0,
+		.size = block_size,
+		.free = true,
+		.block = block,
+	};
+	*block = (Gpu_Memory_Block){
+		.memory = memory,
+		.size = block_size,
+		.memory_type = memory_type,
+		.dedicated = dedicated,
+		.ranges = range,
+		.next = allocator->blocks[memory_type],
+	};
+
+	VkMemoryPropertyFlags flags = allocator->memory_properties.memoryTypes[memory_type].propertyFlags;
+	if (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) {
+		if (vkMapMemory(allocator->device, memory, 0, VK_WHOLE_SIZE, 0, &block->mapped) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to map gpu memory block\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	allocator->blocks[memory_type] = block;
+	allocator->stats.reserved += block_size;
+	++allocator->stats.n_blocks;
+	return block;
+}
+
+// Split the range at `offset`, and return the part after it. The new range
+// inherits the state of the original.
+static Gpu_Memory_Range *
+split_range(Gpu_Memory_Range *range, VkDeviceSize offset)
+{
+	assert(offset > range->offset && offset < range->offset + range->size);
+
+	Gpu_Memory_Range *after = malloc(sizeof(Gpu_Memory_Range));
+	assert(after);
+	*after = *range;
+	after->offset = offset;
+	after->size = range->offset + range->size - offset;
+	after->prev = range;
+	if (range->next) range->next->prev = after;
+
+	range->size = offset - range->offset;
+	range->next = after;
+	return after;
+}
+
+// First fit over the free ranges of a block. Padding is added before the
+// allocation if its neighbor would otherwise share a page of
+// bufferImageGranularity with a conflicting kind of resource.
+static Gpu_Memory_Range *
+alloc_from_block(Gpu_Memory_Block *block, VkDeviceSize size, VkDeviceSize alignment, Gpu_Resource_Kind kind,
+	VkDeviceSize granularity)
+{
+	for (Gpu_Memory_Range *range = block->ranges; range; range = range->next) {
+		if (!range->free || range->size < size) continue;
+
+		VkDeviceSize offset = align_up(range->offset, alignment);
+		Gpu_Memory_Range *prev = range->prev;
+		if (prev && kinds_conflict(prev->kind, kind) &&
+				on_same_page(prev->offset + prev->size - 1, offset, granularity)) {
+			offset = align_up(offset, granularity);
+		}
+
+		VkDeviceSize end = offset + size;
+		if (end > range->offset + range->size) continue;
+
+		Gpu_Memory_Range *next = range->next;
+		if (next && kinds_conflict(next->kind, kind) && on_same_page(end - 1, next->offset, granularity)) continue;
+
+		// Leave the padding before and the space after as free ranges.
+		if (offset > range->offset) range = split_range(range, offset);
+		if (end < range->offset + range->size) split_range(range, end);
+
+		range->free = false;
+		range->kind = kind;
+		return range;
+	}
+
+	return NULL;
+}
+
+bool
+gpu_alloc(Gpu_Allocator *allocator, const VkMemoryRequirements *requirements, VkMemoryPropertyFlags required,
+	VkMemoryPropertyFlags preferred, Gpu_Resource_Kind kind, Gpu_Allocation *allocation)
+{
+	uint32_t memory_type = find_memory_type(&allocator->memory_properties, requirements->memoryTypeBits,
+		required, preferred);
+	if (memory_type == MEMORY_TYPE_NONE) return false;
+
+	VkDeviceSize alignment = MAX(requirements->alignment, 1);
+	Gpu_Memory_Range *range = NULL;
+	for (Gpu_Memory_Block *block = allocator->blocks[memory_type]; block && !range; block = block->next) {
+		range = alloc_from_block(block, requirements->size, alignment, kind, allocator->buffer_image_granularity);
+	}
+
+	if (!range) {
+		Gpu_Memory_Block *block = create_block(allocator, memory_type, requirements->size);
+		if (!block) return false;
+
+		range = alloc_from_block(block, requirements->size, alignment, kind, allocator->buffer_image_granularity);
+		assert(range);
+	}
+
+	Gpu_Memory_Block *block = range->block;
+	*allocation = (Gpu_Allocation){
+		.memory = block->memory,
+		.offset = range->offset,
+		.size = range->size,
+		.memory_type = memory_type,
+		.mapped = block->mapped ? (unsigned char *)block->mapped + range->offset : NULL,
+		.range = range,
+	};
+
+	allocator->stats.used += range->size;
+	++allocator->stats.n_allocations;
+	return true;
+}
+
+// Merge a free range into its predecessor, which must be free too.
+static void
+merge_range(Gpu_Memory_Range *range)
+{
+	Gpu_Memory_Range *prev = range->prev;
+	assert(prev && prev->free && range->free);
+
+	prev->size += range->size;
+	prev->next = range->next;
+	if (range->next) range->next->prev = prev;
+	free(range);
+}
+
+void
+gpu_free(Gpu_Allocator *allocator, Gpu_Allocation *allocation)
+{
+	Gpu_Memory_Range *range = allocation->range;
+	if (!range) return;
+	assert(!range->free);
+
+	allocator->stats.used -= range->size;
+	--allocator->stats.n_allocations;
+
+	Gpu_Memory_Block *block = range->block;
+	range->free = true;
+	if (range->next && range->next->free) merge_range(range->next);
+	if (range->prev && range->prev->free) merge_range(range);
+
+	// Give dedicated blocks back to the driver once they're empty. Regular
+	// blocks are kept around for reuse.
+	if (block->dedicated && block->ranges->free && !block->ranges->next) {
+		Gpu_Memory_Block **link = &allocator->blocks[block->memory_type];
+		while (*link != block) link = &(*link)->next;
+		*link = block->next;
+		destroy_block(allocator, block);
+	}
+
+	*allocation = (Gpu_Allocation){0};
+}
+
+// Reserve `size` bytes for a linear arena. The reservation may hold any kind
+// of resource, so it's padded away from its neighbors in the block.
+bool
+gpu_arena_init(Gpu_Arena *arena, Gpu_Allocator *allocator, VkDeviceSize size, uint32_t memory_type_bits,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred)
+{
+	*arena = (Gpu_Arena){ .allocator = allocator };
+
+	VkMemoryRequirements requirements = {
+		.size = size,
+		.alignment = allocator->buffer_image_granularity,
+		.memoryTypeBits = memory_type_bits,
+	};
+	return gpu_alloc(allocator, &requirements, required, preferred, GPU_RESOURCE_MIXED, &arena->reservation);
+}
+
+void
+gpu_arena_destroy(Gpu_Arena *arena)
+{
+	gpu_free(arena->allocator, &arena->reservation);
+}
+
+bool
+gpu_arena_alloc(Gpu_Arena *arena, const VkMemoryRequirements *requirements, Gpu_Resource_Kind kind,
+	Gpu_Allocation *allocation)
+{
+	const Gpu_Allocation *reservation = &arena->reservation;
+	if (!(requirements->memoryTypeBits & (1u << reservation->memory_type))) return false;
+
+	// Offsets are aligned within the block rather than the reservation since
+	// alignment requirements refer to the offset into the VkDeviceMemory.
+	VkDeviceSize granularity = arena->allocator->buffer_image_granularity;
+	VkDeviceSize current = reservation->offset + arena->current_offset;
+	VkDeviceSize offset = align_up(current, MAX(requirements->alignment, 1));
+	if (arena->current_offset > 0 && kinds_conflict(arena->current_kind, kind) &&
+			on_same_page(current - 1, offset, granularity)) {
+		offset = align_up(offset, granularity);
+	}
+
+	VkDeviceSize end = offset + requirements->size;
+	if (end > reservation->offset + reservation->size) return false;
+
+	*allocation = (Gpu_Allocation){
+		.memory = reservation->memory,
+		.offset = offset,
+		.size = requirements->size,
+		.memory_type = reservation->memory_type,
+		.mapped = reservation->mapped ? (unsigned char *)reservation->mapped + (offset - reservation->offset) : NULL,
+		.range = NULL,
+	};
+
+	arena->current_offset = end - reservation->offset;
+	arena->current_kind = kind;
+	return true;
+}
+
+void
+gpu_arena_free(Gpu_Arena *arena)
+{
+	arena->current_offset = 0;
+}
+
+Gpu_Arena_Checkpoint
+gpu_arena_create_checkpoint(Gpu_Arena *arena)
+{
+	return (Gpu_Arena_Checkpoint){
+		.arena = arena,
+		.current_offset = arena->current_offset,
+		.current_kind = arena->current_kind,
+	};
+}
+
+void
+gpu_arena_restore(Gpu_Arena_Checkpoint checkpoint)
+{
+	checkpoint.arena->current_offset = checkpoint.current_offset;
+	checkpoint.arena->current_kind = checkpoint.current_kind;
+}
@@ -0,0 +1,116 @@
+#ifndef GPU_MEMORY_H
+#define GPU_MEMORY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#define MEMORY_TYPE_NONE	UINT32_MAX
+
+// Size of the VkDeviceMemory blocks that allocations are carved out of.
+// Heaps smaller than eight blocks get proportionally smaller blocks, and
+// allocations larger than a block get a block of their own.
+#define GPU_MEMORY_BLOCK_SIZE	((VkDeviceSize)64 << 20)
+
+// Resources that must not share a bufferImageGranularity-sized page with each
+// other. Buffers and linearly tiled images alias safely, but optimally tiled
+// images don't alias with either.
+typedef enum {
+	GPU_RESOURCE_LINEAR,
+	GPU_RESOURCE_OPTIMAL,
+
+	// Unknown contents, e.g. a linear arena's reservation, which conflicts
+	// with every other kind.
+	GPU_RESOURCE_MIXED,
+} Gpu_Resource_Kind;
+
+typedef struct Gpu_Memory_Range Gpu_Memory_Range;
+typedef struct Gpu_Memory_Block Gpu_Memory_Block;
+
+// A range of a VkDeviceMemory block in use by a single resource.
+typedef struct {
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	uint32_t memory_type;
+
+	// Host-visible blocks stay mapped for their entire lifetime, so this
+	// points at the start of the range; NULL otherwise.
+	void *mapped;
+
+	// The range in the free-list pool, or NULL for allocations from a linear
+	// arena, which are only reclaimed by resetting the arena.
+	Gpu_Memory_Range *range;
+} Gpu_Allocation;
+
+typedef struct {
+	// Bytes handed out to allocations. A linear arena counts as a single
+	// allocation of its entire reservation.
+	VkDeviceSize used;
+
+	// Bytes allocated from the driver with vkAllocateMemory().
+	VkDeviceSize reserved;
+
+	uint32_t n_blocks;
+	uint32_t n_allocations;
+} Gpu_Memory_Stats;
+
+// Sub-allocates resources from a small number of large VkDeviceMemory blocks
+// per memory type. Long-lived resources come from a free list over each block,
+// and short-lived ones from linear arenas reserved out of it.
+typedef struct {
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties memory_properties;
+	VkDeviceSize buffer_image_granularity;
+	uint32_t max_memory_allocation_count;
+
+	// One list of blocks per memory type.
+	Gpu_Memory_Block *blocks[VK_MAX_MEMORY_TYPES];
+
+	Gpu_Memory_Stats stats;
+} Gpu_Allocator;
+
+// A linear allocator over a single reservation from a Gpu_Allocator. It has
+// the same semantics as Arena: allocations are bumped off the end, and they
+// are released all at once by gpu_arena_free() or back to a checkpoint by
+// gpu_arena_restore().
+typedef struct {
+	Gpu_Allocator *allocator;
+	Gpu_Allocation reservation;
+
+	VkDeviceSize current_offset;
+
+	// Kind of the latest allocation, since only a change of kind requires
+	// padding to bufferImageGranularity.
+	Gpu_Resource_Kind current_kind;
+} Gpu_Arena;
+
+typedef struct {
+	Gpu_Arena *arena;
+	VkDeviceSize current_offset;
+	Gpu_Resource_Kind current_kind;
+} Gpu_Arena_Checkpoint;
+
+uint32_t find_memory_type(const VkPhysicalDeviceMemoryProperties *memory_properties, uint32_t type_bits,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+
+void gpu_allocator_init(Gpu_Allocator *allocator, VkPhysicalDevice physical_device, VkDevice device);
+void gpu_allocator_destroy(Gpu_Allocator *allocator);
+void gpu_allocator_print_stats(const Gpu_Allocator *allocator);
+
+bool gpu_alloc(Gpu_Allocator *allocator, const VkMemoryRequirements *requirements, VkMemoryPropertyFlags required,
+	VkMemoryPropertyFlags preferred, Gpu_Resource_Kind kind, Gpu_Allocation *allocation);
+void gpu_free(Gpu_Allocator *allocator, Gpu_Allocation *allocation);
+
+bool gpu_arena_init(Gpu_Arena *arena, Gpu_Allocator *allocator, VkDeviceSize size, uint32_t memory_type_bits,
+	VkMemoryPropertyFlags required, VkMemoryPropertyFlags preferred);
+void gpu_arena_destroy(Gpu_Arena *arena);
+bool gpu_arena_alloc(Gpu_Arena *arena, const VkMemoryRequirements *requirements, Gpu_Resource_Kind kind,
+	Gpu_Allocation *allocation);
+void gpu_arena_free(Gpu_Arena *arena);
+
+Gpu_Arena_Checkpoint gpu_arena_create_checkpoint(Gpu_Arena *arena);
+void gpu_arena_restore(Gpu_Arena_Checkpoint checkpoint);
+
+#endif
@@ -0,0 +1,81 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.h"
+#include "image.h"
+
+Gpu_Image
+gpu_image_create(Gpu_Allocator *allocator, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage,
+	VkImageAspectFlags aspect, VkSampleCountFlagBits samples, VkMemoryPropertyFlags required,
+	VkMemoryPropertyFlags preferred)
+{
+	Gpu_Image image = {
+		.format = format,
+		.extent = extent,
+		.samples = samples,
+	};
+
+	VkImageCreateInfo image_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+		.imageType = VK_IMAGE_TYPE_2D,
+		.format = format,
+		.extent = { extent.width, extent.height, 1 },
+		.mipLevels = 1,
+		.arrayLayers = 1,
+		.samples = samples,
+		.tiling = VK_IMAGE_TILING_OPTIMAL,
+		.usage = usage,
+		.sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+	};
+	if (vkCreateImage(allocator->device, &image_info, NULL, &image.handle) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create image\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkMemoryRequirements requirements = {0};
+	vkGetImageMemoryRequirements(allocator->device, image.handle, &requirements);
+	if (!gpu_alloc(allocator, &requirements, required, preferred, GPU_RESOURCE_OPTIMAL, &image.allocation)) {
+		fprintf(stderr, "[ERROR] failed to allocate image memory\n");
+		exit(EXIT_FAILURE);
+	}
+	vkBindImageMemory(allocator->device, image.handle, image.allocation.memory, image.allocation.offset);
+
+	VkImageViewCreateInfo image_view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.image = image.handle,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = format,
+		.components = {
+			.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+		},
+		.subresourceRange = {
+			.aspectMask = aspect,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+	if (vkCreateImageView(allocator->device, &image_view_info, NULL, &image.view) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create image view\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return image;
+}
+
+void
+gpu_image_destroy(Gpu_Allocator *allocator, Gpu_Image *image)
+{
+	vkDestroyImageView(allocator->device, image->view, NULL);
+	vkDestroyImage(allocator->device, image->handle, NULL);
+	gpu_free(allocator, &image->allocation);
+	*image = (Gpu_Image){0};
+}
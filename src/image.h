@@ -0,0 +1,26 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "gpu_memory.h"
+
+// A 2D image with a single mip level and layer, bound to a range of a block
+// owned by a Gpu_Allocator, along with a view of all of it.
+typedef struct {
+	VkImage handle;
+	VkImageView view;
+	VkFormat format;
+	VkExtent2D extent;
+	VkSampleCountFlagBits samples;
+	Gpu_Allocation allocation;
+} Gpu_Image;
+
+Gpu_Image gpu_image_create(Gpu_Allocator *allocator, VkExtent2D extent, VkFormat format, VkImageUsageFlags usage,
+	VkImageAspectFlags aspect, VkSampleCountFlagBits samples, VkMemoryPropertyFlags required,
+	VkMemoryPropertyFlags preferred);
+void gpu_image_destroy(Gpu_Allocator *allocator, Gpu_Image *image);
+
+#endif
@@ -1,4 +1,9 @@
+#include <inttypes.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -10,12 +15,34 @@
 #include <GLFW/glfw3.h>
 
 #include "arena.h"
+#include "attachments.h"
+#include "buffer.h"
+#include "culling.h"
 #include "debug.h"
-
-
-#define MAX(a, b)	(a > b ? a : b)
-#define MIN(a, b)	(a < b ? a : b)
-#define CLAMP(n, low, high)	MIN(high, MAX(low, n))
+#include "descriptors.h"
+#include "event_queue.h"
+#include "file.h"
+#include "frame_context.h"
+#include "frame_stats.h"
+#include "frame_sync.h"
+#include "gpu_memory.h"
+#include "image.h"
+#include "offscreen.h"
+#include "options.h"
+#include "pipeline_builder.h"
+#include "pipeline_cache.h"
+#include "pipeline_variants.h"
+#include "profiler.h"
+#include "recorder.h"
+#include "rendering.h"
+#include "shader.h"
+#include "shader_watcher.h"
+#include "startup.h"
+#include "swapchain.h"
+#include "thread_pool.h"
+#include "timer.h"
+#include "upload.h"
+#include "util.h"
 
 
 #define WINDOW_WIDTH	800
@@ -24,37 +51,229 @@
 
 #define ENGINE_NAME	"No Engine"
 
-// A value greater than 1 allows frames to be processed concurrently.
-#define MAX_FRAMES_IN_FLIGHT	2
+// The pipeline cache is stored relative to the working directory, alongside
+// the shaders.
+#define PIPELINE_CACHE_FILENAME	"pipeline_cache.bin"
+
+// The compiler that ./compile.sh --shaders uses, for reloading shaders.
+#define SHADER_COMPILER	"glslc"
 
 
 typedef struct {
 	bool graphics_family_exists;
 	uint32_t graphics_family;
 
+	// Meaningful bits of the graphics family's timestamps, or 0 if its queues
+	// don't support timestamps.
+	uint32_t graphics_timestamp_valid_bits;
+
 	bool presentation_family_exists;
 	uint32_t presentation_family;
+
+	// Families without graphics support whose queues the hardware runs
+	// alongside the graphics queue: a DMA engine for uploads and asynchronous
+	// compute. When these don't exist, the graphics queue does the work.
+	bool transfer_family_exists;
+	uint32_t transfer_family;
+
+	bool compute_family_exists;
+	uint32_t compute_family;
 } Queue_Family_Indices;
 
 typedef struct {
 	VkPhysicalDevice device;
+	VkPhysicalDeviceProperties properties;
 	Queue_Family_Indices indices;
 } Physical_Device;
 
+// Optional device functionality. Each is enabled only if the physical device
+// supports it, and the renderer falls back to a baseline path otherwise.
 typedef struct {
-	VkSurfaceCapabilitiesKHR capabilities;
+	// Presentation pacing with VK_KHR_present_id and VK_KHR_present_wait.
+	bool present_wait;
+
+	// Frame synchronization with Vulkan 1.2 timeline semaphores.
+	bool timeline_semaphore;
+
+	// Pipeline creation from VK_EXT_shader_module_identifier identifiers,
+	// which skips creating shader modules when the pipeline cache hits.
+	bool shader_module_identifier;
+
+	// GPU-driven drawing, which culls with a compute shader and draws each
+	// instance from its own indirect command. The commands address their
+	// instance with firstInstance, so drawIndirectFirstInstance is required,
+	// while multiDrawIndirect and VK_KHR_draw_indirect_count each save
+	// recording a draw per instance.
+	bool draw_indirect_first_instance;
+	bool multi_draw_indirect;
+	bool draw_indirect_count;
+
+	// Rendering without render pass objects, with barriers recorded through
+	// synchronization2, which are core in Vulkan 1.3 and KHR extensions on
+	// Vulkan 1.2.
+	bool dynamic_rendering;
+	bool dynamic_rendering_core;
+} Device_Capabilities;
+
+// The vertex layout consumed by shaders/shader.vert.
+typedef struct {
+	float position[2];
+	float color[3];
+} Vertex;
 
-	uint32_t n_formats;
-	VkSurfaceFormatKHR *formats;
+// The per-instance attributes consumed by shaders/shader.vert. Every instance
+// draws the triangle scaled about its origin, moved by the offset, and tinted
+// by the color.
+typedef struct {
+	float offset[2];
+	float scale;
+	float color[3];
+} Instance;
+
+// The per-draw uniform block of shaders/shader.vert, which transforms the
+// instances from clip space into the viewport. Every draw has one in the
+// uniform ring, and selects it with a dynamic offset.
+typedef struct {
+	float scale[2];
+	float offset[2];
+	float depth;
 
-	uint32_t n_presentation_modes;
-	VkPresentModeKHR *presentation_modes;
-} Swapchain_Support_Details;
+	// Pads the block out to std140's 16-byte alignment.
+	float padding[3];
+} Draw_Uniforms;
 
+// An entry of the per-frame draw list, which is recorded in order. Sorting it
+// front to back only moves the entries around; every draw keeps its slot in
+// the uniform ring and the pipeline variant it was looked up with.
 typedef struct {
-	size_t length;
-	char *contents;
-} Buffer;
+	float depth;
+	uint32_t uniform_offset;
+	VkPipeline pipeline;
+} Draw_Item;
+
+// The push constants of shaders/shader.vert: per-draw data that's too small
+// to be worth a slot in the uniform ring.
+typedef struct {
+	float tint[4];
+} Draw_Constants;
+
+// Everything record_draws() binds to draw the triangle.
+typedef struct {
+	VkPipelineLayout layout;
+	VkExtent2D extent;
+	VkBuffer vertex_buffer;
+	VkBuffer index_buffer;
+
+	// This frame's region of the instance ring.
+	VkBuffer instance_buffer;
+	VkDeviceSize instance_offset;
+	uint32_t n_instances;
+
+	// The frame's set for the uniform ring, and the draw list, which holds
+	// the pipeline and the dynamic offset of the uniforms of every draw in
+	// recording order.
+	VkDescriptorSet descriptor_set;
+	const Draw_Item *draw_list;
+
+	// Draw indirectly from the frame's culled commands instead, if not NULL.
+	const Culler *culler;
+	uint32_t frame;
+} Draw_Context;
+
+// Files read on a thread of their own at startup, while the window, the
+// instance, and the surface are created, since none of them needs a device.
+typedef struct {
+	Startup_Timer *startup;
+	bool read_cull_shader;
+
+	// Whether cull_shader holds code. The culling shader is optional: without
+	// it, culling falls back to drawing every instance.
+	bool has_cull_shader;
+
+	Shader_Code vert_shader;
+	Shader_Code frag_shader;
+	Shader_Code cull_shader;
+
+	// Empty if there's no pipeline cache on disk yet.
+	Mapped_File pipeline_cache;
+} Startup_Files;
+
+// Everything the frame loop touches. It belongs to whichever thread renders,
+// and only reaches the thread that pumps GLFW events through `events`.
+typedef struct {
+	const Options *options;
+	bool headless;
+	bool benchmark;
+	bool on_demand;
+	bool gpu_culling;
+	uint64_t frame_interval;
+
+	// Without a render thread, the loop pumps the window's events itself.
+	GLFWwindow *window;
+	bool render_thread;
+	Event_Queue *events;
+
+	VkDevice device;
+	VkQueue graphics_queue;
+	VkQueue present_queue;
+	VkRenderPass render_pass;
+	const Dynamic_Rendering *dynamic_rendering;
+	Pipeline_Variants *pipelines;
+	Pipeline_Key opaque_key;
+	Shader_Cache *shaders;
+	Startup_Timer *startup;
+
+	// Recompiles edited shaders, if hot reloading is on, or NULL.
+	Shader_Watcher *shader_watcher;
+	VkPipelineLayout layout;
+	VkDescriptorSetLayout set_layout;
+	Render_Attachments *attachments;
+	Swapchain *swapchain;
+	Offscreen_Target *offscreen;
+	Frame_Sync *sync;
+	Frame_Context *frame_contexts;
+	Profiler *profiler;
+	Recorder *recorder;
+	Culler *culler;
+	Frame_Stats *frame_stats;
+	uint32_t n_frames_in_flight;
+
+	Gpu_Buffer *vertex_buffers;
+	Gpu_Buffer *index_buffers;
+	Gpu_Buffer *instance_ring;
+	VkDeviceSize instance_region_size;
+	Uniform_Ring *uniforms;
+	Descriptor_Allocator *descriptors;
+
+	// The window as of the last events handled. Not every platform reports a
+	// resize through VK_ERROR_OUT_OF_DATE_KHR, so it's tracked explicitly as
+	// well. The scene is dirty if anything happened since the last frame that
+	// could change what the window shows.
+	VkExtent2D window_extent;
+	bool framebuffer_resized;
+	bool scene_dirty;
+	uint64_t scene_time;
+	bool quit;
+
+	uint32_t current_frame;
+	uint64_t n_frames_rendered;
+	uint64_t n_frames_read_back;
+	uint64_t n_events;
+
+	// Instances per draw that were on screen, summed over the frames that
+	// frame_stats measured.
+	uint64_t n_instances_on_screen;
+	uint64_t n_frames_measured;
+	uint64_t inline_recording_ns;
+	uint64_t n_inline_frames;
+	uint64_t next_frame_start;
+	uint64_t last_frame_end;
+	uint64_t last_report;
+
+	// Set by the render thread once it's done, which is all the main thread
+	// reads while it runs.
+	atomic_bool stopped;
+} Renderer;
 
 
 #ifdef DEBUG
@@ -67,10 +286,22 @@ typedef struct {
 #endif
 
 
+// Initial length of the global arena. It chains heap blocks beyond this, and
+// reports its high-water mark at exit to help size this buffer. Temporary
+// query results don't go here but into the calling thread's arena, through
+// arena_scratch_begin().
 #define ARENA_BUFFER_LENGTH	65536
 static unsigned char global_arena_buffer[ARENA_BUFFER_LENGTH];
 static Arena global_arena;
 
+// Scratch memory for CPU data that only lives for a single frame, such as the
+// draw list. It's reset with arena_free() at the start of every frame, which
+// is O(1) since it's a fixed arena that never chains blocks. If the draw list
+// doesn't fit in this buffer, the arena gets a larger one at startup.
+#define FRAME_ARENA_LENGTH	65536
+static unsigned char frame_arena_buffer[FRAME_ARENA_LENGTH];
+static Arena frame_arena;
+
 
 static const char *device_extensions[] = {
 	// Present rendered images from a device to a window on the screen.
@@ -78,121 +309,1079 @@ static const char *device_extensions[] = {
 };
 #define DEVICE_EXTENSIONS_LENGTH	(sizeof(device_extensions) / sizeof(const char *))
 
+// Upper bound on the number of required and optional extensions enabled on
+// the logical device together.
+#define MAX_ENABLED_DEVICE_EXTENSIONS	16
 
-Buffer
-read_file(char *filename)
-{
-	FILE *file = fopen(filename, "rb");
-	if (!file) {
-		fprintf(stderr, "[ERROR] failed to open file %s\n", filename);
-		exit(EXIT_FAILURE);
-	}
 
-	if (fseek(file, 0L, SEEK_END) == -1) {
-		fprintf(stderr, "[ERROR] failed to seek to end of file %s\n", filename);
-		exit(EXIT_FAILURE);
-	}
-	long length = ftell(file);
-	if (length == -1) {
-		fprintf(stderr, "[ERROR] failed to return position in file %s\n", filename);
-		exit(EXIT_FAILURE);
-	}
-	rewind(file);
+static const Vertex triangle_vertices[] = {
+	{ .position = {  0.0f, -0.5f }, .color = { 1.0f, 0.0f, 0.0f } },
+	{ .position = {  0.5f,  0.5f }, .color = { 0.0f, 1.0f, 0.0f } },
+	{ .position = { -0.5f,  0.5f }, .color = { 0.0f, 0.0f, 1.0f } },
+};
+static const uint16_t triangle_indices[] = { 0, 1, 2 };
+#define TRIANGLE_INDICES_LENGTH	(sizeof(triangle_indices) / sizeof(uint16_t))
 
-	char *contents = arena_alloc(&global_arena, length * sizeof(char));
-	if (fread(contents, sizeof(char), length, file) != (unsigned)length) {
-		fprintf(stderr, "[ERROR] failed to read contents of file %s\n", filename);
-		exit(EXIT_FAILURE);
-	}
+// Size of the linear arena that the per-frame streaming geometry buffers
+// are allocated from.
+#define STREAMING_ARENA_SIZE	(1 << 16)
+
+// Descriptor sets that a frame may allocate from its pool between resets.
+#define DESCRIPTOR_SETS_PER_FRAME	4
+
+// Seconds that on-demand rendering waits for events at a time.
+#define ON_DEMAND_WAIT_TIMEOUT	1.0
+
+// Number of frame times kept for the statistics at exit outside of benchmark
+// mode, which keeps every measured frame instead.
+#define FRAME_STATS_CAPACITY	1024
+
+// Size of the host-visible ring that uploads to device-local memory are
+// staged in. Larger uploads are split into several copies.
+#define STAGING_BUFFER_SIZE	(1 << 20)
 
-	fclose(file);
-	return (Buffer){
-		.length = length,
-		.contents = contents,
-	};
-}
 
 Queue_Family_Indices
 find_queue_families(VkPhysicalDevice device, VkSurfaceKHR surface)
 {
 	Queue_Family_Indices indices = {0};
-	Arena_Checkpoint checkpoint = arena_create_checkpoint(&global_arena);
+	Arena_Checkpoint checkpoint = arena_scratch_begin();
 
 	uint32_t n_queue_families = 0;
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &n_queue_families, NULL);
 
-	VkQueueFamilyProperties *queue_families = arena_alloc(&global_arena,
+	VkQueueFamilyProperties *queue_families = arena_alloc_uninitialized(checkpoint.arena,
 		n_queue_families * sizeof(VkQueueFamilyProperties));
 	assert(queue_families);
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &n_queue_families, queue_families);
 
-	for (size_t i = 0; i < n_queue_families; ++i) {
-		if (queue_families[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-			indices.graphics_family_exists = true;
-			indices.graphics_family = i;
-		}
-
+	// Rank every family by the usage it's best suited for, rather than taking
+	// the last match. A lower rank is better.
+	uint32_t graphics_rank = UINT32_MAX;
+	uint32_t presentation_rank = UINT32_MAX;
+	uint32_t transfer_rank = UINT32_MAX;
+	uint32_t compute_rank = UINT32_MAX;
+	for (uint32_t i = 0; i < n_queue_families; ++i) {
+		VkQueueFlags flags = queue_families[i].queueFlags;
+		if (queue_families[i].queueCount == 0) continue;
+
+		// Without a surface, i.e. when rendering headless, nothing is presented.
 		VkBool32 presentation_support = false;
-		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation_support);
+		if (surface != VK_NULL_HANDLE) vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentation_support);
+
+		// Graphics and presentation on the same family is preferred, since the
+		// renderer can then use one queue for both.
+		if (flags & VK_QUEUE_GRAPHICS_BIT) {
+			uint32_t rank = presentation_support ? 0 : 1;
+			if (rank < graphics_rank) {
+				graphics_rank = rank;
+				indices.graphics_family_exists = true;
+				indices.graphics_family = i;
+				indices.graphics_timestamp_valid_bits = queue_families[i].timestampValidBits;
+			}
+		}
 		if (presentation_support) {
-			indices.presentation_family_exists = true;
-			indices.presentation_family = i;
+			uint32_t rank = flags & VK_QUEUE_GRAPHICS_BIT ? 0 : 1;
+			if (rank < presentation_rank) {
+				presentation_rank = rank;
+				indices.presentation_family_exists = true;
+				indices.presentation_family = i;
+			}
+		}
+
+		// A transfer-only family usually maps to a dedicated DMA engine. A
+		// compute family with transfer support is the next best option.
+		// NOTE Graphics and compute families implicitly support transfers, but
+		// a family without graphics is the point here.
+		if (!(flags & VK_QUEUE_GRAPHICS_BIT) && (flags & (VK_QUEUE_TRANSFER_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			uint32_t rank = flags & VK_QUEUE_COMPUTE_BIT ? 1 : 0;
+			if (rank < transfer_rank) {
+				transfer_rank = rank;
+				indices.transfer_family_exists = true;
+				indices.transfer_family = i;
+			}
+		}
+
+		// Asynchronous compute prefers a family that does nothing else but
+		// compute and transfers.
+		if (!(flags & VK_QUEUE_GRAPHICS_BIT) && (flags & VK_QUEUE_COMPUTE_BIT)) {
+			uint32_t rank = flags & ~(VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT) ? 1 : 0;
+			if (rank < compute_rank) {
+				compute_rank = rank;
+				indices.compute_family_exists = true;
+				indices.compute_family = i;
+			}
 		}
+	}
 
-		if (indices.graphics_family_exists && indices.presentation_family_exists) break;
+	// Headless rendering has no use for a presentation family, so the
+	// graphics family stands in for it.
+	if (surface == VK_NULL_HANDLE) {
+		indices.presentation_family_exists = indices.graphics_family_exists;
+		indices.presentation_family = indices.graphics_family;
 	}
 
 	arena_restore(checkpoint);
 	return indices;
 }
 
-VkShaderModule
-create_shader_module(VkDevice device, Buffer shader_source)
+bool
+device_supports_extension(VkPhysicalDevice device, const char *extension)
+{
+	bool supported = false;
+	Arena_Checkpoint checkpoint = arena_scratch_begin();
+
+	uint32_t n_extensions = 0;
+	vkEnumerateDeviceExtensionProperties(device, NULL, &n_extensions, NULL);
+
+	VkExtensionProperties *extensions = arena_alloc_uninitialized(checkpoint.arena,
+		n_extensions * sizeof(VkExtensionProperties));
+	assert(extensions);
+	vkEnumerateDeviceExtensionProperties(device, NULL, &n_extensions, extensions);
+
+	for (size_t i = 0; i < n_extensions; ++i) {
+		if (strcmp(extensions[i].extensionName, extension) == 0) {
+			supported = true;
+			break;
+		}
+	}
+
+	arena_restore(checkpoint);
+	return supported;
+}
+
+// Rank a physical device by how well it suits rendering to the surface, or
+// offscreen without one. Unsuitable devices, which lack a required queue
+// family, extension, or surface support, score -1.
+int64_t
+score_physical_device(VkPhysicalDevice device, const VkPhysicalDeviceProperties *properties,
+	Queue_Family_Indices indices, VkSurfaceKHR surface, VkPresentModeKHR present_mode)
+{
+	if (!indices.graphics_family_exists || !indices.presentation_family_exists) return -1;
+	for (size_t i = 0; surface != VK_NULL_HANDLE && i < DEVICE_EXTENSIONS_LENGTH; ++i) {
+		if (!device_supports_extension(device, device_extensions[i])) return -1;
+	}
+
+	int64_t score = 0;
+	Arena_Checkpoint checkpoint = arena_scratch_begin();
+
+	// The device type dominates the score: a discrete GPU is nearly always
+	// faster than an integrated one, regardless of anything below.
+	switch (properties->deviceType) {
+	case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 100000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 10000; break;
+	case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 1000; break;
+	default: break;
+	}
+
+	// Prefer more dedicated memory, counted in units of 64 MiB.
+	VkPhysicalDeviceMemoryProperties memory_properties = {0};
+	vkGetPhysicalDeviceMemoryProperties(device, &memory_properties);
+	VkDeviceSize device_local_size = 0;
+	for (size_t i = 0; i < memory_properties.memoryHeapCount; ++i) {
+		VkMemoryHeap heap = memory_properties.memoryHeaps[i];
+		if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) device_local_size = MAX(device_local_size, heap.size);
+	}
+	score += device_local_size >> 26;
+
+	// Graphics and presentation in the same queue family avoid transferring
+	// ownership of swapchain images between queues.
+	if (indices.graphics_family == indices.presentation_family) score += 500;
+
+	if (surface == VK_NULL_HANDLE) goto done;
+
+	/* Surface formats. */
+	uint32_t n_formats = 0;
+	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &n_formats, NULL);
+	if (n_formats == 0) {
+		score = -1;
+		goto done;
+	}
+
+	VkSurfaceFormatKHR *formats = arena_alloc_uninitialized(checkpoint.arena, n_formats * sizeof(VkSurfaceFormatKHR));
+	assert(formats);
+	vkGetPhysicalDeviceSurfaceFormatsKHR(device, surface, &n_formats, formats);
+	for (size_t i = 0; i < n_formats; ++i) {
+		if (formats[i].format == VK_FORMAT_B8G8R8A8_SRGB &&
+				formats[i].colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+			score += 100;
+			break;
+		}
+	}
+
+	/* Present modes. */
+	uint32_t n_present_modes = 0;
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &n_present_modes, NULL);
+	if (n_present_modes == 0) {
+		score = -1;
+		goto done;
+	}
+
+	VkPresentModeKHR *present_modes = arena_alloc_uninitialized(checkpoint.arena,
+		n_present_modes * sizeof(VkPresentModeKHR));
+	assert(present_modes);
+	vkGetPhysicalDeviceSurfacePresentModesKHR(device, surface, &n_present_modes, present_modes);
+	for (size_t i = 0; i < n_present_modes; ++i) {
+		if (present_modes[i] == present_mode) {
+			score += 100;
+			break;
+		}
+	}
+
+done:
+	arena_restore(checkpoint);
+	return score;
+}
+
+// Format a UUID in the usual 8-4-4-4-12 spelling, which options_parse()
+// accepts for forcing a device.
+void
+format_uuid(const uint8_t uuid[VK_UUID_SIZE], char string[2 * VK_UUID_SIZE + 5])
+{
+	char *c = string;
+	for (size_t i = 0; i < VK_UUID_SIZE; ++i) {
+		if (i == 4 || i == 6 || i == 8 || i == 10) *c++ = '-';
+		c += sprintf(c, "%02x", uuid[i]);
+	}
+}
+
+// Query a single extended feature structure of the physical device, e.g.
+// VkPhysicalDeviceTimelineSemaphoreFeatures.
+void
+query_device_features(VkPhysicalDevice device, void *features)
+{
+	VkPhysicalDeviceFeatures2 features2 = {
+		.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		.pNext = features,
+	};
+	vkGetPhysicalDeviceFeatures2(device, &features2);
+}
+
+// Add an extended feature structure to the chain passed to vkCreateDevice().
+void
+enable_device_features(VkPhysicalDeviceFeatures2 *features2, void *features)
+{
+	VkBaseOutStructure *base = features;
+	base->pNext = features2->pNext;
+	features2->pNext = base;
+}
+
+// The GLFW callbacks post events to the queue in the window's user pointer,
+// whether or not the thread that renders is the one that pumps them.
+void
+post_event(GLFWwindow *window, Event event)
+{
+	Event_Queue *events = glfwGetWindowUserPointer(window);
+	event.time = timer_now();
+
+	// NOTE A full queue means the renderer has plenty of events to handle
+	// already, so dropping one doesn't lose a frame.
+	event_queue_push(events, &event);
+}
+
+void
+framebuffer_size_callback(GLFWwindow *window, int width, int height)
+{
+	Event_Queue *events = glfwGetWindowUserPointer(window);
+	event_queue_post_resize(events, width, height);
+}
+
+void
+window_close_callback(GLFWwindow *window)
+{
+	Event_Queue *events = glfwGetWindowUserPointer(window);
+	event_queue_post_close(events);
+}
+
+// The window was exposed or damaged, and its contents have to be redrawn.
+void
+window_refresh_callback(GLFWwindow *window)
+{
+	post_event(window, (Event){ .type = EVENT_REFRESH });
+}
+
+void
+key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+	post_event(window, (Event){
+		.type = EVENT_KEY,
+		.key = { .key = key, .scancode = scancode, .action = action, .mods = mods },
+	});
+}
+
+void
+cursor_position_callback(GLFWwindow *window, double x, double y)
+{
+	post_event(window, (Event){ .type = EVENT_CURSOR_POSITION, .cursor_position = { .x = x, .y = y } });
+}
+
+void
+mouse_button_callback(GLFWwindow *window, int button, int action, int mods)
+{
+	post_event(window, (Event){
+		.type = EVENT_MOUSE_BUTTON,
+		.mouse_button = { .button = button, .action = action, .mods = mods },
+	});
+}
+
+void
+window_focus_callback(GLFWwindow *window, int focused)
+{
+	post_event(window, (Event){ .type = EVENT_FOCUS, .focused = focused });
+}
+
+VkExtent2D
+get_window_extent(GLFWwindow *window)
+{
+	int width = 0;
+	int height = 0;
+	glfwGetFramebufferSize(window, &width, &height);
+	return (VkExtent2D){ .width = width, .height = height };
+}
+
+// Set once headless rendering is asked to stop, since there's no window to
+// close.
+static volatile sig_atomic_t quit_requested = 0;
+
+void
+quit_signal_handler(int signal)
+{
+	(void)signal;
+	quit_requested = 1;
+}
+
+// Whether any of the instance's bounding square lies in the viewport, once
+// it's transformed by the draw's `draw_scale` and `draw_offset`. This must
+// match the test in shaders/cull.comp.
+bool
+instance_on_screen(const Instance *instance, const float draw_scale[2], const float draw_offset[2])
+{
+	float half_scale = 0.5f * instance->scale;
+	for (int i = 0; i < 2; ++i) {
+		float center = instance->offset[i] * draw_scale[i] + draw_offset[i];
+		float extent = half_scale * draw_scale[i];
+		if (center + extent < -1.0f || center - extent > 1.0f) return false;
+	}
+	return true;
+}
+
+// Lay the instances out in a square grid, and pulse their size over time so
+// that every frame has new data to upload. A single instance covers the
+// window like the plain triangle does, whatever the layout. This returns how
+// many of the instances are on screen in a draw with `draw_scale` and
+// `draw_offset`, which is how many culling keeps.
+uint32_t
+write_instances(Instance *instances, uint32_t n_instances, Instance_Layout layout, const float draw_scale[2],
+	const float draw_offset[2], uint64_t time)
+{
+	if (n_instances == 1) {
+		instances[0] = (Instance){ .offset = { 0.0f, 0.0f }, .scale = 1.0f, .color = { 1.0f, 1.0f, 1.0f } };
+		return 1;
+	}
+
+	uint32_t n_columns = 1;
+	while (n_columns * n_columns < n_instances) ++n_columns;
+	float span = layout == INSTANCE_LAYOUT_SPREAD ? 3.0f : 1.0f;
+	float cell = 2.0f * span / n_columns;
+
+	uint32_t n_on_screen = 0;
+
+	uint64_t ms = time / 1000000;
+	for (uint32_t i = 0; i < n_instances; ++i) {
+		// A triangle wave in [0, 1] with a period of two seconds, out of phase
+		// between neighbours.
+		float phase = (float)((ms + i * 97) % 2000) / 1000.0f;
+		float pulse = phase < 1.0f ? phase : 2.0f - phase;
+
+		instances[i] = (Instance){
+			.offset = {
+				-span + cell * (i % n_columns + 0.5f),
+				-span + cell * (i / n_columns + 0.5f),
+			},
+			.scale = cell * (0.6f + 0.3f * pulse),
+			.color = {
+				0.4f + 0.6f * (float)(i * 37 % 256) / 255.0f,
+				0.4f + 0.6f * (float)(i * 91 % 256) / 255.0f,
+				0.4f + 0.6f * (float)(i * 53 % 256) / 255.0f,
+			},
+		};
+		if (instance_on_screen(&instances[i], draw_scale, draw_offset)) ++n_on_screen;
+	}
+
+	return n_on_screen;
+}
+
+int
+compare_draw_depths(const void *a, const void *b)
+{
+	float x = ((const Draw_Item *)a)->depth;
+	float y = ((const Draw_Item *)b)->depth;
+	return (x > y) - (x < y);
+}
+
+// Record a slice of the draw list, which draws the triangle over and over.
+// It's a Record_Function so that it can record both inline into the primary
+// command buffer and into secondary command buffers on worker threads.
+void
+record_draws(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t n_draws, void *context)
+{
+	const Draw_Context *draw = context;
+	if (n_draws == 0) return;
+
+	// Define the viewport and the scissor rectangle dynamically as specified
+	// when initializing the pipeline.
+	VkViewport viewport = {
+		.x = 0.0f,
+		.y = 0.0f,
+		.width = draw->extent.width,
+		.height = draw->extent.height,
+		.minDepth = 0.0f,
+		.maxDepth = 1.0f,
+	};
+	VkRect2D scissor = {
+		.offset = {0, 0},
+		.extent = draw->extent,
+	};
+	vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+	vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+	VkBuffer vertex_buffers[] = { draw->vertex_buffer, draw->instance_buffer };
+	VkDeviceSize vertex_offsets[] = { 0, draw->instance_offset };
+	vkCmdBindVertexBuffers(command_buffer, 0, 2, vertex_buffers, vertex_offsets);
+	vkCmdBindIndexBuffer(command_buffer, draw->index_buffer, 0, VK_INDEX_TYPE_UINT16);
+
+	Draw_Constants constants = { .tint = { 1.0f, 1.0f, 1.0f, 1.0f } };
+	VkPipeline bound_pipeline = VK_NULL_HANDLE;
+	for (uint32_t i = 0; i < n_draws; ++i) {
+		const Draw_Item *item = &draw->draw_list[first_draw + i];
+
+		// Only switch pipelines between draws of different variants. Binding
+		// a pipeline also leaves the dynamic state and the bindings above
+		// intact, since every variant shares the layout.
+		if (item->pipeline != bound_pipeline) {
+			vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, item->pipeline);
+			bound_pipeline = item->pipeline;
+		}
+
+		// Rebinding the same set with another dynamic offset is all it takes
+		// to switch to another draw's uniforms.
+		uint32_t uniform_offset = item->uniform_offset;
+		vkCmdBindDescriptorSets(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw->layout, 0, 1,
+			&draw->descriptor_set, 1, &uniform_offset);
+		vkCmdPushConstants(command_buffer, draw->layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(constants),
+			&constants);
+
+		if (draw->culler) {
+			culler_draw(draw->culler, draw->frame, command_buffer);
+		} else {
+			vkCmdDrawIndexed(command_buffer, TRIANGLE_INDICES_LENGTH, draw->n_instances, 0, 0, 0);
+		}
+	}
+}
+
+// Apply every event posted since the last call. Any input dirties the scene:
+// the renderer doesn't react to input yet, but a frame that does belongs
+// right after it.
+void
+renderer_handle_events(Renderer *renderer)
+{
+	if (renderer->headless) {
+		if (quit_requested) renderer->quit = true;
+		return;
+	}
+
+	Event event = {0};
+	while (event_queue_pop(renderer->events, &event)) {
+		renderer->scene_dirty = true;
+		renderer->scene_time = event.time;
+		++renderer->n_events;
+	}
+
+	uint32_t width = 0;
+	uint32_t height = 0;
+	if (event_queue_take_resize(renderer->events, &width, &height)) {
+		renderer->window_extent = (VkExtent2D){ .width = width, .height = height };
+		renderer->framebuffer_resized = true;
+		renderer->scene_dirty = true;
+		renderer->scene_time = timer_now();
+	}
+
+	if (event_queue_close_requested(renderer->events)) renderer->quit = true;
+}
+
+// Sleep until an event is posted or the timeout in seconds expires, and
+// handle whatever was posted.
+void
+renderer_wait_events(Renderer *renderer, double timeout)
+{
+	if (renderer->render_thread) {
+		event_queue_wait(renderer->events, timeout);
+	} else if (!renderer->headless) {
+		glfwWaitEventsTimeout(timeout);
+	}
+	renderer_handle_events(renderer);
+}
+
+void
+renderer_poll_events(Renderer *renderer)
+{
+	if (!renderer->render_thread && !renderer->headless) glfwPollEvents();
+	renderer_handle_events(renderer);
+}
+
+// Queue rebuilds of the pipelines that use the shaders recompiled since the
+// last frame. The old pipelines keep drawing until the rebuilds are ready.
+void
+reload_shaders(Renderer *renderer)
+{
+	Shader_Watcher *watcher = renderer->shader_watcher;
+	uint32_t compiled = shader_watcher_take(watcher);
+	for (uint32_t i = 0; i < watcher->n_sources; ++i) {
+		if (!(compiled & 1u << i)) continue;
+		pipeline_variants_reload(renderer->pipelines, renderer->shaders, watcher->sources[i].stage,
+			watcher->sources[i].output);
+	}
+}
+
+// Rebuild the swapchain after the surface changed. Only the submissions that
+// own an image can still reference the old images, so waiting on those is
+// enough -- there's no need to drain the entire device with vkDeviceWaitIdle().
+void
+recreate_swapchain(Renderer *renderer)
+{
+	// A minimized window has a zero-sized framebuffer, and no swapchain can be
+	// created for it. Sleep until the window is visible again.
+	renderer_handle_events(renderer);
+	while (!renderer->quit && (renderer->window_extent.width == 0 || renderer->window_extent.height == 0)) {
+		renderer_wait_events(renderer, ON_DEMAND_WAIT_TIMEOUT);
+	}
+	if (renderer->quit) return;
+
+	frame_sync_wait(renderer->sync, swapchain_latest_submission(renderer->swapchain));
+	swapchain_recreate(renderer->swapchain, renderer->window_extent);
+	render_attachments_create(renderer->attachments, renderer->swapchain->extent);
+	if (!renderer->dynamic_rendering) {
+		swapchain_create_framebuffers(renderer->swapchain, renderer->render_pass, renderer->attachments->n_views,
+			renderer->attachments->views);
+	}
+	renderer->framebuffer_resized = false;
+
+	// Nothing has been drawn to the new images yet.
+	renderer->scene_dirty = true;
+}
+
+// Begin rendering the frame to its framebuffer with the render pass backend,
+// or to its target with dynamic rendering. The draws are recorded inline or
+// come from secondary command buffers.
+void
+begin_rendering(const Renderer *renderer, VkCommandBuffer command_buffer, VkFramebuffer framebuffer,
+	const Rendering_Target *target, VkExtent2D extent, bool secondary)
+{
+	VkClearColorValue clear_color = {{0.0f, 0.0f, 0.0f, 1.0f}};
+	const Render_Attachments *attachments = renderer->attachments;
+
+	if (renderer->dynamic_rendering) {
+		dynamic_rendering_begin(renderer->dynamic_rendering, command_buffer, target, attachments, extent,
+			clear_color, secondary ? VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT : 0);
+		return;
+	}
+
+	// Only the multisampled color image is cleared when there is one, but
+	// clear values are indexed by attachment, so every attachment gets one.
+	// Depth, the last attachment, clears to the far plane.
+	VkClearValue clear_values[1 + RENDER_ATTACHMENTS_MAX] = {0};
+	for (uint32_t i = 0; i < attachments->n_views; ++i) clear_values[i].color = clear_color;
+	clear_values[attachments->n_views].depthStencil = (VkClearDepthStencilValue){ 1.0f, 0 };
+
+	VkRenderPassBeginInfo render_pass_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+		.renderPass = renderer->render_pass,
+		.framebuffer = framebuffer,
+		.renderArea = {
+			.offset = {0, 0},
+			.extent = extent,
+		},
+		.clearValueCount = 1 + attachments->n_views,
+		.pClearValues = clear_values,
+	};
+	vkCmdBeginRenderPass(command_buffer, &render_pass_info,
+		secondary ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
+}
+
+void
+end_rendering(const Renderer *renderer, VkCommandBuffer command_buffer, const Rendering_Target *target)
+{
+	if (renderer->dynamic_rendering) {
+		dynamic_rendering_end(renderer->dynamic_rendering, command_buffer, target);
+	} else {
+		vkCmdEndRenderPass(command_buffer);
+	}
+}
+
+// Record, submit, and present the next frame.
+void
+render_frame(Renderer *renderer)
 {
-	VkShaderModuleCreateInfo shader_module_info = {
-		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-		.codeSize = shader_source.length,
-		.pCode = (uint32_t *)shader_source.contents,
+	const Options *options = renderer->options;
+	Profiler *profiler = renderer->profiler;
+	Frame_Sync *sync = renderer->sync;
+	Swapchain *swapchain = renderer->swapchain;
+	uint32_t current_frame = renderer->current_frame;
+	if (renderer->n_frames_rendered == 0) startup_begin(renderer->startup, STARTUP_FIRST_PRESENT);
+
+	// Wait an unbounded amonut of time for the previous frame to finish.
+	uint64_t wait_start = timer_now();
+	frame_sync_wait_frame(sync, current_frame);
+	profiler_cpu_scope(profiler, "wait", wait_start, timer_now());
+	arena_free(&frame_arena);
+	frame_context_reset(&renderer->frame_contexts[current_frame]);
+	descriptor_allocator_reset(renderer->descriptors, current_frame);
+	uniform_ring_reset(renderer->uniforms, current_frame);
+
+	// Between frames is where rebuilt pipelines are swapped in, and the ones
+	// they replace are destroyed once no frame in flight uses them anymore.
+	if (renderer->shader_watcher) reload_shaders(renderer);
+	pipeline_variants_update(renderer->pipelines, renderer->n_frames_rendered, renderer->n_frames_in_flight);
+
+	// Offscreen images belong to their frame, so the frame's previous
+	// submission is complete with the wait above, and so is the copy of its
+	// image into the readback buffer. Hand the pixels to the consumer before
+	// this frame overwrites them, while the GPU is still busy with the other
+	// frames in flight.
+	uint32_t image_index = current_frame;
+	VkResult result = VK_SUCCESS;
+	if (renderer->headless) {
+		if (offscreen_read(renderer->offscreen, current_frame)) ++renderer->n_frames_read_back;
+	} else {
+		// Get an index to an image from the swapchain.
+		uint64_t acquire_start = timer_now();
+		result = swapchain_acquire(swapchain, sync->image_available[current_frame], &image_index);
+		profiler_cpu_scope(profiler, "acquire", acquire_start, timer_now());
+		if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+			// The swapchain can no longer present to the surface. Nothing was
+			// submitted for this frame, so the frame is simply retried against
+			// the new swapchain.
+			recreate_swapchain(renderer);
+			return;
+		} else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+			// NOTE A suboptimal swapchain still presents correctly, so finish
+			// the frame and recreate the swapchain after presenting it.
+			fprintf(stderr, "[ERROR] failed to acquire swapchain image\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// The image may still be in use by an older frame than the previous
+		// user of this frame's resources, e.g. if acquire returns images out
+		// of order. Wait for that frame too.
+		frame_sync_wait(sync, swapchain->images_in_flight[image_index]);
+	}
+	// Dynamic rendering goes straight to the image, without a framebuffer.
+	VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	Rendering_Target target = {0};
+	if (renderer->headless) {
+		Offscreen_Frame *frame = &renderer->offscreen->frames[current_frame];
+		framebuffer = frame->framebuffer;
+		target = (Rendering_Target){
+			.image = frame->image.handle,
+			.view = frame->image.view,
+			.final_layout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		};
+	} else {
+		if (!renderer->dynamic_rendering) framebuffer = swapchain->framebuffers[image_index];
+		target = (Rendering_Target){
+			.image = swapchain->images[image_index],
+			.view = swapchain->image_views[image_index],
+			.final_layout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+		};
+	}
+	VkExtent2D extent = renderer->headless ? renderer->offscreen->extent : swapchain->extent;
+
+	// Streamed geometry is written straight into this frame's mapped
+	// buffers, which the GPU finished reading with the wait above.
+	Gpu_Buffer *vertex_buffer = &renderer->vertex_buffers[0];
+	Gpu_Buffer *index_buffer = &renderer->index_buffers[0];
+	if (options->geometry == GEOMETRY_STREAMING) {
+		vertex_buffer = &renderer->vertex_buffers[current_frame];
+		index_buffer = &renderer->index_buffers[current_frame];
+		memcpy(vertex_buffer->allocation.mapped, triangle_vertices, sizeof(triangle_vertices));
+		memcpy(index_buffer->allocation.mapped, triangle_indices, sizeof(triangle_indices));
+	}
+
+	// Keep the proportions the triangle has in a window of the default size,
+	// whatever the extent.
+	float reference_aspect = (float)WINDOW_WIDTH / WINDOW_HEIGHT;
+	float aspect = extent.height > 0 ? (float)extent.width / extent.height : reference_aspect;
+	Draw_Uniforms draw_uniforms = {
+		.scale = {
+			aspect > reference_aspect ? reference_aspect / aspect : 1.0f,
+			aspect > reference_aspect ? 1.0f : aspect / reference_aspect,
+		},
+		.offset = { 0.0f, 0.0f },
 	};
 
-	VkShaderModule shader_module = {0};
-	if (vkCreateShaderModule(device, &shader_module_info, NULL, &shader_module) != VK_SUCCESS) {
-		fprintf(stderr, "[ERROR] failed to create shader module\n");
-		exit(EXIT_FAILURE);
+	VkDeviceSize instance_offset = current_frame * renderer->instance_region_size;
+	// On demand, the scene only moves on when an event dirties it.
+	uint32_t n_instances_on_screen = write_instances(
+		(Instance *)((unsigned char *)renderer->instance_ring->allocation.mapped + instance_offset),
+		options->instances, options->instance_layout, draw_uniforms.scale, draw_uniforms.offset,
+		renderer->on_demand ? renderer->scene_time : timer_now());
+
+	// Every draw's uniforms go into the frame's region of the uniform ring,
+	// and a single set allocated from the frame's pool addresses them all.
+	// The draws stack up as layers in depth, listed back to front the way a
+	// painter would draw them. They're all opaque, so they all draw with the
+	// blend-disabled variant, which is a single lookup away.
+	Draw_Item *draw_list = arena_alloc_uninitialized(&frame_arena, options->draws * sizeof(Draw_Item));
+	assert(draw_list);
+	VkPipeline opaque_pipeline = pipeline_variants_get(renderer->pipelines, renderer->opaque_key);
+	for (uint32_t i = 0; i < options->draws; ++i) {
+		Draw_Uniforms *uniforms = uniform_ring_push(renderer->uniforms, sizeof(Draw_Uniforms),
+			&draw_list[i].uniform_offset);
+		*uniforms = draw_uniforms;
+		uniforms->depth = 1.0f - (float)(i + 1) / (options->draws + 1);
+		draw_list[i].depth = uniforms->depth;
+		draw_list[i].pipeline = opaque_pipeline;
+	}
+
+	// Every draw is opaque, so drawing the nearest ones first lets the depth
+	// test reject the fragments they hide before shading them. The sort costs
+	// CPU time that the profiler reports apart from recording.
+	if (options->sort == SORT_FRONT_TO_BACK) {
+		uint64_t sort_start = timer_now();
+		qsort(draw_list, options->draws, sizeof(Draw_Item), compare_draw_depths);
+		profiler_cpu_scope(profiler, "sort", sort_start, timer_now());
+	}
+
+	VkDescriptorSet descriptor_set = descriptor_allocator_allocate(renderer->descriptors, current_frame,
+		renderer->set_layout);
+	VkDescriptorBufferInfo uniform_info = uniform_ring_descriptor(renderer->uniforms, current_frame,
+		sizeof(Draw_Uniforms));
+	VkWriteDescriptorSet descriptor_write = {
+		.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+		.dstSet = descriptor_set,
+		.dstBinding = 0,
+		.dstArrayElement = 0,
+		.descriptorCount = 1,
+		.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+		.pBufferInfo = &uniform_info,
+	};
+	vkUpdateDescriptorSets(renderer->device, 1, &descriptor_write, 0, NULL);
+
+
+	/* Add draw commands into the buffer for the current frame. */
+	VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+	uint64_t record_start = timer_now();
+	{
+		command_buffer = frame_context_allocate(&renderer->frame_contexts[current_frame]);
+
+		VkCommandBufferBeginInfo begin_info = {
+			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+			.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+			.pInheritanceInfo = NULL,
+		};
+		if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to begin recording command buffer\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// Collect the timestamps that this frame's previous submission
+		// wrote, which is complete by now.
+		profiler_begin_frame(profiler, current_frame, command_buffer);
+
+		Draw_Context draw = {
+			.layout = renderer->layout,
+			.extent = extent,
+			.vertex_buffer = vertex_buffer->handle,
+			.index_buffer = index_buffer->handle,
+			.instance_buffer = renderer->instance_ring->handle,
+			.instance_offset = instance_offset,
+			.n_instances = options->instances,
+			.descriptor_set = descriptor_set,
+			.draw_list = draw_list,
+			.culler = renderer->gpu_culling ? renderer->culler : NULL,
+			.frame = current_frame,
+		};
+
+		// Cull ahead of the render pass, which can't contain dispatches.
+		if (renderer->gpu_culling) {
+			uint32_t query = profiler_gpu_begin(profiler, current_frame, command_buffer, "cull");
+			culler_dispatch(renderer->culler, current_frame, draw_uniforms.scale, draw_uniforms.offset,
+				command_buffer);
+			profiler_gpu_end(profiler, current_frame, command_buffer, query);
+		}
+
+		uint32_t render_pass_query = profiler_gpu_begin(profiler, current_frame, command_buffer, "render pass");
+
+		if (options->record_threads > 0) {
+			// Secondary command buffers inherit the attachments' formats
+			// instead of a render pass and framebuffer with dynamic rendering.
+			const Render_Attachments *attachments = renderer->attachments;
+			VkCommandBufferInheritanceRenderingInfo inheritance_rendering = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+				.colorAttachmentCount = 1,
+				.pColorAttachmentFormats = &attachments->color_format,
+				.depthAttachmentFormat = attachments->depth_format,
+				.stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+				.rasterizationSamples = attachments->samples,
+			};
+			VkCommandBufferInheritanceInfo inheritance = {
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO,
+				.pNext = renderer->dynamic_rendering ? &inheritance_rendering : NULL,
+				.renderPass = renderer->render_pass,
+				.subpass = 0,
+				.framebuffer = framebuffer,
+			};
+			recorder_record(renderer->recorder, current_frame, &inheritance, options->draws, record_draws, &draw);
+
+			begin_rendering(renderer, command_buffer, framebuffer, &target, extent, true);
+			recorder_execute(renderer->recorder, current_frame, command_buffer);
+		} else {
+			begin_rendering(renderer, command_buffer, framebuffer, &target, extent, false);
+
+			uint64_t start = timer_now();
+			record_draws(command_buffer, 0, options->draws, &draw);
+			renderer->inline_recording_ns += timer_now() - start;
+			++renderer->n_inline_frames;
+		}
+		end_rendering(renderer, command_buffer, &target);
+		profiler_gpu_end(profiler, current_frame, command_buffer, render_pass_query);
+
+		if (renderer->headless) {
+			uint32_t query = profiler_gpu_begin(profiler, current_frame, command_buffer, "readback");
+			offscreen_record_readback(renderer->offscreen, current_frame, command_buffer);
+			profiler_gpu_end(profiler, current_frame, command_buffer, query);
+		}
+
+		if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to record command buffer\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	profiler_cpu_scope(profiler, "record", record_start, timer_now());
+
+	// Submit the newly recorded command buffer, and claim the image for this
+	// submission. Offscreen frames don't wait on an acquired image.
+	uint64_t submit_start = timer_now();
+	if (renderer->headless) {
+		frame_sync_submit(sync, current_frame, renderer->graphics_queue, 1, &command_buffer, 0);
+	} else {
+		swapchain->images_in_flight[image_index] = frame_sync_submit(sync, current_frame,
+			renderer->graphics_queue, 1, &command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+	}
+	profiler_cpu_scope(profiler, "submit", submit_start, timer_now());
+
+	// Display the rendered image.
+	if (!renderer->headless) {
+		uint64_t present_start = timer_now();
+		result = swapchain_present(swapchain, renderer->present_queue, sync->render_finished[current_frame],
+			image_index);
+		profiler_cpu_scope(profiler, "present", present_start, timer_now());
+
+		// Pick up a resize that happened while the frame was recorded.
+		renderer_handle_events(renderer);
+		if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR || renderer->framebuffer_resized) {
+			recreate_swapchain(renderer);
+		} else if (result != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to present swapchain image\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	// Startup is over once the first frame is on its way to the screen.
+	if (renderer->n_frames_rendered == 0) {
+		startup_end(renderer->startup, STARTUP_FIRST_PRESENT);
+		startup_timer_print(renderer->startup);
+	}
+
+	++renderer->n_frames_rendered;
+	renderer->current_frame = (current_frame + 1) % renderer->n_frames_in_flight;
+
+	// A frame's time runs from the end of the previous frame, so it covers
+	// everything the loop does, waiting included.
+	uint64_t now = timer_now();
+	if (!renderer->benchmark || renderer->n_frames_rendered > options->warmup_frames) {
+		frame_stats_add(renderer->frame_stats, timer_elapsed_ms(renderer->last_frame_end, now));
+		renderer->n_instances_on_screen += n_instances_on_screen;
+		++renderer->n_frames_measured;
+	}
+	renderer->last_frame_end = now;
+	if (renderer->benchmark &&
+			renderer->n_frames_rendered == (uint64_t)options->warmup_frames + options->bench_frames) {
+		renderer->quit = true;
+	}
+
+	if (options->profile_interval > 0 &&
+			now - renderer->last_report >= options->profile_interval * UINT64_C(1000000000)) {
+		profiler_print(profiler);
+		renderer->last_report = now;
+	}
+}
+
+// Render frames until the window is closed, headless rendering is
+// interrupted, or benchmark mode is done.
+void
+render_loop(Renderer *renderer)
+{
+	renderer->last_report = timer_now();
+	renderer->last_frame_end = renderer->last_report;
+
+	while (!renderer->quit) {
+		// Let the display catch up before sampling input, so the frame about to
+		// be recorded reflects the freshest input once it's finally displayed.
+		if (!renderer->headless) swapchain_pace(renderer->swapchain, renderer->options->max_queued_presents);
+
+		// Start frames no sooner than the cap allows. A deadline that's already
+		// past, e.g. after idling, isn't carried over as credit towards a burst
+		// of frames.
+		if (renderer->frame_interval > 0) {
+			uint64_t now = timer_now();
+			if (renderer->next_frame_start > now) {
+				timer_sleep_until(renderer->next_frame_start);
+				now = renderer->next_frame_start;
+			}
+			renderer->next_frame_start = now + renderer->frame_interval;
+		}
+
+		if (renderer->on_demand) {
+			// NOTE The timeout only bounds the sleep in case a wakeup gets lost;
+			// an event wakes the loop right away, and a timeout alone doesn't
+			// dirty the scene.
+			renderer_handle_events(renderer);
+			while (!renderer->scene_dirty && !renderer->quit) {
+				renderer_wait_events(renderer, ON_DEMAND_WAIT_TIMEOUT);
+			}
+			renderer->scene_dirty = false;
+
+			// Time spent idle isn't part of any frame.
+			renderer->last_frame_end = timer_now();
+		} else {
+			renderer_poll_events(renderer);
+		}
+		if (renderer->quit) break;
+
+		render_frame(renderer);
 	}
+}
+
+void *
+render_thread_main(void *argument)
+{
+	Renderer *renderer = argument;
+	render_loop(renderer);
 
-	return shader_module;
+	// Wake the main thread from glfwWaitEvents() to join this thread.
+	atomic_store_explicit(&renderer->stopped, true, memory_order_release);
+	glfwPostEmptyEvent();
+	return NULL;
+}
+
+// Read the startup files, and fault them in so that creating the shader
+// modules and the pipeline cache from them doesn't wait on the disk.
+void *
+read_startup_files(void *argument)
+{
+	Startup_Files *files = argument;
+
+	startup_begin(files->startup, STARTUP_SHADER_LOAD);
+	shader_code_read("shaders/vert.spv", &files->vert_shader);
+	shader_code_read("shaders/frag.spv", &files->frag_shader);
+	if (files->read_cull_shader) {
+		files->has_cull_shader = shader_code_read_optional("shaders/cull.spv", &files->cull_shader);
+	}
+	startup_end(files->startup, STARTUP_SHADER_LOAD);
+
+	startup_begin(files->startup, STARTUP_PIPELINE_CACHE_READ);
+	if (map_file(PIPELINE_CACHE_FILENAME, &files->pipeline_cache)) prefault_file(&files->pipeline_cache);
+	startup_end(files->startup, STARTUP_PIPELINE_CACHE_READ);
+
+	return NULL;
 }
 
 int
-main(void)
+main(int argc, char **argv)
 {
+	/* ---
+	 * Time every phase of startup, up to the first frame.
+	 * ---
+	 */
+	Startup_Timer startup = {0};
+	startup_timer_init(&startup);
+
+
 	/* ---
 	 * Initialize global linear allocator to simplify memory management.
 	 * ---
 	 */
-	arena_init(&global_arena, global_arena_buffer, ARENA_BUFFER_LENGTH);
+	arena_init_growable(&global_arena, global_arena_buffer, ARENA_BUFFER_LENGTH);
+	arena_init(&frame_arena, frame_arena_buffer, FRAME_ARENA_LENGTH);
+
+
+	/* ---
+	 * Parse runtime options from the command line and the environment.
+	 * ---
+	 */
+	Options options = {0};
+	options_parse(&options, argc, argv);
+
+
+	/* ---
+	 * Read the shaders and the pipeline cache in the background.
+	 *
+	 * They only come into use once the device exists, which takes the window,
+	 * the instance, the surface and the device selection to get to. If the
+	 * thread can't be created, they're read once they're due instead.
+	 * ---
+	 */
+	Startup_Files startup_files = {
+		.startup = &startup,
+		.read_cull_shader = options.culling == CULLING_COMPUTE,
+	};
+	pthread_t startup_files_thread = {0};
+	bool reading_startup_files = pthread_create(&startup_files_thread, NULL, read_startup_files,
+		&startup_files) == 0;
+	if (!reading_startup_files) {
+		fprintf(stderr, "[WARNING] failed to create a thread for reading startup files\n");
+	}
 
 
 	/* ---
 	 * Open a window using GLFW
+	 *
+	 * Headless rendering skips GLFW entirely, and renders until interrupted
+	 * instead of until the window is closed.
 	 * ---
 	 */
+	bool headless = options.display == DISPLAY_HEADLESS;
 	GLFWwindow *window = NULL;
-	{
+	Event_Queue events = {0};
+	event_queue_init(&events);
+	if (headless) {
+		signal(SIGINT, quit_signal_handler);
+		signal(SIGTERM, quit_signal_handler);
+		printf("[INFO] rendering headless at %ux%u\n", WINDOW_WIDTH, WINDOW_HEIGHT);
+	} else {
+		startup_begin(&startup, STARTUP_WINDOW);
 		glfwInit();
 
 		// Do not create an OpenGL context with GLFW.
 		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
 
-		// Disable window resize because it complicates this simple example.
-		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-
 		window = glfwCreateWindow(WINDOW_WIDTH, WINDOW_HEIGHT, WINDOW_TITLE, NULL, NULL);
 		if (window == NULL) {
 			fprintf(stderr, "[ERROR] failed to create window with GLFW\n");
 			exit(EXIT_FAILURE);
 		}
+
+		glfwSetWindowUserPointer(window, &events);
+		glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
+		glfwSetWindowCloseCallback(window, window_close_callback);
+		glfwSetWindowRefreshCallback(window, window_refresh_callback);
+		glfwSetKeyCallback(window, key_callback);
+		glfwSetCursorPosCallback(window, cursor_position_callback);
+		glfwSetMouseButtonCallback(window, mouse_button_callback);
+		glfwSetWindowFocusCallback(window, window_focus_callback);
+		startup_end(&startup, STARTUP_WINDOW);
 	}
 
 
@@ -200,11 +1389,34 @@ main(void)
 	 * Initialze an instance of Vulkan.
 	 * ---
 	 */
+	startup_begin(&startup, STARTUP_INSTANCE);
 	VkInstance instance = {0};
+	uint32_t instance_version = VK_API_VERSION_1_0;
 	{
-		// Query GLFW for the Vulkan extensions it requires.
+		// Query GLFW for the Vulkan extensions it requires. Headless rendering
+		// requires none.
 		uint32_t n_extensions = 0;
-		const char **extensions = glfwGetRequiredInstanceExtensions(&n_extensions);
+		const char **extensions = headless ? NULL : glfwGetRequiredInstanceExtensions(&n_extensions);
+
+		// Request the newest version of Vulkan the renderer has a use for, to
+		// the extent the loader supports it: Vulkan 1.1 to query extended device
+		// features, e.g. for present wait, Vulkan 1.2 for timeline semaphores,
+		// and Vulkan 1.3 for dynamic rendering. Whether the device supports
+		// these is checked separately.
+		// A Vulkan 1.0 loader doesn't export vkEnumerateInstanceVersion at all,
+		// so look it up dynamically.
+		PFN_vkEnumerateInstanceVersion enumerate_instance_version = (PFN_vkEnumerateInstanceVersion)
+			vkGetInstanceProcAddr(VK_NULL_HANDLE, "vkEnumerateInstanceVersion");
+		if (enumerate_instance_version) enumerate_instance_version(&instance_version);
+		if (instance_version >= VK_API_VERSION_1_3) {
+			instance_version = VK_API_VERSION_1_3;
+		} else if (instance_version >= VK_API_VERSION_1_2) {
+			instance_version = VK_API_VERSION_1_2;
+		} else if (instance_version >= VK_API_VERSION_1_1) {
+			instance_version = VK_API_VERSION_1_1;
+		} else {
+			instance_version = VK_API_VERSION_1_0;
+		}
 
 		// NOTE This application info is not strictly required by Vulkan, but it
 		// may provide the driver with some information that enables additional
@@ -217,7 +1429,7 @@ main(void)
 			.applicationVersion = VK_MAKE_VERSION(1, 0, 0),
 			.pEngineName = ENGINE_NAME,
 			.engineVersion = VK_MAKE_VERSION(1, 0, 0),
-			.apiVersion = VK_API_VERSION_1_0,
+			.apiVersion = instance_version,
 		};
 		VkInstanceCreateInfo instance_info = {
 			.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
@@ -237,16 +1449,21 @@ main(void)
 			exit(EXIT_FAILURE);
 		}
 	}
+	startup_end(&startup, STARTUP_INSTANCE);
 
 
 	/* ---
 	 * Initialize a surface with GLFW.
 	 * ---
 	 */
-	VkSurfaceKHR surface = {0};
-	if (glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS) {
-		fprintf(stderr, "[ERROR] failed to create window surface\n");
-		exit(EXIT_FAILURE);
+	VkSurfaceKHR surface = VK_NULL_HANDLE;
+	if (!headless) {
+		startup_begin(&startup, STARTUP_SURFACE);
+		if (glfwCreateWindowSurface(instance, window, NULL, &surface) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create window surface\n");
+			exit(EXIT_FAILURE);
+		}
+		startup_end(&startup, STARTUP_SURFACE);
 	}
 
 
@@ -254,6 +1471,7 @@ main(void)
 	 * Select a physical GPU to use.
 	 * ---
 	 */
+	startup_begin(&startup, STARTUP_DEVICE_SELECTION);
 	Physical_Device physical_device = { .device = VK_NULL_HANDLE };
 	{
 		// Query the number of physical devices available.
@@ -265,37 +1483,89 @@ main(void)
 			exit(EXIT_FAILURE);
 		}
 
-		Arena_Checkpoint checkpoint = arena_create_checkpoint(&global_arena);
+		Arena_Checkpoint checkpoint = arena_scratch_begin();
 
 		// Retrieve a list GPUs in the system that support Vulkan.
-		VkPhysicalDevice *devices = arena_alloc(&global_arena, n_devices * sizeof(VkPhysicalDevice));
+		VkPhysicalDevice *devices = arena_alloc_uninitialized(checkpoint.arena, n_devices * sizeof(VkPhysicalDevice));
 		assert(devices);
 		vkEnumeratePhysicalDevices(instance, &n_devices, devices);
 
-		// Scan all devices to find a suitable device, where a suitable device is
-		// a GPU with support for Vulkan's graphics and present queue families.
-		// That's basically any GPU with Vulkan support.
-		for (size_t i = 0; i < n_devices; ++i) {
+		// Score every device, and pick the best one unless the options force a
+		// specific device.
+		int64_t best_score = -1;
+		uint32_t selected = n_devices;
+		for (uint32_t i = 0; i < n_devices; ++i) {
 			VkPhysicalDevice device = devices[i];
 
+			VkPhysicalDeviceProperties properties = {0};
+			vkGetPhysicalDeviceProperties(device, &properties);
+
 			// TODO Define find_queue_families() inline here since it's not used
 			// elsewhere. Rename `presentation_family` too.
 			Queue_Family_Indices indices = find_queue_families(device, surface);
-			if (indices.graphics_family_exists && indices.presentation_family_exists) {
+			int64_t score = score_physical_device(device, &properties, indices, surface, options.present_mode);
+
+			// The device UUID requires Vulkan 1.1, so older devices can only be
+			// forced by their index.
+			bool has_uuid = instance_version >= VK_API_VERSION_1_1 && properties.apiVersion >= VK_API_VERSION_1_1;
+			VkPhysicalDeviceIDProperties id_properties = {
+				.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES,
+			};
+			char uuid[2 * VK_UUID_SIZE + 5] = "unknown";
+			if (has_uuid) {
+				VkPhysicalDeviceProperties2 properties2 = {
+					.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2,
+					.pNext = &id_properties,
+				};
+				vkGetPhysicalDeviceProperties2(device, &properties2);
+				format_uuid(id_properties.deviceUUID, uuid);
+			}
+
+			printf("[INFO] device %u: %s, uuid %s, score %" PRId64 "\n", i, properties.deviceName, uuid, score);
+
+			bool forced = false;
+			switch (options.device_selection) {
+			case DEVICE_SELECTION_INDEX:
+				forced = i == options.device_index;
+				break;
+			case DEVICE_SELECTION_UUID:
+				forced = has_uuid && memcmp(id_properties.deviceUUID, options.device_uuid, VK_UUID_SIZE) == 0;
+				break;
+			default:
+				break;
+			}
+
+			if (forced || (options.device_selection == DEVICE_SELECTION_AUTO && score > best_score)) {
+				if (forced && score < 0) {
+					fprintf(stderr, "[ERROR] the requested GPU %s is not suitable for rendering\n",
+						properties.deviceName);
+					exit(EXIT_FAILURE);
+				}
+
+				best_score = score;
+				selected = i;
 				physical_device.device = device;
 				physical_device.indices = indices;
-				break;
 			}
 		}
 
 		if (physical_device.device == VK_NULL_HANDLE) {
-			fprintf(stderr, "[ERROR] failed to find a suitable GPU\n");
+			if (options.device_selection == DEVICE_SELECTION_AUTO) {
+				fprintf(stderr, "[ERROR] failed to find a suitable GPU\n");
+			} else {
+				fprintf(stderr, "[ERROR] failed to find the requested GPU\n");
+			}
 			exit(EXIT_FAILURE);
 		}
 
+		vkGetPhysicalDeviceProperties(physical_device.device, &physical_device.properties);
+		printf("[INFO] selected device %u: %s (score %" PRId64 ")\n", selected,
+			physical_device.properties.deviceName, best_score);
+
 		// The other physical devices are no longer necessary to store in memory.
 		arena_restore(checkpoint);
 	}
+	startup_end(&startup, STARTUP_DEVICE_SELECTION);
 
 
 	/* ---
@@ -303,9 +1573,12 @@ main(void)
 	 * the selected physical device.
 	 * ---
 	 */
+	startup_begin(&startup, STARTUP_DEVICE_CREATION);
 	VkDevice device = {0};
 	VkQueue graphics_queue = {0};
 	VkQueue present_queue = {0};
+	VkQueue transfer_queue = {0};
+	Device_Capabilities capabilities = {0};
 	{
 		// FIXME These queue families are not required to be the same, though they
 		// often are. For now, this assumption simplifies the code. That being
@@ -313,22 +1586,168 @@ main(void)
 		// same queue is faster.
 		assert(physical_device.indices.graphics_family == physical_device.indices.presentation_family);
 
-		float queue_priority = 1.0f;
-		VkDeviceQueueCreateInfo queue_info = {
-			.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-			.queueFamilyIndex = physical_device.indices.graphics_family,
-			.queueCount = 1,
-			.pQueuePriorities = &queue_priority,
+		// Create one queue per distinct family that gets work. The culling
+		// dispatch is recorded into the frame's graphics command buffer, so the
+		// async compute family is only reported, not given a queue.
+		const Queue_Family_Indices *indices = &physical_device.indices;
+		uint32_t queue_families[2] = { indices->graphics_family };
+		uint32_t n_queue_families = 1;
+		if (indices->transfer_family_exists) queue_families[n_queue_families++] = indices->transfer_family;
+
+		float queue_priority = 1.0f;
+		VkDeviceQueueCreateInfo queue_infos[2] = {0};
+		for (size_t i = 0; i < n_queue_families; ++i) {
+			queue_infos[i] = (VkDeviceQueueCreateInfo){
+				.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+				.queueFamilyIndex = queue_families[i],
+				.queueCount = 1,
+				.pQueuePriorities = &queue_priority,
+			};
+		}
+
+		const char *enabled_extensions[MAX_ENABLED_DEVICE_EXTENSIONS] = {0};
+		uint32_t n_enabled_extensions = 0;
+		for (size_t i = 0; !headless && i < DEVICE_EXTENSIONS_LENGTH; ++i) {
+			enabled_extensions[n_enabled_extensions++] = device_extensions[i];
+		}
+
+		// Extended features are chained onto VkPhysicalDeviceFeatures2, first
+		// to query what the device supports and then to enable the subset
+		// that's used. Both require Vulkan 1.1 on the instance and the device.
+		bool has_features2 = instance_version >= VK_API_VERSION_1_1 &&
+			physical_device.properties.apiVersion >= VK_API_VERSION_1_1;
+
+		// NOTE Only the core features that are used get enabled. Enabling
+		// everything the device supports isn't free -- e.g. robustBufferAccess
+		// costs performance.
+		VkPhysicalDeviceFeatures2 features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+		};
+
+		/* Present wait. */
+		VkPhysicalDevicePresentIdFeaturesKHR present_id_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR,
+		};
+		VkPhysicalDevicePresentWaitFeaturesKHR present_wait_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR,
+		};
+		if (!headless && has_features2 &&
+				device_supports_extension(physical_device.device, VK_KHR_PRESENT_ID_EXTENSION_NAME) &&
+				device_supports_extension(physical_device.device, VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+			query_device_features(physical_device.device, &present_id_features);
+			query_device_features(physical_device.device, &present_wait_features);
+
+			if (present_id_features.presentId && present_wait_features.presentWait) {
+				capabilities.present_wait = true;
+				enable_device_features(&features, &present_id_features);
+				enable_device_features(&features, &present_wait_features);
+				enabled_extensions[n_enabled_extensions++] = VK_KHR_PRESENT_ID_EXTENSION_NAME;
+				enabled_extensions[n_enabled_extensions++] = VK_KHR_PRESENT_WAIT_EXTENSION_NAME;
+			}
+		}
+
+		/* Timeline semaphores. */
+		VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES,
+		};
+		if (options.sync_backend != SYNC_BACKEND_BINARY && instance_version >= VK_API_VERSION_1_2 &&
+				physical_device.properties.apiVersion >= VK_API_VERSION_1_2) {
+			query_device_features(physical_device.device, &timeline_semaphore_features);
+
+			if (timeline_semaphore_features.timelineSemaphore) {
+				capabilities.timeline_semaphore = true;
+				enable_device_features(&features, &timeline_semaphore_features);
+			}
+		}
+
+		/* Shader module identifiers. */
+		// NOTE Creating a pipeline from identifiers alone requires failing
+		// instead of compiling on a pipeline cache miss, which is part of
+		// VK_EXT_pipeline_creation_cache_control.
+		VkPhysicalDeviceShaderModuleIdentifierFeaturesEXT shader_module_identifier_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_MODULE_IDENTIFIER_FEATURES_EXT,
+		};
+		VkPhysicalDevicePipelineCreationCacheControlFeatures cache_control_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PIPELINE_CREATION_CACHE_CONTROL_FEATURES,
+		};
+		if (has_features2 &&
+				device_supports_extension(physical_device.device, VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME) &&
+				device_supports_extension(physical_device.device, VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME)) {
+			query_device_features(physical_device.device, &shader_module_identifier_features);
+			query_device_features(physical_device.device, &cache_control_features);
+
+			if (shader_module_identifier_features.shaderModuleIdentifier &&
+					cache_control_features.pipelineCreationCacheControl) {
+				capabilities.shader_module_identifier = true;
+				enable_device_features(&features, &shader_module_identifier_features);
+				enable_device_features(&features, &cache_control_features);
+				enabled_extensions[n_enabled_extensions++] = VK_EXT_SHADER_MODULE_IDENTIFIER_EXTENSION_NAME;
+				enabled_extensions[n_enabled_extensions++] = VK_EXT_PIPELINE_CREATION_CACHE_CONTROL_EXTENSION_NAME;
+			}
+		}
+
+		/* Indirect drawing. */
+		if (options.culling == CULLING_COMPUTE) {
+			VkPhysicalDeviceFeatures supported = {0};
+			vkGetPhysicalDeviceFeatures(physical_device.device, &supported);
+
+			if (supported.drawIndirectFirstInstance) {
+				capabilities.draw_indirect_first_instance = true;
+				features.features.drawIndirectFirstInstance = VK_TRUE;
+			}
+			if (supported.multiDrawIndirect) {
+				capabilities.multi_draw_indirect = true;
+				features.features.multiDrawIndirect = VK_TRUE;
+			}
+			if (device_supports_extension(physical_device.device, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME)) {
+				capabilities.draw_indirect_count = true;
+				enabled_extensions[n_enabled_extensions++] = VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME;
+			}
+		}
+
+		/* Dynamic rendering. */
+		// NOTE The extensions depend on VK_KHR_depth_stencil_resolve and
+		// VK_KHR_create_renderpass2, which are core in Vulkan 1.2, so older
+		// devices don't bother with them.
+		VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+		};
+		VkPhysicalDeviceSynchronization2Features synchronization2_features = {
+			.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES,
 		};
+		bool dynamic_rendering_core = instance_version >= VK_API_VERSION_1_3 &&
+			physical_device.properties.apiVersion >= VK_API_VERSION_1_3;
+		bool dynamic_rendering_extensions = instance_version >= VK_API_VERSION_1_2 &&
+			physical_device.properties.apiVersion >= VK_API_VERSION_1_2 &&
+			device_supports_extension(physical_device.device, VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME) &&
+			device_supports_extension(physical_device.device, VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+		if (options.rendering != RENDERING_BACKEND_RENDER_PASS &&
+				(dynamic_rendering_core || dynamic_rendering_extensions)) {
+			query_device_features(physical_device.device, &dynamic_rendering_features);
+			query_device_features(physical_device.device, &synchronization2_features);
+
+			if (dynamic_rendering_features.dynamicRendering && synchronization2_features.synchronization2) {
+				capabilities.dynamic_rendering = true;
+				capabilities.dynamic_rendering_core = dynamic_rendering_core;
+				enable_device_features(&features, &dynamic_rendering_features);
+				enable_device_features(&features, &synchronization2_features);
+				if (!dynamic_rendering_core) {
+					enabled_extensions[n_enabled_extensions++] = VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME;
+					enabled_extensions[n_enabled_extensions++] = VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME;
+				}
+			}
+		}
+
+		assert(n_enabled_extensions <= MAX_ENABLED_DEVICE_EXTENSIONS);
 
-		VkPhysicalDeviceFeatures features = {0};
 		VkDeviceCreateInfo device_info = {
 			.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-			.queueCreateInfoCount = 1,
-			.pQueueCreateInfos = &queue_info,
-			.pEnabledFeatures = &features,
-			.enabledExtensionCount = DEVICE_EXTENSIONS_LENGTH,
-			.ppEnabledExtensionNames = device_extensions,
+			.pNext = has_features2 ? &features : NULL,
+			.queueCreateInfoCount = n_queue_families,
+			.pQueueCreateInfos = queue_infos,
+			.pEnabledFeatures = has_features2 ? NULL : &features.features,
+			.enabledExtensionCount = n_enabled_extensions,
+			.ppEnabledExtensionNames = enabled_extensions,
 #ifdef ENABLE_VALIDATION_LAYERS
 			// Previous versions of Vulkan expected some validation layers to be
 			// specified per device. Define them here as well for compatibility.
@@ -347,251 +1766,202 @@ main(void)
 		vkGetDeviceQueue(device, physical_device.indices.graphics_family, 0, &graphics_queue);
 		vkGetDeviceQueue(device, physical_device.indices.presentation_family, 0, &present_queue);
 		assert(graphics_queue == present_queue);
+
+		// Without a dedicated family, uploads are submitted to the graphics
+		// queue instead.
+		transfer_queue = graphics_queue;
+		if (indices->transfer_family_exists) vkGetDeviceQueue(device, indices->transfer_family, 0, &transfer_queue);
+
+		printf("[INFO] queue families: graphics %u", indices->graphics_family);
+		if (indices->transfer_family_exists) printf(", transfer %u", indices->transfer_family);
+		if (indices->compute_family_exists) printf(", compute %u", indices->compute_family);
+		printf("\n");
 	}
 
+	// Culling on the GPU falls back to drawing every instance from the CPU if
+	// the indirect commands can't address their instances.
+	bool gpu_culling = options.culling == CULLING_COMPUTE;
+	if (gpu_culling && !capabilities.draw_indirect_first_instance) {
+		fprintf(stderr, "[WARNING] drawIndirectFirstInstance is unsupported, falling back to culling none\n");
+		gpu_culling = false;
+	}
+
+	// So does dynamic rendering to a render pass, which every device has.
+	Rendering_Backend rendering_backend = options.rendering;
+	if (rendering_backend == RENDERING_BACKEND_AUTO) {
+		rendering_backend = capabilities.dynamic_rendering ? RENDERING_BACKEND_DYNAMIC : RENDERING_BACKEND_RENDER_PASS;
+	} else if (rendering_backend == RENDERING_BACKEND_DYNAMIC && !capabilities.dynamic_rendering) {
+		fprintf(stderr, "[WARNING] dynamic rendering is unsupported, falling back to a render pass\n");
+		rendering_backend = RENDERING_BACKEND_RENDER_PASS;
+	}
+	Dynamic_Rendering dynamic_rendering = {0};
+	if (rendering_backend == RENDERING_BACKEND_DYNAMIC) {
+		dynamic_rendering_load(&dynamic_rendering, device, capabilities.dynamic_rendering_core);
+	}
+	printf("[INFO] rendering with the %s backend\n", rendering_backend_name(rendering_backend));
+	startup_end(&startup, STARTUP_DEVICE_CREATION);
+
 
 	/* ---
 	 * Create swapchain -- a queue of images to present.
 	 *
-	 * TODO Combine Swapchain_Support_Details and the three independent
-	 * variables defined below. In other words, use the struct instead of the
-	 * indepdents. Actually scrap that, I think all of these values are stored
-	 * in the swapchain struct anyway.
-	 *
-	 * Choose the most optimal settings for the swapchain. The swap extent
-	 * determines the resolution of images in the swapchain; the surface format
-	 * determines their color depth; and the presentation mode determines the
-	 * conditions for swapping images onto the screen. 
+	 * The swapchain, its image views and its framebuffers are rebuilt
+	 * whenever the surface changes, so they're managed together as a unit.
+	 * Headless rendering has no swapchain; it renders into offscreen images
+	 * of the window's size in a format that reads back as plain RGBA.
 	 * ---
 	 */
-	VkSwapchainKHR swapchain = {0};
-	VkImage *images = NULL;
-	uint32_t n_images = 0;
-	VkSurfaceFormatKHR surface_format = { .format = VK_FORMAT_UNDEFINED };
-	VkPresentModeKHR present_mode = VK_PRESENT_MODE_FIFO_KHR;
-	VkExtent2D extent = {0};
-	{
-		Swapchain_Support_Details details = {0};
-
-		// Query selected physical device for its supported surface capabilities.
-		// The remainder of this block ensures the device supports the ones
-		// required.
-		vkGetPhysicalDeviceSurfaceCapabilitiesKHR(physical_device.device, surface, &details.capabilities);
-
-		/* Determine proper resolution for swap chain images. */
-		{
-			VkSurfaceCapabilitiesKHR capabilities = details.capabilities;
-
-			if (capabilities.currentExtent.width != UINT32_MAX) {
-				extent = capabilities.currentExtent;
-			} else {
-				int width = 0;
-				int height = 0;
-
-				glfwGetFramebufferSize(window, &width, &height);
-
-				extent.width = CLAMP((unsigned)width, capabilities.minImageExtent.width,
-					capabilities.maxImageExtent.width);
-				extent.height = CLAMP((unsigned)height, capabilities.minImageExtent.height,
-					capabilities.maxImageExtent.height);
-			}
-		}
-
-		/* Confirm supported surface formats. */
-		{
-			Arena_Checkpoint checkpoint = arena_create_checkpoint(&global_arena);
-
-			// Get the number of supported surface formats.
-			vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device.device, surface, &details.n_formats, NULL);
-			if (details.n_formats == 0) {
-				fprintf(stderr, "[ERROR] the selected physical device does not support any common surface formats\n");
-				exit(EXIT_FAILURE);
-			}
-
-			// Allocate an array and store the supported surface formats in it.
-			details.formats = arena_alloc(&global_arena, details.n_formats * sizeof(VkSurfaceFormatKHR));
-			assert(details.formats);
-			vkGetPhysicalDeviceSurfaceFormatsKHR(physical_device.device,
-				surface, &details.n_formats, details.formats);
-
-			// Ideally, choose an SRGB color space because for more accurate color
-			// production. Otherwise, default to whichever color space is available.
-			for (size_t i = 0; i < details.n_formats; ++i) {
-				VkSurfaceFormatKHR this_format = details.formats[i];
-				if (this_format.format == VK_FORMAT_B8G8R8A8_SRGB &&
-						this_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
-					surface_format = this_format;
-					break;
-				}
-			}
-			if (surface_format.format == VK_FORMAT_UNDEFINED) surface_format = details.formats[0];
-
-			arena_restore(checkpoint);
-		}
-
-		/* Confirm supported present modes. */
-		{
-			Arena_Checkpoint checkpoint = arena_create_checkpoint(&global_arena);
-
-			// Get the number of supported present modes.
-			vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device.device, surface,
-				&details.n_presentation_modes, NULL);
-
-			// Allocate an array and store the supported present modes in it.
-			details.presentation_modes = arena_alloc(&global_arena,
-				details.n_presentation_modes * sizeof(VkPresentModeKHR));
-			assert(details.presentation_modes);
-			vkGetPhysicalDeviceSurfacePresentModesKHR(physical_device.device, surface,
-				&details.n_presentation_modes, details.presentation_modes);
-
-			// Ideally, choose VK_PRESENT_MAILBOX_KHR as the presentation mode for
-			// the swapchain. However, VK_PRESENT_MODE_FIFO_KHR is the only
-			// guaranteed mode, so it's set as the default. VK_PRESENT_MODE_FIFO_KHR
-			// blocks insertions to the swapchain when it's full; this may cause
-			// tearing. To avoid tearing, VK_PRESENT_MAILBOX_KHR replaces queued
-			// images with newer ones when the swapchain is full. Note,
-			// VK_PRESENT_MODE_MAILBOX_KHR also demands a more performant GPU.
-			for (size_t i = 0; i < details.n_presentation_modes; ++i) {
-				VkPresentModeKHR this_present_mode = details.presentation_modes[i];
-				if (this_present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
-					present_mode = this_present_mode;
-					break;
-				}
-			}
-
-			arena_restore(checkpoint);
-		}
-
-		// Specify the number of images in the swapchain. This value is bounded
-		// below by the capabilities of the physical device, but it's better for
-		// performance to allow at least one additional image in the swapchain.
-		n_images = details.capabilities.minImageCount + 1;
-		if (details.capabilities.maxImageCount > 0 && n_images > details.capabilities.maxImageCount) {
-			// NOTE A maximum image count of 0 in this case means the number of
-			// images in the swapchain is not explicitly bounded above by the
-			// device.
-			n_images = details.capabilities.maxImageCount;
-		}
-
-		VkSwapchainCreateInfoKHR swapchain_info = {
-			.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
-			.surface = surface,
-			.minImageCount = n_images,
-			.imageFormat = surface_format.format,
-			.imageColorSpace = surface_format.colorSpace,
-			.imageExtent = extent,
-			.imageArrayLayers = 1,
-			.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
-			.preTransform = details.capabilities.currentTransform,
-			.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-			.presentMode = present_mode,
-			.clipped = VK_TRUE,
-
-			// A window resize invalidates the current swapchain. In that case, a
-			// new one must be initialized and this stores a handle to the previous
-			// swapchain.
-			.oldSwapchain = VK_NULL_HANDLE,
-
-			// NOTE This assumes indices for graphics family and presentation
-			// family are the same.
-			.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
-		};
-
-		if (vkCreateSwapchainKHR(device, &swapchain_info, NULL, &swapchain) != VK_SUCCESS) {
-			fprintf(stderr, "[ERROR] failed to create swapchain\n");
-			exit(EXIT_FAILURE);
-		}
-
-		vkGetSwapchainImagesKHR(device, swapchain, &n_images, NULL);
-		images = arena_alloc(&global_arena, n_images * sizeof(VkImage));
-		assert(images);
-		vkGetSwapchainImagesKHR(device, swapchain, &n_images, images);
+	Swapchain swapchain = {0};
+	VkFormat color_format = OFFSCREEN_FORMAT;
+	if (!headless) {
+		startup_begin(&startup, STARTUP_SWAPCHAIN);
+		swapchain_init(&swapchain, physical_device.device, device, surface, options.present_mode);
+		if (capabilities.present_wait) swapchain_enable_present_wait(&swapchain);
+		swapchain_create(&swapchain, get_window_extent(window));
+		color_format = swapchain.surface_format.format;
+		startup_end(&startup, STARTUP_SWAPCHAIN);
 	}
 
 
 	/* ---
-	 * Create image views.
+	 * Choose the sample count and the depth format.
 	 *
-	 * Image views are handles to the images in the swapchain -- they're used
-	 * during render operations.
+	 * Multisampling renders into a transient image with several samples per
+	 * pixel, which the subpass resolves into the framebuffer's own image at
+	 * its end, so the samples are never written out to memory. The depth
+	 * image is transient as well, at the same sample count.
 	 * ---
 	 */
-	VkImageView *image_views = NULL;
-	{
-		image_views = arena_alloc(&global_arena, n_images * sizeof(VkImageView));
-		assert(image_views);
-
-		VkImageViewCreateInfo image_view_info = {
-			.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
-			.viewType = VK_IMAGE_VIEW_TYPE_2D,
-			.format = surface_format.format,
-			.components = {
-				.r = VK_COMPONENT_SWIZZLE_IDENTITY,
-				.g = VK_COMPONENT_SWIZZLE_IDENTITY,
-				.b = VK_COMPONENT_SWIZZLE_IDENTITY,
-				.a = VK_COMPONENT_SWIZZLE_IDENTITY,
-			},
-			.subresourceRange = {
-				.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
-				.baseMipLevel = 0,
-				.levelCount = 1,
-				.baseArrayLayer = 0,
-				.layerCount = 1,
-			},
-		};
-		for (size_t i = 0; i < n_images; ++i) {
-			image_view_info.image = images[i];
-			if (vkCreateImageView(device, &image_view_info, NULL, &image_views[i]) != VK_SUCCESS) {
-				fprintf(stderr, "[ERROR] failed to create image view\n");
-				exit(EXIT_FAILURE);
-			}
-		}
+	VkSampleCountFlagBits samples = choose_sample_count(&physical_device.properties.limits, options.samples);
+	bool multisampled = samples != VK_SAMPLE_COUNT_1_BIT;
+	if ((uint32_t)samples != options.samples) {
+		fprintf(stderr, "[WARNING] %u samples per pixel are unsupported, falling back to %u\n", options.samples,
+			(uint32_t)samples);
 	}
+	if (multisampled) printf("[INFO] rendering with %ux multisampling\n", (uint32_t)samples);
+
+	VkFormat depth_format = choose_depth_format(physical_device.device);
+	printf("[INFO] using depth format %s\n", depth_format_name(depth_format));
 
 
 	/* ---
 	 * Create render pass.
+	 *
+	 * Dynamic rendering has none. It records the same layout transitions and
+	 * dependencies as barriers of its own every frame instead; see
+	 * rendering.c.
 	 * ---
 	 */
 	VkRenderPass render_pass = {0};
-	{
-		VkAttachmentDescription color_attachment = {
-			.format = surface_format.format,
+	if (rendering_backend == RENDERING_BACKEND_RENDER_PASS) {
+		// The attachments in the order framebuffers list them: the
+		// framebuffer's own image, then the images Render_Attachments shares
+		// between all of them.
+		VkAttachmentDescription attachments[1 + RENDER_ATTACHMENTS_MAX] = {0};
+		uint32_t n_attachments = 0;
+
+		// With multisampling, the framebuffer's own image is only written by
+		// the resolve, which overwrites all of it, so it's never cleared.
+		attachments[n_attachments++] = (VkAttachmentDescription){
+			.format = color_format,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.loadOp = multisampled ? VK_ATTACHMENT_LOAD_OP_DONT_CARE : VK_ATTACHMENT_LOAD_OP_CLEAR,
 			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
 			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
 			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+			// Offscreen images are copied out for readback instead of presented.
+			.finalLayout = headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
 		};
+
+		// The multisampled image is dead once it's resolved.
 		VkAttachmentReference color_attachment_reference = {
 			.attachment = 0,
 			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
 		};
+		VkAttachmentReference resolve_attachment_reference = {
+			.attachment = 0,
+			.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		};
+		if (multisampled) {
+			color_attachment_reference.attachment = n_attachments;
+			attachments[n_attachments++] = (VkAttachmentDescription){
+				.format = color_format,
+				.samples = samples,
+				.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+				.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+				.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+				.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.finalLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+			};
+		}
+
+		// So is the depth image once the subpass ends.
+		VkAttachmentReference depth_attachment_reference = {
+			.attachment = n_attachments,
+			.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		};
+		attachments[n_attachments++] = (VkAttachmentDescription){
+			.format = depth_format,
+			.samples = samples,
+			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+			.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+			.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		};
+
 		VkSubpassDescription subpass = {
 			.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS,
 			.colorAttachmentCount = 1,
 			.pColorAttachments = &color_attachment_reference,
+			.pResolveAttachments = multisampled ? &resolve_attachment_reference : NULL,
+			.pDepthStencilAttachment = &depth_attachment_reference,
 		};
 
-		// Subpasses in a render pass handle image layout transitions.
-		VkSubpassDependency dependency = {
-			.srcSubpass = VK_SUBPASS_EXTERNAL,
-			.dstSubpass = 0,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = 0,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+		// Subpasses in a render pass handle image layout transitions. An
+		// offscreen image is last read by the previous frame's readback copy
+		// rather than by the presentation engine, and its color writes have to
+		// be visible to this frame's copy. The depth and multisampled images
+		// are shared by every frame, so the previous frame's writes to them
+		// must also finish before this frame's clears.
+		VkPipelineStageFlags src_stage = VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT |
+			(headless ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT);
+		VkAccessFlags src_access = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
+		if (multisampled) {
+			src_stage |= VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+			src_access |= VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		}
+		VkSubpassDependency dependencies[] = {
+			{
+				.srcSubpass = VK_SUBPASS_EXTERNAL,
+				.dstSubpass = 0,
+				.srcStageMask = src_stage,
+				.srcAccessMask = src_access,
+				.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT |
+					VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT,
+				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT |
+					VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			},
+			{
+				.srcSubpass = 0,
+				.dstSubpass = VK_SUBPASS_EXTERNAL,
+				.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+				.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+				.dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
+				.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+			},
 		};
 		VkRenderPassCreateInfo render_pass_info = {
 			.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
-			.attachmentCount = 1,
-			.pAttachments = &color_attachment,
+			.attachmentCount = n_attachments,
+			.pAttachments = attachments,
 			.subpassCount = 1,
 			.pSubpasses = &subpass,
-			.dependencyCount = 1,
-			.pDependencies = &dependency,
+			.dependencyCount = headless ? 2 : 1,
+			.pDependencies = dependencies,
 		};
 
 		if (vkCreateRenderPass(device, &render_pass_info, NULL, &render_pass) != VK_SUCCESS) {
@@ -602,396 +1972,644 @@ main(void)
 
 
 	/* ---
-	 * Create graphics pipeline and shader stage.
+	 * Load the pipeline cache.
+	 *
+	 * Compiling a pipeline from SPIR-V is the most expensive part of startup.
+	 * The driver serializes compiled pipelines into this cache, and the cache
+	 * persists on disk across runs, so only the first launch pays that cost.
+	 * Its file was read in the background along with the shaders, which are
+	 * next to be needed.
+	 * ---
+	 */
+	if (reading_startup_files) {
+		pthread_join(startup_files_thread, NULL);
+	} else {
+		read_startup_files(&startup_files);
+	}
+	Pipeline_Cache pipeline_cache = pipeline_cache_create(device, &physical_device.properties,
+		&startup_files.pipeline_cache, PIPELINE_CACHE_FILENAME);
+
+
+	/* ---
+	 * Create graphics pipelines and shader stages.
+	 *
+	 * Every pipeline the renderer may bind is compiled up front on a pool of
+	 * worker threads, all into the same pipeline cache. Only the pipeline the
+	 * first frame draws with is waited on; the rest finish in the background.
 	 * ---
 	 */
+	VkDescriptorSetLayout set_layout = {0};
 	VkPipelineLayout layout = {0};
-	VkPipeline graphics_pipeline = {0};
-	VkShaderModule vert_shader_module = {0};
-	VkShaderModule frag_shader_module = {0};
+	Shader_Cache shader_cache = {0};
+	Shader *cull_shader = NULL;
+	Thread_Pool pipeline_pool = {0};
+	Pipeline_Builder pipeline_builder = {0};
+	Pipeline_Variants pipeline_variants = {0};
+	Pipeline_Key opaque_key = 0;
+	startup_begin(&startup, STARTUP_PIPELINE_CREATION);
 	{
-		Buffer vert_shader_source = read_file("shaders/vert.spv");
-		Buffer frag_shader_source = read_file("shaders/frag.spv");
-
-		vert_shader_module = create_shader_module(device, vert_shader_source);
-		frag_shader_module = create_shader_module(device, frag_shader_source);
-
-		// The vertex shader processes each vertex.
-		VkPipelineShaderStageCreateInfo vert_shader_stage_info = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_VERTEX_BIT,
-			.module = vert_shader_module,
-			.pName = "main",
-		};
-		// The fragment shader provides depth and color to the images.
-		VkPipelineShaderStageCreateInfo frag_shader_stage_info = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-			.stage = VK_SHADER_STAGE_FRAGMENT_BIT,
-			.module = frag_shader_module,
-			.pName = "main",
+		shader_cache_init(&shader_cache, device, capabilities.shader_module_identifier);
+
+		// The vertex shader processes each vertex, and the fragment shader
+		// provides depth and color to the images.
+		Shader *vert_shader = shader_cache_add(&shader_cache, &startup_files.vert_shader, "shaders/vert.spv");
+		Shader *frag_shader = shader_cache_add(&shader_cache, &startup_files.frag_shader, "shaders/frag.spv");
+
+		// NOTE The culling shader is added up front since the shader cache may
+		// not be modified while the pipeline workers use it. It was read ahead
+		// of knowing whether the device can cull on the GPU.
+		if (gpu_culling && !startup_files.has_cull_shader) {
+			fprintf(stderr, "[WARNING] failed to read shaders/cull.spv, falling back to culling none\n");
+			gpu_culling = false;
+		}
+		if (gpu_culling) {
+			cull_shader = shader_cache_add(&shader_cache, &startup_files.cull_shader, "shaders/cull.spv");
+		} else if (startup_files.has_cull_shader) {
+			shader_code_free(&startup_files.cull_shader);
+		}
+
+		// Describe the layout of the vertex buffers: interleaved vertices with
+		// a position and a color each, and interleaved instances that advance
+		// once per instance instead of once per vertex.
+		VkVertexInputBindingDescription vertex_bindings[] = {
+			{
+				.binding = 0,
+				.stride = sizeof(Vertex),
+				.inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
+			},
+			{
+				.binding = 1,
+				.stride = sizeof(Instance),
+				.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE,
+			},
 		};
-		VkPipelineShaderStageCreateInfo shader_stages[] = {
-			vert_shader_stage_info,
-			frag_shader_stage_info,
+		VkVertexInputAttributeDescription vertex_attributes[] = {
+			{
+				.location = 0,
+				.binding = 0,
+				.format = VK_FORMAT_R32G32_SFLOAT,
+				.offset = offsetof(Vertex, position),
+			},
+			{
+				.location = 1,
+				.binding = 0,
+				.format = VK_FORMAT_R32G32B32_SFLOAT,
+				.offset = offsetof(Vertex, color),
+			},
+			{
+				.location = 2,
+				.binding = 1,
+				.format = VK_FORMAT_R32G32_SFLOAT,
+				.offset = offsetof(Instance, offset),
+			},
+			{
+				.location = 3,
+				.binding = 1,
+				.format = VK_FORMAT_R32_SFLOAT,
+				.offset = offsetof(Instance, scale),
+			},
+			{
+				.location = 4,
+				.binding = 1,
+				.format = VK_FORMAT_R32G32B32_SFLOAT,
+				.offset = offsetof(Instance, color),
+			},
 		};
-
-		// Indicate no vertex data exists to be input to the vertex shader since
-		// the vertex data is hard coded in the shader directly.
 		VkPipelineVertexInputStateCreateInfo vertex_input_info = {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-			.vertexBindingDescriptionCount = 0,
-			.pVertexBindingDescriptions = NULL,
-			.vertexAttributeDescriptionCount = 0,
-			.pVertexAttributeDescriptions = NULL,
-		};
-
-		// Indicate a triangle should be formed out of the vertices.
-		VkPipelineInputAssemblyStateCreateInfo input_assembly = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-			.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
-			.primitiveRestartEnable = VK_FALSE,
-		};
-
-		// Specify viewport and scissor filter dynamically as opposed to statically
-		// in the pipeline. 
-		VkDynamicState dynamic_states[] = {
-			VK_DYNAMIC_STATE_VIEWPORT,
-			VK_DYNAMIC_STATE_SCISSOR,
-		};
-		VkPipelineDynamicStateCreateInfo dynamic_state = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-			.dynamicStateCount = 2,
-			.pDynamicStates = dynamic_states,
-		};
-
-		// A viewport describes the region of the framebuffer to which to output
-		// the render.
-		VkViewport viewport = {
-			.x = 0.0f,
-			.y = 0.0f,
-			.width = extent.width,
-			.height = extent.height,
-			.minDepth = 0.0f,
-			.maxDepth = 1.0f,
-		};
-
-		// Pixels outside the bounds specified by the scissor rectangle are
-		// discarded by the rasterizer.
-		VkRect2D scissor = {
-			.offset = {0, 0},
-			.extent = extent,
-		};
-		VkPipelineViewportStateCreateInfo viewport_state_info = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-			.viewportCount = 1,
-			.pViewports = &viewport,
-			.scissorCount = 1,
-			.pScissors = &scissor,
+			.vertexBindingDescriptionCount = sizeof(vertex_bindings) / sizeof(VkVertexInputBindingDescription),
+			.pVertexBindingDescriptions = vertex_bindings,
+			.vertexAttributeDescriptionCount = sizeof(vertex_attributes) / sizeof(VkVertexInputAttributeDescription),
+			.pVertexAttributeDescriptions = vertex_attributes,
 		};
 
-		// Given vertices from the vertex shader, the rasterizer yields fragments
-		// for the fragment shader to transform.
-		VkPipelineRasterizationStateCreateInfo rasterizer = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-			.depthClampEnable = VK_FALSE,
-			.rasterizerDiscardEnable = VK_FALSE,
-			.polygonMode = VK_POLYGON_MODE_FILL,
-			.lineWidth = 1.0f,
-			.cullMode = VK_CULL_MODE_BACK_BIT,
-			.frontFace = VK_FRONT_FACE_CLOCKWISE,
-			.depthBiasEnable = VK_FALSE,
+		// The per-draw uniforms are a dynamic uniform buffer, so draws switch
+		// between them with a dynamic offset rather than another set.
+		VkDescriptorSetLayoutBinding uniform_binding = {
+			.binding = 0,
+			.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
 		};
-
-		// Disable multisampling, a form of antialiasing.
-		VkPipelineMultisampleStateCreateInfo multisampling = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-			.sampleShadingEnable = VK_FALSE,
-			.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT,
+		VkDescriptorSetLayoutCreateInfo set_layout_info = {
+			.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+			.bindingCount = 1,
+			.pBindings = &uniform_binding,
 		};
+		if (vkCreateDescriptorSetLayout(device, &set_layout_info, NULL, &set_layout) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create descriptor set layout\n");
+			exit(EXIT_FAILURE);
+		}
 
-		VkPipelineColorBlendAttachmentState color_blend_attachment = {
-			.colorWriteMask =
-				VK_COLOR_COMPONENT_R_BIT |
-				VK_COLOR_COMPONENT_G_BIT |
-				VK_COLOR_COMPONENT_B_BIT |
-				VK_COLOR_COMPONENT_A_BIT,
-			.blendEnable = VK_TRUE,
-			.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-			.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-			.colorBlendOp = VK_BLEND_OP_ADD,
-			.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-			.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-			.alphaBlendOp = VK_BLEND_OP_ADD,
-		};
-		VkPipelineColorBlendStateCreateInfo color_blending = {
-			.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-			.logicOpEnable = VK_FALSE,
-			.attachmentCount = 1,
-			.pAttachments = &color_blend_attachment,
+		// NOTE Every implementation supports at least 128 bytes of push
+		// constants, which is plenty for these.
+		VkPushConstantRange push_constant_range = {
+			.stageFlags = VK_SHADER_STAGE_VERTEX_BIT,
+			.offset = 0,
+			.size = sizeof(Draw_Constants),
 		};
+		assert(sizeof(Draw_Constants) <= 128);
 
 		VkPipelineLayoutCreateInfo layout_info = {
 			.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+			.setLayoutCount = 1,
+			.pSetLayouts = &set_layout,
+			.pushConstantRangeCount = 1,
+			.pPushConstantRanges = &push_constant_range,
 		};
 		if (vkCreatePipelineLayout(device, &layout_info, NULL, &layout) != VK_SUCCESS) {
 			fprintf(stderr, "[ERROR] failed to create pipeline layout\n");
 			exit(EXIT_FAILURE);
 		}
 
-		VkGraphicsPipelineCreateInfo pipeline_info = {
-			.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-			.stageCount = 2,
-			.pStages = shader_stages,
-			.pVertexInputState = &vertex_input_info,
-			.pInputAssemblyState = &input_assembly,
-			.pViewportState = &viewport_state_info,
-			.pRasterizationState = &rasterizer,
-			.pMultisampleState = &multisampling,
-			.pColorBlendState = &color_blending,
-			.pDynamicState = &dynamic_state,
-			.layout = layout,
-			.renderPass = render_pass,
-			.subpass = 0,
+		uint32_t n_threads = options.pipeline_threads ? options.pipeline_threads : thread_pool_default_threads();
+		thread_pool_init(&pipeline_pool, n_threads);
+		pipeline_builder_init(&pipeline_builder, device, pipeline_cache.handle, pipeline_cache.warm, layout,
+			render_pass, &vertex_input_info, &shader_cache, &pipeline_pool);
+		if (rendering_backend == RENDERING_BACKEND_DYNAMIC) {
+			pipeline_builder_use_dynamic_rendering(&pipeline_builder, color_format, depth_format);
+		}
+
+		// The variants of the triangle pipeline, built from their keys. The
+		// opaque one is what the renderer draws with, so it's queued ahead of
+		// the others. The triangle is opaque, so it's drawn without blending
+		// and writes depth, which is what lets front-to-back sorting reject
+		// the draws it hides.
+		pipeline_variants_init(&pipeline_variants, &pipeline_builder, vert_shader, frag_shader);
+		opaque_key = pipeline_key(BLEND_OPAQUE, VK_CULL_MODE_BACK_BIT, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, samples);
+		Pipeline_Key keys[] = {
+			opaque_key,
+			pipeline_key(BLEND_ALPHA, VK_CULL_MODE_BACK_BIT, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, samples),
+			pipeline_key(BLEND_OPAQUE, VK_CULL_MODE_NONE, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, samples),
+			pipeline_key(BLEND_ALPHA, VK_CULL_MODE_NONE, VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST, samples),
 		};
+		size_t n_keys = sizeof(keys) / sizeof(Pipeline_Key);
 
-		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipeline_info, NULL,
-					&graphics_pipeline) != VK_SUCCESS) {
-			fprintf(stderr, "[ERROR] failed to create graphics pipeline\n");
-			exit(EXIT_FAILURE);
+		uint64_t start = timer_now();
+		for (size_t i = 0; i < n_keys; ++i) {
+			pipeline_variants_request(&pipeline_variants, keys[i]);
 		}
+		pipeline_variants_get(&pipeline_variants, opaque_key);
+		printf("[INFO] waited %.3f ms for the first of %zu graphics pipelines on %u threads (%s pipeline cache)\n",
+			timer_elapsed_ms(start, timer_now()), n_keys, pipeline_pool.n_threads,
+			pipeline_cache.warm ? "warm" : "cold");
+	}
+	startup_end(&startup, STARTUP_PIPELINE_CREATION);
 
-		vkDestroyShaderModule(device, frag_shader_module, NULL);
-		vkDestroyShaderModule(device, vert_shader_module, NULL);
+
+	/* ---
+	 * Watch the shaders for edits.
+	 *
+	 * Edited GLSL is recompiled on the watcher's thread, and the renderer
+	 * rebuilds the pipelines that use it through the pipeline cache while it
+	 * keeps drawing with the old ones. The culling shader isn't watched: its
+	 * pipeline belongs to the culler, which builds it once.
+	 * ---
+	 */
+	Shader_Watcher shader_watcher = {0};
+	bool watching_shaders = false;
+	if (options.hot_reload) {
+		shader_watcher_init(&shader_watcher, "shaders", SHADER_COMPILER);
+		shader_watcher_add(&shader_watcher, "shaders/shader.vert", "shaders/vert.spv", VK_SHADER_STAGE_VERTEX_BIT);
+		shader_watcher_add(&shader_watcher, "shaders/shader.frag", "shaders/frag.spv", VK_SHADER_STAGE_FRAGMENT_BIT);
+		watching_shaders = shader_watcher_start(&shader_watcher);
 	}
 
 
 	/* ---
-	 * Create framebuffers.
+	 * Determine the number of frames in flight.
+	 *
+	 * A value greater than 1 allows frames to be processed concurrently.
+	 * Offscreen images belong to frames, so headless rendering isn't limited.
 	 * ---
 	 */
-	VkFramebuffer *framebuffers = NULL;
-	{
-		framebuffers = arena_alloc(&global_arena, n_images * sizeof(VkFramebuffer));
-		assert(framebuffers);
-		for (size_t i = 0; i < n_images; ++i) {
-			VkImageView attachments[] = { image_views[i] };
-
-			VkFramebufferCreateInfo framebuffer_info = {
-				.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
-				.renderPass = render_pass,
-				.attachmentCount = 1,
-				.pAttachments = attachments,
-				.width = extent.width,
-				.height = extent.height,
-				.layers = 1,
-			};
+	uint32_t n_frames_in_flight = headless ? options.frames_in_flight :
+		CLAMP(options.frames_in_flight, 1, swapchain.n_images);
+	if (n_frames_in_flight != options.frames_in_flight) {
+		fprintf(stderr, "[WARNING] limiting frames in flight to the %u swapchain images\n", swapchain.n_images);
+	}
 
-			if (vkCreateFramebuffer(device, &framebuffer_info, NULL, &framebuffers[i]) != VK_SUCCESS) {
-				fprintf(stderr, "[ERROR] failed to create framebuffer\n");
+
+	/* ---
+	 * Create the vertex and index buffers.
+	 *
+	 * Static geometry lives in device-local memory, which the CPU usually
+	 * can't write to, so it's staged in host-visible memory and copied over on
+	 * the transfer queue. Streaming geometry is rewritten every frame, so every
+	 * frame in flight gets its own buffers in host-visible memory that stay
+	 * mapped throughout.
+	 * ---
+	 */
+	Gpu_Allocator gpu_allocator = {0};
+	Gpu_Arena streaming_arena = {0};
+	Uploader uploader = {0};
+	uint32_t n_geometry_buffers = options.geometry == GEOMETRY_STREAMING ? n_frames_in_flight : 1;
+	Gpu_Buffer *vertex_buffers = NULL;
+	Gpu_Buffer *index_buffers = NULL;
+	{
+		const Queue_Family_Indices *indices = &physical_device.indices;
+		uint32_t transfer_family = indices->transfer_family_exists ? indices->transfer_family : indices->graphics_family;
+
+		gpu_allocator_init(&gpu_allocator, physical_device.device, device);
+		uploader_create(&uploader, &gpu_allocator, transfer_family, transfer_queue, STAGING_BUFFER_SIZE);
+
+		vertex_buffers = arena_alloc(&global_arena, n_geometry_buffers * sizeof(Gpu_Buffer));
+		index_buffers = arena_alloc(&global_arena, n_geometry_buffers * sizeof(Gpu_Buffer));
+		assert(vertex_buffers && index_buffers);
+
+		if (options.geometry == GEOMETRY_STATIC) {
+			// The buffers are written on the transfer queue and read on the
+			// graphics queue.
+			uint32_t queue_families[] = { indices->graphics_family, transfer_family };
+			uint32_t n_queue_families = transfer_family != indices->graphics_family ? 2 : 1;
+
+			uint64_t start = timer_now();
+			vertex_buffers[0] = gpu_buffer_create(&gpu_allocator, sizeof(triangle_vertices),
+				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, n_queue_families, queue_families);
+			index_buffers[0] = gpu_buffer_create(&gpu_allocator, sizeof(triangle_indices),
+				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, n_queue_families, queue_families);
+
+			uploader_upload_buffer(&uploader, vertex_buffers[0].handle, 0, triangle_vertices,
+				sizeof(triangle_vertices));
+			uploader_upload_buffer(&uploader, index_buffers[0].handle, 0, triangle_indices,
+				sizeof(triangle_indices));
+
+			// NOTE Waiting on the host for the copies to complete is enough
+			// synchronization for the graphics queue, which doesn't read the
+			// buffers until the first frame is submitted afterwards.
+			uploader_wait_idle(&uploader);
+			printf("[INFO] uploaded %" PRIu64 " bytes of geometry in %.3f ms\n",
+				(uint64_t)uploader.bytes_uploaded, timer_elapsed_ms(start, timer_now()));
+		} else {
+			// Prefer memory that's both device-local and host-visible, e.g. with
+			// resizable BAR, so the GPU doesn't read over the bus.
+			// NOTE Vertex and index buffers may live in any host-visible memory
+			// type on every implementation in practice, so the arena isn't
+			// restricted further up front; gpu_arena_alloc() would fail loudly
+			// otherwise.
+			if (!gpu_arena_init(&streaming_arena, &gpu_allocator, STREAMING_ARENA_SIZE, UINT32_MAX,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT)) {
+				fprintf(stderr, "[ERROR] failed to reserve memory for streaming geometry\n");
 				exit(EXIT_FAILURE);
 			}
+
+			for (size_t i = 0; i < n_geometry_buffers; ++i) {
+				vertex_buffers[i] = gpu_buffer_create_in_arena(&streaming_arena, sizeof(triangle_vertices),
+					VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, 0, NULL);
+				index_buffers[i] = gpu_buffer_create_in_arena(&streaming_arena, sizeof(triangle_indices),
+					VK_BUFFER_USAGE_INDEX_BUFFER_BIT, 0, NULL);
+			}
+		}
+
+		gpu_allocator_print_stats(&gpu_allocator);
+	}
+
+
+	/* ---
+	 * Create the offscreen render targets.
+	 *
+	 * Headless frames render into an image per frame in flight, and copy it
+	 * into a host-visible readback buffer per frame in flight. With two or
+	 * more frames in flight, the CPU reads frame N back while the GPU renders
+	 * frame N + 1 into the other image.
+	 * ---
+	 */
+	Offscreen_Target offscreen = {0};
+	if (headless) {
+		VkExtent2D extent = { .width = WINDOW_WIDTH, .height = WINDOW_HEIGHT };
+		offscreen_create(&offscreen, &gpu_allocator, extent, n_frames_in_flight, &global_arena);
+		if (n_frames_in_flight < 2) {
+			fprintf(stderr, "[WARNING] with a single frame in flight, readback can't overlap rendering\n");
 		}
 	}
 
 
 	/* ---
-	 * Initialize command pool.
+	 * Create framebuffers.
+	 *
+	 * Every framebuffer shares a single multisampled image, if any, and a
+	 * single depth image, since only one frame renders at a time. The
+	 * swapchain's framebuffers and the shared images are rebuilt together
+	 * whenever the surface changes. Dynamic rendering only needs the shared
+	 * images.
+	 * ---
+	 */
+	Render_Attachments render_attachments = {0};
+	render_attachments_init(&render_attachments, &gpu_allocator, color_format, depth_format, samples);
+	render_attachments_create(&render_attachments, headless ? offscreen.extent : swapchain.extent);
+	if (rendering_backend == RENDERING_BACKEND_RENDER_PASS && headless) {
+		offscreen_create_framebuffers(&offscreen, render_pass, render_attachments.n_views, render_attachments.views);
+	} else if (rendering_backend == RENDERING_BACKEND_RENDER_PASS) {
+		swapchain_create_framebuffers(&swapchain, render_pass, render_attachments.n_views, render_attachments.views);
+	}
+
+
+	/* ---
+	 * Create the instance ring.
 	 *
-	 * A command pool manages the memory that its command buffers allocate.
+	 * Instances are rewritten every frame, so the ring holds a region per
+	 * frame in flight in host-visible memory that stays mapped throughout.
+	 * A frame writes its region once the frame's previous submission, the
+	 * last one to read it, is complete.
 	 * ---
 	 */
-	VkCommandPool command_pool = {0};
+	Gpu_Buffer instance_ring = {0};
+	VkDeviceSize instance_region_size = (VkDeviceSize)options.instances * sizeof(Instance);
 	{
-		VkCommandPoolCreateInfo pool_info = {
-			.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-			.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
-			.queueFamilyIndex = physical_device.indices.graphics_family,
-		};
+		// The culling shader reads the regions as storage buffers, whose
+		// offsets have to be aligned.
+		VkBufferUsageFlags usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		if (gpu_culling) {
+			VkDeviceSize alignment = physical_device.properties.limits.minStorageBufferOffsetAlignment;
+			instance_region_size = (instance_region_size + alignment - 1) / alignment * alignment;
+			usage |= VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		}
 
-		if (vkCreateCommandPool(device, &pool_info, NULL, &command_pool) != VK_SUCCESS) {
-			fprintf(stderr, "[ERROR] failed to create command pool\n");
-			exit(EXIT_FAILURE);
+		instance_ring = gpu_buffer_create(&gpu_allocator, n_frames_in_flight * instance_region_size, usage,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0, NULL);
+		assert(instance_ring.allocation.mapped);
+		printf("[INFO] drawing %u instances per draw from a %" PRIu64 " byte instance ring\n", options.instances,
+			(uint64_t)instance_ring.size);
+	}
+
+
+	/* ---
+	 * Create the compute culling pipeline and the indirect draw buffers.
+	 *
+	 * Every frame, a compute shader culls the frame's instances against the
+	 * viewport and writes the indirect commands that the frame's draws read.
+	 * ---
+	 */
+	Culler culler = {0};
+	if (gpu_culling) {
+		// Each path reads every instance's command with as few draws as the
+		// device allows, so long as one indirect draw may read that many.
+		uint32_t max_draw_count = physical_device.properties.limits.maxDrawIndirectCount;
+		bool multi_draw = capabilities.multi_draw_indirect && options.instances <= max_draw_count;
+
+		PFN_vkCmdDrawIndexedIndirectCountKHR draw_indexed_indirect_count = NULL;
+		if (capabilities.draw_indirect_count && multi_draw) {
+			draw_indexed_indirect_count = (PFN_vkCmdDrawIndexedIndirectCountKHR)
+				vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR");
 		}
+
+		culler_create(&culler, device, &gpu_allocator, &shader_cache, cull_shader, pipeline_cache.handle,
+			n_frames_in_flight, options.instances, TRIANGLE_INDICES_LENGTH, instance_ring.handle,
+			instance_region_size, draw_indexed_indirect_count, multi_draw, &global_arena);
+		printf("[INFO] culling instances on the GPU, and drawing them with %s\n",
+			draw_indexed_indirect_count ? "vkCmdDrawIndexedIndirectCount()" :
+			multi_draw ? "a multi-draw vkCmdDrawIndexedIndirect()" : "a vkCmdDrawIndexedIndirect() per instance");
 	}
 
 
 	/* ---
-	 * Allocate a command buffer for every frame in flight.
+	 * Create the uniform ring and the descriptor pools.
 	 *
-	 * A command buffer records commands such as drawing operations and memory
-	 * transfers and then submits this series of commands together for
-	 * processing.
+	 * Like the instance ring, the uniform ring holds a region per frame in
+	 * flight that stays mapped throughout, with a slot for every draw. Each
+	 * frame allocates its descriptor sets from a pool of its own, which is
+	 * reset in one go when the frame comes around again.
 	 * ---
 	 */
-	VkCommandBuffer command_buffer[MAX_FRAMES_IN_FLIGHT] = {0};
+	Uniform_Ring uniform_ring = {0};
+	Descriptor_Allocator descriptor_allocator = {0};
 	{
-		VkCommandBufferAllocateInfo command_buffer_info = {
-			.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
-			.commandPool = command_pool,
-			.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-			.commandBufferCount = 2,
+		VkDeviceSize alignment = MAX(physical_device.properties.limits.minUniformBufferOffsetAlignment, 1);
+		VkDeviceSize stride = (sizeof(Draw_Uniforms) + alignment - 1) / alignment * alignment;
+		uniform_ring_create(&uniform_ring, &gpu_allocator, &physical_device.properties.limits,
+			options.draws * stride, n_frames_in_flight);
+
+		VkDescriptorPoolSize pool_size = {
+			.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC,
+			.descriptorCount = DESCRIPTOR_SETS_PER_FRAME,
 		};
+		descriptor_allocator_create(&descriptor_allocator, device, n_frames_in_flight, DESCRIPTOR_SETS_PER_FRAME,
+			1, &pool_size, &global_arena);
+		printf("[INFO] drawing with uniforms from a %" PRIu64 " byte uniform ring\n",
+			(uint64_t)uniform_ring.buffer.size);
+	}
+
+	// The draw list is rebuilt in the frame arena every frame, so the arena
+	// is sized to fit it, with room for aligning it.
+	size_t draw_list_length = options.draws * sizeof(Draw_Item) + _Alignof(max_align_t);
+	if (draw_list_length > FRAME_ARENA_LENGTH) {
+		void *frame_arena_buffer_grown = arena_alloc_uninitialized(&global_arena, draw_list_length);
+		assert(frame_arena_buffer_grown);
+		arena_init(&frame_arena, frame_arena_buffer_grown, draw_list_length);
+	}
+	if (options.sort == SORT_FRONT_TO_BACK) printf("[INFO] sorting opaque draws front to back\n");
 
-		if (vkAllocateCommandBuffers(device, &command_buffer_info, command_buffer) != VK_SUCCESS) {
-			fprintf(stderr, "[ERROR] failed to allocate command buffer\n");
-			exit(EXIT_FAILURE);
-		}
-	};
 
-	
 	/* ---
-	 * Initialize semaphores and fences.
+	 * Create a frame context for every frame in flight.
+	 *
+	 * A command buffer records commands such as drawing operations and memory
+	 * transfers and then submits this series of commands together for
+	 * processing. Each frame allocates its command buffers from its own
+	 * command pool, which manages the memory that they allocate and is reset
+	 * in one go once the frame's previous submission is complete.
 	 * ---
 	 */
-	VkSemaphore image_available_semaphore[MAX_FRAMES_IN_FLIGHT] = {0};
-	VkSemaphore render_finished_semaphore[MAX_FRAMES_IN_FLIGHT] = {0};
-	VkFence in_flight_fence[MAX_FRAMES_IN_FLIGHT] = {0};
+	Frame_Context *frame_contexts = NULL;
 	{
-		VkSemaphoreCreateInfo semaphore_info = {
-			.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO,
-		};
-		// Initialize the fence in a signaled state so the CPU doesn't block on the
-		// first frame.
-		VkFenceCreateInfo fence_info = {
-			.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
-			.flags = VK_FENCE_CREATE_SIGNALED_BIT,
-		};
+		frame_contexts = arena_alloc(&global_arena, n_frames_in_flight * sizeof(Frame_Context));
+		assert(frame_contexts);
 
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			if (vkCreateSemaphore(device, &semaphore_info, NULL, &image_available_semaphore[i]) != VK_SUCCESS) {
-				fprintf(stderr, "[ERROR] failed to create semaphore\n");
-				exit(EXIT_FAILURE);
-			}
-			if (vkCreateSemaphore(device, &semaphore_info, NULL, &render_finished_semaphore[i]) != VK_SUCCESS) {
-				fprintf(stderr, "[ERROR] failed to create semaphore\n");
-				exit(EXIT_FAILURE);
-			}
-			if (vkCreateFence(device, &fence_info, NULL, &in_flight_fence[i]) != VK_SUCCESS) {
-				fprintf(stderr, "[ERROR] failed to create fence\n");
-				exit(EXIT_FAILURE);
-			}
+		for (uint32_t i = 0; i < n_frames_in_flight; ++i) {
+			frame_context_create(&frame_contexts[i], device, physical_device.indices.graphics_family,
+				VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 		}
 	}
 
 
 	/* ---
-	 * Loop. Start event loop and rendering to screen.
+	 * Set up the profiler.
+	 *
+	 * GPU passes are timed with timestamp queries and CPU work with the host
+	 * clock, so the two timelines can be compared side by side.
+	 * ---
+	 */
+	Profiler profiler = {0};
+	profiler_create(&profiler, device, &physical_device.properties.limits,
+		physical_device.indices.graphics_timestamp_valid_bits, n_frames_in_flight, &global_arena);
+
+
+	/* ---
+	 * Set up frame time statistics.
+	 *
+	 * In benchmark mode, the loop exits after the warmup and measured frames.
 	 * ---
 	 */
-	uint32_t current_frame = 0;
-	while (!glfwWindowShouldClose(window)) {
-		glfwPollEvents();
+	bool benchmark = options.bench_frames > 0;
+	Frame_Stats frame_stats = {0};
+	frame_stats_init(&frame_stats, benchmark ? options.bench_frames : FRAME_STATS_CAPACITY, &global_arena);
+	if (benchmark) {
+		printf("[INFO] benchmarking %u frames after %u warmup frames\n", options.bench_frames,
+			options.warmup_frames);
+	}
 
-		{
-			// Wait an unbounded amonut of time for the previous frame to finish.
-			vkWaitForFences(device, 1, &in_flight_fence[current_frame], VK_TRUE, UINT64_MAX);
-			vkResetFences(device, 1, &in_flight_fence[current_frame]);
 
-			// Get an index to an image from the swapchain.
-			uint32_t image_index = 0;
-			vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, image_available_semaphore[current_frame],
-				VK_NULL_HANDLE, &image_index);
+	/* ---
+	 * Set up multi-threaded recording.
+	 *
+	 * The draw list is split into slices that worker threads record into
+	 * secondary command buffers, which the primary command buffer executes.
+	 * Without recording threads, the primary records every draw inline.
+	 * ---
+	 */
+	Thread_Pool recording_pool = {0};
+	Recorder recorder = {0};
+	if (options.record_threads > 0) {
+		thread_pool_init(&recording_pool, options.record_threads);
+		recorder_create(&recorder, device, physical_device.indices.graphics_family, &recording_pool,
+			n_frames_in_flight, &global_arena);
+		printf("[INFO] recording %u draws per frame on %u threads\n", options.draws, recorder.n_slices);
+	}
 
 
-			/* Add draw commands into the buffer for the current frame. */
-			{
-				vkResetCommandBuffer(command_buffer[current_frame], 0);
+	/* ---
+	 * Initialize semaphores and fences.
+	 * ---
+	 */
+	startup_begin(&startup, STARTUP_SYNC_OBJECTS);
+	Frame_Sync sync = {0};
+	{
+		Sync_Backend backend = options.sync_backend;
+		if (backend == SYNC_BACKEND_AUTO) {
+			backend = capabilities.timeline_semaphore ? SYNC_BACKEND_TIMELINE : SYNC_BACKEND_BINARY;
+		} else if (backend == SYNC_BACKEND_TIMELINE && !capabilities.timeline_semaphore) {
+			fprintf(stderr, "[WARNING] timeline semaphores are unsupported, falling back to binary synchronization\n");
+			backend = SYNC_BACKEND_BINARY;
+		}
 
-				VkCommandBufferBeginInfo begin_info = {
-					.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
-					.flags = 0,
-					.pInheritanceInfo = NULL,
-				};
-				if (vkBeginCommandBuffer(command_buffer[current_frame], &begin_info) != VK_SUCCESS) {
-					fprintf(stderr, "[ERROR] failed to begin recording command buffer\n");
-					exit(EXIT_FAILURE);
-				}
+		frame_sync_create(&sync, device, backend, n_frames_in_flight, &global_arena);
+		printf("[INFO] using %s frame synchronization\n", sync_backend_name(backend));
+	}
+	startup_end(&startup, STARTUP_SYNC_OBJECTS);
 
-				VkClearValue clear_color = {{{0.0f, 0.0f, 0.0f, 1.0f}}};
-				VkRenderPassBeginInfo render_pass_info = {
-					.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-					.renderPass = render_pass,
-					.framebuffer = framebuffers[image_index],
-					.renderArea = {
-						.offset = {0, 0},
-						.extent = extent,
-					},
-					.clearValueCount = 1,
-					.pClearValues = &clear_color,
-				};
 
-				vkCmdBeginRenderPass(command_buffer[current_frame], &render_pass_info, VK_SUBPASS_CONTENTS_INLINE);
-				{
-					vkCmdBindPipeline(command_buffer[current_frame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphics_pipeline);
-
-					// Define the viewport and the scissor rectangle dynamically as
-					// specified when initializing the pipeline.
-					VkViewport viewport = {
-						.x = 0.0f,
-						.y = 0.0f,
-						.width = extent.width,
-						.height = extent.height,
-						.minDepth = 0.0f,
-						.maxDepth = 1.0f,
-					};
-					VkRect2D scissor = {
-						.offset = {0, 0},
-						.extent = extent,
-					};
-					vkCmdSetViewport(command_buffer[current_frame], 0, 1, &viewport);
-					vkCmdSetScissor(command_buffer[current_frame], 0, 1, &scissor);
-
-					// Draw the triangle.
-					vkCmdDraw(command_buffer[current_frame], 3, 1, 0, 0);
-				}
-				vkCmdEndRenderPass(command_buffer[current_frame]);
+	/* ---
+	 * Set up frame pacing.
+	 *
+	 * On-demand rendering sleeps until an event dirties the scene instead of
+	 * rendering frames nobody asked for, and the frame cap spaces frames out
+	 * with a high-resolution timer. Either way, a frame that follows an idle
+	 * period starts right away, so input isn't delayed by the pacing.
+	 * ---
+	 */
+	bool on_demand = options.render == RENDER_ON_DEMAND;
+	if (on_demand && (headless || benchmark)) {
+		fprintf(stderr, "[WARNING] on-demand rendering requires a window outside of benchmark mode, "
+			"falling back to continuous rendering\n");
+		on_demand = false;
+	}
+	uint64_t frame_interval = options.max_fps > 0 ? UINT64_C(1000000000) / options.max_fps : 0;
+	if (on_demand) printf("[INFO] rendering on demand\n");
+	if (frame_interval > 0) printf("[INFO] capping the frame rate at %u frames per second\n", options.max_fps);
 
-				if (vkEndCommandBuffer(command_buffer[current_frame]) != VK_SUCCESS) {
-					fprintf(stderr, "[ERROR] failed to record command buffer\n");
-					exit(EXIT_FAILURE);
-				}
-			}
 
-			VkPipelineStageFlags wait_stages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-			VkSemaphore wait_semaphores[] = {image_available_semaphore[current_frame]};
-			VkSemaphore signal_semaphores[] = {render_finished_semaphore[current_frame]};
-
-			VkSubmitInfo submit_info = {
-				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-				.waitSemaphoreCount = 1,
-				.pWaitSemaphores = wait_semaphores,
-				.pWaitDstStageMask = wait_stages,
-				.signalSemaphoreCount = 1,
-				.pSignalSemaphores = signal_semaphores,
-				.commandBufferCount = 1,
-				.pCommandBuffers = &command_buffer[current_frame],
-			};
+	/* ---
+	 * Loop. Start event loop and rendering to screen.
+	 *
+	 * With a render thread, the main thread does nothing but pump GLFW
+	 * events, which GLFW only allows on the main thread, and posts them to
+	 * the event queue. The render thread owns the frame contexts, submission,
+	 * and presentation until it stops. This way, a slow present doesn't hold
+	 * up events, and a slow event callback doesn't hold up rendering.
+	 * ---
+	 */
+	bool render_thread = options.threading == THREADING_RENDER_THREAD;
+	if (render_thread && headless) {
+		fprintf(stderr, "[WARNING] headless rendering has no events to pump, rendering on the main thread\n");
+		render_thread = false;
+	}
 
-			// Submit the newly recorded command buffer.
-			if (vkQueueSubmit(graphics_queue, 1, &submit_info, in_flight_fence[current_frame]) != VK_SUCCESS) {
-				fprintf(stderr, "[ERROR] failed to submit draw command buffer\n");
-				exit(EXIT_FAILURE);
-			}
+	Renderer renderer = {
+		.options = &options,
+		.headless = headless,
+		.benchmark = benchmark,
+		.on_demand = on_demand,
+		.gpu_culling = gpu_culling,
+		.frame_interval = frame_interval,
+		.window = window,
+		.render_thread = render_thread,
+		.events = &events,
+		.device = device,
+		.graphics_queue = graphics_queue,
+		.present_queue = present_queue,
+		.render_pass = render_pass,
+		.dynamic_rendering = rendering_backend == RENDERING_BACKEND_DYNAMIC ? &dynamic_rendering : NULL,
+		.pipelines = &pipeline_variants,
+		.opaque_key = opaque_key,
+		.shaders = &shader_cache,
+		.startup = &startup,
+		.shader_watcher = watching_shaders ? &shader_watcher : NULL,
+		.layout = layout,
+		.set_layout = set_layout,
+		.attachments = &render_attachments,
+		.swapchain = &swapchain,
+		.offscreen = &offscreen,
+		.sync = &sync,
+		.frame_contexts = frame_contexts,
+		.profiler = &profiler,
+		.recorder = &recorder,
+		.culler = &culler,
+		.frame_stats = &frame_stats,
+		.n_frames_in_flight = n_frames_in_flight,
+		.vertex_buffers = vertex_buffers,
+		.index_buffers = index_buffers,
+		.instance_ring = &instance_ring,
+		.instance_region_size = instance_region_size,
+		.uniforms = &uniform_ring,
+		.descriptors = &descriptor_allocator,
+		.window_extent = headless ? offscreen.extent : get_window_extent(window),
+		.scene_dirty = true,
+	};
+	atomic_init(&renderer.stopped, false);
 
-			// Display the rendered image.
-			VkSwapchainKHR swapchains[] = {swapchain};
-			VkPresentInfoKHR present_info = {
-				.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-				.waitSemaphoreCount = 1,
-				.pWaitSemaphores = signal_semaphores,
-				.swapchainCount = 1,
-				.pSwapchains = swapchains,
-				.pImageIndices = &image_index,
-				.pResults = NULL,
-			};
-			vkQueuePresentKHR(present_queue, &present_info);
+	uint64_t loop_start = timer_now();
+	if (render_thread) {
+		pthread_t thread = {0};
+		if (pthread_create(&thread, NULL, render_thread_main, &renderer) != 0) {
+			fprintf(stderr, "[ERROR] failed to create render thread\n");
+			exit(EXIT_FAILURE);
 		}
+		printf("[INFO] rendering on a thread apart from events\n");
 
-		current_frame = (current_frame + 1) % MAX_FRAMES_IN_FLIGHT;
+		while (!atomic_load_explicit(&renderer.stopped, memory_order_acquire)) glfwWaitEvents();
+		pthread_join(thread, NULL);
+	} else {
+		render_loop(&renderer);
 	}
 
 	// Wait for the logical device to finish executing any commands.
 	vkDeviceWaitIdle(device);
+	uint64_t loop_end = timer_now();
+	if (watching_shaders) shader_watcher_stop(&shader_watcher);
+
+	// Drain the frames still in flight, and capture the last one rendered.
+	if (headless && renderer.n_frames_rendered > 0) {
+		uint32_t last_frame = (renderer.current_frame + n_frames_in_flight - 1) % n_frames_in_flight;
+		const void *last_pixels = offscreen_read(&offscreen, last_frame);
+		if (last_pixels) ++renderer.n_frames_read_back;
+		for (uint32_t i = 0; i < n_frames_in_flight; ++i) {
+			if (offscreen_read(&offscreen, i)) ++renderer.n_frames_read_back;
+		}
+		printf("[INFO] read back %" PRIu64 " of %" PRIu64 " frames\n", renderer.n_frames_read_back,
+			renderer.n_frames_rendered);
+
+		if (options.capture && last_pixels) {
+			if (offscreen_write_ppm(&offscreen, last_pixels, options.capture, &global_arena)) {
+				printf("[INFO] captured the last frame to '%s'\n", options.capture);
+			} else {
+				fprintf(stderr, "[WARNING] failed to capture the last frame to '%s'\n", options.capture);
+			}
+		}
+	}
 
 
 	/* ---
@@ -999,25 +2617,128 @@ main(void)
 	 * ---
 	 */
 	{
-		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
-			vkDestroyFence(device, in_flight_fence[i], NULL);
-			vkDestroySemaphore(device, render_finished_semaphore[i], NULL);
-			vkDestroySemaphore(device, image_available_semaphore[i], NULL);
+		if (options.record_threads > 0) {
+			recorder_print_stats(&recorder);
+			recorder_destroy(&recorder);
+			thread_pool_destroy(&recording_pool);
+		} else if (renderer.n_inline_frames > 0) {
+			printf("[INFO] recorded %" PRIu64 " frames inline in %.3f ms per frame\n", renderer.n_inline_frames,
+				renderer.inline_recording_ns / 1e6 / renderer.n_inline_frames);
 		}
-		vkDestroyCommandPool(device, command_pool, NULL);
-		vkDestroyPipeline(device, graphics_pipeline, NULL);
-		vkDestroyPipelineLayout(device, layout, NULL);
-		vkDestroyRenderPass(device, render_pass, NULL);
-		for (size_t i = 0; i < n_images; ++i) {
-			vkDestroyFramebuffer(device, framebuffers[i], NULL);
-			vkDestroyImageView(device, image_views[i], NULL);
+		Frame_Summary summary = {0};
+		if (frame_stats_summarize(&frame_stats, &global_arena, &summary)) {
+			frame_summary_print(&summary);
+
+			if (options.bench_output) {
+				char instances[16] = {0};
+				char draws[16] = {0};
+				char frames_in_flight[16] = {0};
+				char record_threads[16] = {0};
+				char warmup_frames[16] = {0};
+				char samples_per_pixel[16] = {0};
+				char instances_on_screen[32] = {0};
+				snprintf(instances, sizeof(instances), "%u", options.instances);
+				snprintf(draws, sizeof(draws), "%u", options.draws);
+				snprintf(frames_in_flight, sizeof(frames_in_flight), "%u", n_frames_in_flight);
+				snprintf(record_threads, sizeof(record_threads), "%u", options.record_threads);
+				snprintf(warmup_frames, sizeof(warmup_frames), "%u", benchmark ? options.warmup_frames : 0);
+				snprintf(samples_per_pixel, sizeof(samples_per_pixel), "%u", (uint32_t)samples);
+				snprintf(instances_on_screen, sizeof(instances_on_screen), "%.1f",
+					(double)renderer.n_instances_on_screen / renderer.n_frames_measured);
+
+				const char *const labels[][2] = {
+					{ "device", physical_device.properties.deviceName },
+					{ "present_mode", headless ? "headless" : present_mode_name(swapchain.present_mode) },
+					{ "sync", sync_backend_name(sync.backend) },
+					{ "geometry", options.geometry == GEOMETRY_STATIC ? "static" : "streaming" },
+					{ "culling", gpu_culling ? "compute" : "none" },
+					{ "instances", instances },
+					{ "instance_layout", options.instance_layout == INSTANCE_LAYOUT_SPREAD ? "spread" : "grid" },
+					{ "instances_on_screen", instances_on_screen },
+					{ "draws", draws },
+					{ "frames_in_flight", frames_in_flight },
+					{ "record_threads", record_threads },
+					{ "warmup_frames", warmup_frames },
+					{ "samples", samples_per_pixel },
+					{ "sort", options.sort == SORT_FRONT_TO_BACK ? "front-to-back" : "none" },
+					{ "rendering", rendering_backend_name(rendering_backend) },
+				};
+				if (frame_summary_write(&summary, options.bench_output, sizeof(labels) / sizeof(labels[0]), labels)) {
+					printf("[INFO] wrote benchmark results to '%s'\n", options.bench_output);
+				} else {
+					fprintf(stderr, "[WARNING] failed to write benchmark results to '%s'\n", options.bench_output);
+				}
+			}
+		}
+
+		// The memory cost of every sample count. Their frame time cost comes
+		// from benchmarking each --samples, which labels the results.
+		render_attachments_print_costs(&render_attachments,
+			physical_device.properties.limits.framebufferColorSampleCounts);
+
+		printf("[INFO] profile of the last %d frames:\n", PROFILER_HISTORY_LENGTH);
+		profiler_print(&profiler);
+		profiler_destroy(&profiler);
+
+		if (renderer.n_frames_rendered > 0) {
+			double seconds = timer_elapsed_ms(loop_start, loop_end) / 1e3;
+			uint64_t n_instances_per_frame = (uint64_t)options.draws * options.instances;
+			printf("[INFO] rendered %" PRIu64 " frames of %" PRIu64 " instances at %.0f instances per second\n",
+				renderer.n_frames_rendered, n_instances_per_frame,
+				renderer.n_frames_rendered * n_instances_per_frame / seconds);
+		}
+
+		// What culling buys: the instances off screen are the ones it skips.
+		if (renderer.n_frames_measured > 0) {
+			double on_screen = (double)renderer.n_instances_on_screen / renderer.n_frames_measured;
+			printf("[INFO] %.1f of %u instances per draw were on screen, so culling %s %.1f\n", on_screen,
+				options.instances, gpu_culling ? "rejected" : "would have rejected", options.instances - on_screen);
+		}
+
+		if (!headless) {
+			printf("[INFO] handled %" PRIu64 " window events", renderer.n_events);
+			if (events.n_dropped > 0) printf(" and dropped %" PRIu64 " with the event queue full", events.n_dropped);
+			printf("\n");
+		}
+
+		frame_sync_destroy(&sync);
+		if (gpu_culling) culler_destroy(&culler, &gpu_allocator);
+		descriptor_allocator_destroy(&descriptor_allocator);
+		uniform_ring_destroy(&uniform_ring, &gpu_allocator);
+		gpu_buffer_destroy(&gpu_allocator, &instance_ring);
+		if (headless) offscreen_destroy(&offscreen);
+		render_attachments_destroy(&render_attachments);
+		for (size_t i = 0; i < n_geometry_buffers; ++i) {
+			gpu_buffer_destroy(&gpu_allocator, &index_buffers[i]);
+			gpu_buffer_destroy(&gpu_allocator, &vertex_buffers[i]);
 		}
-		vkDestroySwapchainKHR(device, swapchain, NULL);
+		if (options.geometry == GEOMETRY_STREAMING) gpu_arena_destroy(&streaming_arena);
+		uploader_destroy(&uploader);
+		gpu_allocator_destroy(&gpu_allocator);
+		for (uint32_t i = 0; i < n_frames_in_flight; ++i) frame_context_destroy(&frame_contexts[i]);
+		pipeline_builder_destroy(&pipeline_builder);
+		thread_pool_destroy(&pipeline_pool);
+		pipeline_cache_store(device, pipeline_cache, PIPELINE_CACHE_FILENAME);
+		pipeline_cache_destroy(device, pipeline_cache);
+		shader_cache_destroy(&shader_cache);
+		vkDestroyPipelineLayout(device, layout, NULL);
+		vkDestroyDescriptorSetLayout(device, set_layout, NULL);
+		if (!headless) swapchain_destroy(&swapchain);
+		if (render_pass != VK_NULL_HANDLE) vkDestroyRenderPass(device, render_pass, NULL);
 		vkDestroyDevice(device, NULL);
-		vkDestroySurfaceKHR(instance, surface, NULL);
+		if (!headless) vkDestroySurfaceKHR(instance, surface, NULL);
 		vkDestroyInstance(instance, NULL);
-		glfwDestroyWindow(window);
-		glfwTerminate();
+		if (!headless) {
+			glfwDestroyWindow(window);
+			glfwTerminate();
+		}
+		event_queue_destroy(&events);
+
+		printf("[INFO] global arena high-water mark: %zu of %d bytes\n", global_arena.high_water_mark,
+			ARENA_BUFFER_LENGTH);
+		printf("[INFO] frame arena high-water mark: %zu of %zu bytes\n", frame_arena.high_water_mark,
+			frame_arena.buffer_length);
+		arena_free(&global_arena);
 	}
 
 	exit(EXIT_SUCCESS);
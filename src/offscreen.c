@@ -0,0 +1,169 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "debug.h"
+#include "file.h"
+#include "gpu_memory.h"
+#include "image.h"
+#include "offscreen.h"
+
+void
+offscreen_create(Offscreen_Target *target, Gpu_Allocator *allocator, VkExtent2D extent, uint32_t n_frames,
+	Arena *arena)
+{
+	*target = (Offscreen_Target){
+		.device = allocator->device,
+		.allocator = allocator,
+		.extent = extent,
+		.n_frames = n_frames,
+	};
+
+	target->frames = arena_alloc(arena, n_frames * sizeof(Offscreen_Frame));
+	assert(target->frames);
+
+	VkDeviceSize size = (VkDeviceSize)extent.width * extent.height * OFFSCREEN_BYTES_PER_PIXEL;
+	for (uint32_t i = 0; i < n_frames; ++i) {
+		Offscreen_Frame *frame = &target->frames[i];
+		frame->image = gpu_image_create(allocator, extent, OFFSCREEN_FORMAT,
+			VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_SAMPLE_COUNT_1_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 0);
+
+		// Cached memory makes reading the pixels on the CPU much faster than
+		// write-combined memory does.
+		frame->readback = gpu_buffer_create(allocator, size, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			VK_MEMORY_PROPERTY_HOST_CACHED_BIT, 0, NULL);
+		assert(frame->readback.allocation.mapped);
+	}
+}
+
+void
+offscreen_create_framebuffers(Offscreen_Target *target, VkRenderPass render_pass, uint32_t n_shared_attachments,
+	const VkImageView *shared_attachments)
+{
+	assert(n_shared_attachments <= OFFSCREEN_MAX_SHARED_ATTACHMENTS);
+
+	for (uint32_t i = 0; i < target->n_frames; ++i) {
+		Offscreen_Frame *frame = &target->frames[i];
+
+		VkImageView attachments[1 + OFFSCREEN_MAX_SHARED_ATTACHMENTS] = { frame->image.view };
+		for (uint32_t j = 0; j < n_shared_attachments; ++j) attachments[1 + j] = shared_attachments[j];
+
+		VkFramebufferCreateInfo framebuffer_info = {
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = render_pass,
+			.attachmentCount = 1 + n_shared_attachments,
+			.pAttachments = attachments,
+			.width = target->extent.width,
+			.height = target->extent.height,
+			.layers = 1,
+		};
+		if (vkCreateFramebuffer(target->device, &framebuffer_info, NULL, &frame->framebuffer) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create offscreen framebuffer\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void
+offscreen_destroy(Offscreen_Target *target)
+{
+	for (uint32_t i = 0; i < target->n_frames; ++i) {
+		Offscreen_Frame *frame = &target->frames[i];
+		vkDestroyFramebuffer(target->device, frame->framebuffer, NULL);
+		gpu_buffer_destroy(target->allocator, &frame->readback);
+		gpu_image_destroy(target->allocator, &frame->image);
+	}
+}
+
+void
+offscreen_record_readback(Offscreen_Target *target, uint32_t frame, VkCommandBuffer command_buffer)
+{
+	assert(frame < target->n_frames);
+	Offscreen_Frame *f = &target->frames[frame];
+
+	VkBufferImageCopy region = {
+		.bufferOffset = 0,
+		// Tightly packed rows.
+		.bufferRowLength = 0,
+		.bufferImageHeight = 0,
+		.imageSubresource = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.mipLevel = 0,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+		.imageOffset = { 0, 0, 0 },
+		.imageExtent = { target->extent.width, target->extent.height, 1 },
+	};
+	vkCmdCopyImageToBuffer(command_buffer, f->image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+		f->readback.handle, 1, &region);
+
+	// Make the copy available to the host once the frame's fence or timeline
+	// value signals.
+	VkBufferMemoryBarrier barrier = {
+		.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+		.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+		.dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.buffer = f->readback.handle,
+		.offset = 0,
+		.size = VK_WHOLE_SIZE,
+	};
+	vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, NULL,
+		1, &barrier, 0, NULL);
+
+	f->pending = true;
+}
+
+const void *
+offscreen_read(Offscreen_Target *target, uint32_t frame)
+{
+	assert(frame < target->n_frames);
+	Offscreen_Frame *f = &target->frames[frame];
+
+	if (!f->pending) return NULL;
+	f->pending = false;
+	return f->readback.allocation.mapped;
+}
+
+bool
+offscreen_write_ppm(const Offscreen_Target *target, const void *pixels, const char *filename, Arena *arena)
+{
+	Arena_Checkpoint checkpoint = arena_create_checkpoint(arena);
+
+	char header[64] = {0};
+	int header_length = snprintf(header, sizeof(header), "P6\n%u %u\n255\n", target->extent.width,
+		target->extent.height);
+	size_t n_pixels = (size_t)target->extent.width * target->extent.height;
+	size_t length = header_length + 3 * n_pixels;
+
+	unsigned char *contents = arena_alloc_uninitialized(arena, length);
+	if (!contents) {
+		arena_restore(checkpoint);
+		return false;
+	}
+
+	memcpy(contents, header, header_length);
+	const unsigned char *src = pixels;
+	unsigned char *dst = contents + header_length;
+	for (size_t i = 0; i < n_pixels; ++i) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		src += OFFSCREEN_BYTES_PER_PIXEL;
+		dst += 3;
+	}
+
+	bool written = write_file_atomic(filename, contents, length);
+	arena_restore(checkpoint);
+	return written;
+}
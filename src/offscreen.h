@@ -0,0 +1,71 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "buffer.h"
+#include "gpu_memory.h"
+#include "image.h"
+
+// Offscreen images are tightly packed RGBA when read back.
+#define OFFSCREEN_FORMAT	VK_FORMAT_R8G8B8A8_SRGB
+#define OFFSCREEN_BYTES_PER_PIXEL	4
+
+// Upper bound on the attachments that every framebuffer shares alongside its
+// own image.
+#define OFFSCREEN_MAX_SHARED_ATTACHMENTS	4
+
+typedef struct {
+	Gpu_Image image;
+	VkFramebuffer framebuffer;
+
+	// Host-visible memory that the image is copied to at the end of the frame.
+	Gpu_Buffer readback;
+
+	// Whether the frame copied to the readback buffer since the last read.
+	bool pending;
+} Offscreen_Frame;
+
+// A render target for headless rendering, in place of a swapchain. Every
+// frame in flight renders into an image of its own and copies it into a
+// readback buffer of its own, so the CPU reads one frame while the GPU
+// renders the next.
+typedef struct {
+	VkDevice device;
+	Gpu_Allocator *allocator;
+	VkExtent2D extent;
+
+	uint32_t n_frames;
+	Offscreen_Frame *frames;
+} Offscreen_Target;
+
+// Create the images and readback buffers. The frames are allocated from
+// `arena`.
+void offscreen_create(Offscreen_Target *target, Gpu_Allocator *allocator, VkExtent2D extent, uint32_t n_frames,
+	Arena *arena);
+
+// Create a framebuffer per frame with the frame's image as attachment 0,
+// followed by the attachments shared by all of them, as for a swapchain.
+void offscreen_create_framebuffers(Offscreen_Target *target, VkRenderPass render_pass, uint32_t n_shared_attachments,
+	const VkImageView *shared_attachments);
+void offscreen_destroy(Offscreen_Target *target);
+
+// Record the copy of the frame's image into its readback buffer. The render
+// pass must leave the image in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, and
+// make its color writes available to transfers.
+void offscreen_record_readback(Offscreen_Target *target, uint32_t frame, VkCommandBuffer command_buffer);
+
+// Return the frame's pixels from its previous submission, or NULL if there
+// are none that haven't been read yet. The submission must be complete. The
+// pixels stay valid until the frame is submitted again.
+const void *offscreen_read(Offscreen_Target *target, uint32_t frame);
+
+// Write pixels that were read back as a binary PPM, dropping alpha. The
+// conversion is staged in `arena`.
+bool offscreen_write_ppm(const Offscreen_Target *target, const void *pixels, const char *filename, Arena *arena);
+
+#endif
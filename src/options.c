@@ -0,0 +1,515 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "options.h"
+
+typedef struct {
+	const char *name;
+	const char *environment_variable;
+	const char *usage;
+} Option_Description;
+
+static const Option_Description option_descriptions[] = {
+	{
+		"present-mode", "TRIANGLE_PRESENT_MODE",
+		"fifo|fifo-relaxed|mailbox|immediate (default: mailbox, or immediate in benchmark mode)",
+	},
+	{
+		"max-queued-presents", "TRIANGLE_MAX_QUEUED_PRESENTS",
+		"<n> frames queued ahead of the display in fifo modes, 0 for no limit (default: 0)",
+	},
+	{
+		"frames-in-flight", "TRIANGLE_FRAMES_IN_FLIGHT",
+		"<n> frames recorded ahead of the GPU, at least 1 (default: 2)",
+	},
+	{
+		"sync", "TRIANGLE_SYNC",
+		"auto|binary|timeline frame synchronization with fences or timeline semaphores (default: auto)",
+	},
+	{
+		"device", "TRIANGLE_DEVICE",
+		"auto|<index>|<uuid> physical device to render with (default: auto)",
+	},
+	{
+		"geometry", "TRIANGLE_GEOMETRY",
+		"static|streaming geometry in device-local or persistently mapped memory (default: static)",
+	},
+	{
+		"pipeline-threads", "TRIANGLE_PIPELINE_THREADS",
+		"<n> threads compiling pipelines at startup, 0 for one fewer than the CPUs (default: 0)",
+	},
+	{
+		"record-threads", "TRIANGLE_RECORD_THREADS",
+		"<n> threads recording secondary command buffers, 0 to record inline (default: 0)",
+	},
+	{
+		"draws", "TRIANGLE_DRAWS",
+		"<n> draws of the triangle per frame, at least 1 (default: 1)",
+	},
+	{
+		"instances", "TRIANGLE_INSTANCES",
+		"<n> instances of the triangle per draw, at least 1 (default: 1)",
+	},
+	{
+		"culling", "TRIANGLE_CULLING",
+		"none|compute instance culling in a compute shader that feeds indirect draws (default: none)",
+	},
+	{
+		"instance-layout", "TRIANGLE_INSTANCE_LAYOUT",
+		"grid|spread instances tiling the viewport, or three times it with most off screen (default: grid)",
+	},
+	{
+		"profile-interval", "TRIANGLE_PROFILE_INTERVAL",
+		"<n> seconds between profiler reports, 0 to report only at exit (default: 0)",
+	},
+	{
+		"warmup-frames", "TRIANGLE_WARMUP_FRAMES",
+		"<n> frames rendered before measuring in benchmark mode (default: 100)",
+	},
+	{
+		"bench-frames", "TRIANGLE_BENCH_FRAMES",
+		"<n> frames measured in benchmark mode before exiting, 0 to disable it (default: 0)",
+	},
+	{
+		"bench-output", "TRIANGLE_BENCH_OUTPUT",
+		"<file> benchmark results as JSON for *.json, CSV otherwise (default: none)",
+	},
+	{
+		"display", "TRIANGLE_DISPLAY",
+		"window|headless presentation to a window, or offscreen rendering read back to the CPU (default: window)",
+	},
+	{
+		"capture", "TRIANGLE_CAPTURE",
+		"<file> PPM image of the last frame rendered in headless mode (default: none)",
+	},
+	{
+		"render", "TRIANGLE_RENDER",
+		"continuous|on-demand rendering of every frame, or only after input or a resize (default: continuous)",
+	},
+	{
+		"max-fps", "TRIANGLE_MAX_FPS",
+		"<n> frames per second at most, 0 for no cap (default: 0)",
+	},
+	{
+		"threading", "TRIANGLE_THREADING",
+		"single|render-thread rendering on the main thread, or on a thread apart from events (default: single)",
+	},
+	{
+		"samples", "TRIANGLE_SAMPLES",
+		"1|2|4|8|16|32|64 samples per pixel, resolved at the end of the render pass (default: 1)",
+	},
+	{
+		"sort", "TRIANGLE_SORT",
+		"none|front-to-back draw order, the latter sorting opaque draws for early depth rejection (default: none)",
+	},
+	{
+		"rendering", "TRIANGLE_RENDERING",
+		"auto|render-pass|dynamic rendering with a VkRenderPass or vkCmdBeginRendering (default: auto)",
+	},
+	{
+		"hot-reload", "TRIANGLE_HOT_RELOAD",
+		"off|on recompiling edited shaders with glslc and swapping in the rebuilt pipelines (default: off)",
+	},
+};
+#define OPTION_DESCRIPTIONS_LENGTH	(sizeof(option_descriptions) / sizeof(Option_Description))
+
+static void
+print_usage(FILE *stream, const char *program)
+{
+	fprintf(stream, "usage: %s [options]\n", program);
+	for (size_t i = 0; i < OPTION_DESCRIPTIONS_LENGTH; ++i) {
+		fprintf(stream, "  --%s=%s\n", option_descriptions[i].name, option_descriptions[i].usage);
+	}
+	fprintf(stream, "Each option may also be set through the environment variable TRIANGLE_<NAME>.\n");
+}
+
+static bool
+parse_uint32(const char *value, uint32_t *n)
+{
+	if (!value || !isdigit((unsigned char)*value)) return false;
+
+	char *end = NULL;
+	unsigned long long x = strtoull(value, &end, 10);
+	if (*end != '\0' || x > UINT32_MAX) return false;
+
+	*n = (uint32_t)x;
+	return true;
+}
+
+static bool
+parse_present_mode(const char *value, VkPresentModeKHR *present_mode)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "fifo") == 0) {
+		*present_mode = VK_PRESENT_MODE_FIFO_KHR;
+	} else if (strcmp(value, "fifo-relaxed") == 0) {
+		*present_mode = VK_PRESENT_MODE_FIFO_RELAXED_KHR;
+	} else if (strcmp(value, "mailbox") == 0) {
+		*present_mode = VK_PRESENT_MODE_MAILBOX_KHR;
+	} else if (strcmp(value, "immediate") == 0) {
+		*present_mode = VK_PRESENT_MODE_IMMEDIATE_KHR;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_sync_backend(const char *value, Sync_Backend *backend)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "auto") == 0) {
+		*backend = SYNC_BACKEND_AUTO;
+	} else if (strcmp(value, "binary") == 0) {
+		*backend = SYNC_BACKEND_BINARY;
+	} else if (strcmp(value, "timeline") == 0) {
+		*backend = SYNC_BACKEND_TIMELINE;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_geometry_mode(const char *value, Geometry_Mode *geometry)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "static") == 0) {
+		*geometry = GEOMETRY_STATIC;
+	} else if (strcmp(value, "streaming") == 0) {
+		*geometry = GEOMETRY_STREAMING;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_culling_mode(const char *value, Culling_Mode *culling)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "none") == 0) {
+		*culling = CULLING_NONE;
+	} else if (strcmp(value, "compute") == 0) {
+		*culling = CULLING_COMPUTE;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_instance_layout(const char *value, Instance_Layout *layout)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "grid") == 0) {
+		*layout = INSTANCE_LAYOUT_GRID;
+	} else if (strcmp(value, "spread") == 0) {
+		*layout = INSTANCE_LAYOUT_SPREAD;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_display_mode(const char *value, Display_Mode *display)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "window") == 0) {
+		*display = DISPLAY_WINDOW;
+	} else if (strcmp(value, "headless") == 0) {
+		*display = DISPLAY_HEADLESS;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_render_mode(const char *value, Render_Mode *render)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "continuous") == 0) {
+		*render = RENDER_CONTINUOUS;
+	} else if (strcmp(value, "on-demand") == 0) {
+		*render = RENDER_ON_DEMAND;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_threading_mode(const char *value, Threading_Mode *threading)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "single") == 0) {
+		*threading = THREADING_SINGLE;
+	} else if (strcmp(value, "render-thread") == 0) {
+		*threading = THREADING_RENDER_THREAD;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+// Parse a device UUID as 32 hexadecimal digits. Dashes are skipped, so both
+// the plain and the usual 8-4-4-4-12 spelling are accepted.
+static bool
+parse_sort_mode(const char *value, Sort_Mode *sort)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "none") == 0) {
+		*sort = SORT_NONE;
+	} else if (strcmp(value, "front-to-back") == 0) {
+		*sort = SORT_FRONT_TO_BACK;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_rendering_backend(const char *value, Rendering_Backend *backend)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "auto") == 0) {
+		*backend = RENDERING_BACKEND_AUTO;
+	} else if (strcmp(value, "render-pass") == 0) {
+		*backend = RENDERING_BACKEND_RENDER_PASS;
+	} else if (strcmp(value, "dynamic") == 0) {
+		*backend = RENDERING_BACKEND_DYNAMIC;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_switch(const char *value, bool *enabled)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "off") == 0) {
+		*enabled = false;
+	} else if (strcmp(value, "on") == 0) {
+		*enabled = true;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+static bool
+parse_uuid(const char *value, uint8_t uuid[VK_UUID_SIZE])
+{
+	size_t n_digits = 0;
+	for (const char *c = value; *c != '\0'; ++c) {
+		if (*c == '-') continue;
+		if (!isxdigit((unsigned char)*c) || n_digits == 2 * VK_UUID_SIZE) return false;
+
+		uint8_t digit = isdigit((unsigned char)*c) ? *c - '0' : tolower((unsigned char)*c) - 'a' + 10;
+		if (n_digits % 2 == 0) {
+			uuid[n_digits / 2] = digit << 4;
+		} else {
+			uuid[n_digits / 2] |= digit;
+		}
+		++n_digits;
+	}
+
+	return n_digits == 2 * VK_UUID_SIZE;
+}
+
+static bool
+parse_device(const char *value, Options *options)
+{
+	if (!value) return false;
+
+	if (strcmp(value, "auto") == 0) {
+		options->device_selection = DEVICE_SELECTION_AUTO;
+	} else if (parse_uint32(value, &options->device_index)) {
+		options->device_selection = DEVICE_SELECTION_INDEX;
+	} else if (parse_uuid(value, options->device_uuid)) {
+		options->device_selection = DEVICE_SELECTION_UUID;
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
+// Apply a single option. The value is NULL when a flag is given without one.
+static bool
+apply_option(Options *options, const char *name, const char *value)
+{
+	if (strcmp(name, "present-mode") == 0) {
+		return parse_present_mode(value, &options->present_mode);
+	} else if (strcmp(name, "max-queued-presents") == 0) {
+		return parse_uint32(value, &options->max_queued_presents);
+	} else if (strcmp(name, "frames-in-flight") == 0) {
+		return parse_uint32(value, &options->frames_in_flight) && options->frames_in_flight > 0;
+	} else if (strcmp(name, "sync") == 0) {
+		return parse_sync_backend(value, &options->sync_backend);
+	} else if (strcmp(name, "device") == 0) {
+		return parse_device(value, options);
+	} else if (strcmp(name, "geometry") == 0) {
+		return parse_geometry_mode(value, &options->geometry);
+	} else if (strcmp(name, "pipeline-threads") == 0) {
+		return parse_uint32(value, &options->pipeline_threads);
+	} else if (strcmp(name, "record-threads") == 0) {
+		return parse_uint32(value, &options->record_threads);
+	} else if (strcmp(name, "draws") == 0) {
+		return parse_uint32(value, &options->draws) && options->draws > 0;
+	} else if (strcmp(name, "instances") == 0) {
+		return parse_uint32(value, &options->instances) && options->instances > 0;
+	} else if (strcmp(name, "culling") == 0) {
+		return parse_culling_mode(value, &options->culling);
+	} else if (strcmp(name, "instance-layout") == 0) {
+		return parse_instance_layout(value, &options->instance_layout);
+	} else if (strcmp(name, "profile-interval") == 0) {
+		return parse_uint32(value, &options->profile_interval);
+	} else if (strcmp(name, "warmup-frames") == 0) {
+		return parse_uint32(value, &options->warmup_frames);
+	} else if (strcmp(name, "bench-frames") == 0) {
+		return parse_uint32(value, &options->bench_frames);
+	} else if (strcmp(name, "bench-output") == 0) {
+		if (!value || *value == '\0') return false;
+		options->bench_output = value;
+		return true;
+	} else if (strcmp(name, "display") == 0) {
+		return parse_display_mode(value, &options->display);
+	} else if (strcmp(name, "capture") == 0) {
+		if (!value || *value == '\0') return false;
+		options->capture = value;
+		return true;
+	} else if (strcmp(name, "render") == 0) {
+		return parse_render_mode(value, &options->render);
+	} else if (strcmp(name, "max-fps") == 0) {
+		return parse_uint32(value, &options->max_fps);
+	} else if (strcmp(name, "threading") == 0) {
+		return parse_threading_mode(value, &options->threading);
+	} else if (strcmp(name, "samples") == 0) {
+		// Sample counts are powers of two up to VK_SAMPLE_COUNT_64_BIT.
+		return parse_uint32(value, &options->samples) && options->samples > 0 && options->samples <= 64 &&
+			(options->samples & (options->samples - 1)) == 0;
+	} else if (strcmp(name, "sort") == 0) {
+		return parse_sort_mode(value, &options->sort);
+	} else if (strcmp(name, "rendering") == 0) {
+		return parse_rendering_backend(value, &options->rendering);
+	} else if (strcmp(name, "hot-reload") == 0) {
+		return parse_switch(value, &options->hot_reload);
+	}
+
+	return false;
+}
+
+void
+options_parse(Options *options, int argc, char **argv)
+{
+	*options = (Options){
+		// Resolved after parsing since it depends on benchmark mode.
+		.present_mode = VK_PRESENT_MODE_MAX_ENUM_KHR,
+		.max_queued_presents = 0,
+		.frames_in_flight = 2,
+		.sync_backend = SYNC_BACKEND_AUTO,
+		.device_selection = DEVICE_SELECTION_AUTO,
+		.geometry = GEOMETRY_STATIC,
+		.pipeline_threads = 0,
+		.record_threads = 0,
+		.draws = 1,
+		.instances = 1,
+		.culling = CULLING_NONE,
+		.instance_layout = INSTANCE_LAYOUT_GRID,
+		.profile_interval = 0,
+		.warmup_frames = 100,
+		.bench_frames = 0,
+		.bench_output = NULL,
+		.display = DISPLAY_WINDOW,
+		.capture = NULL,
+		.render = RENDER_CONTINUOUS,
+		.max_fps = 0,
+		.threading = THREADING_SINGLE,
+		.samples = 1,
+		.sort = SORT_NONE,
+		.rendering = RENDERING_BACKEND_AUTO,
+		.hot_reload = false,
+	};
+
+	const char *program = argc > 0 ? argv[0] : "triangle";
+
+	// Apply the environment first so the command line overrides it.
+	for (size_t i = 0; i < OPTION_DESCRIPTIONS_LENGTH; ++i) {
+		const Option_Description *description = &option_descriptions[i];
+
+		const char *value = getenv(description->environment_variable);
+		if (!value) continue;
+
+		if (!apply_option(options, description->name, value)) {
+			fprintf(stderr, "[ERROR] invalid value '%s' for %s\n", value, description->environment_variable);
+			print_usage(stderr, program);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		const char *argument = argv[i];
+
+		if (strcmp(argument, "--help") == 0 || strcmp(argument, "-h") == 0) {
+			print_usage(stdout, program);
+			exit(EXIT_SUCCESS);
+		}
+
+		if (strncmp(argument, "--", 2) != 0) {
+			fprintf(stderr, "[ERROR] unexpected argument '%s'\n", argument);
+			print_usage(stderr, program);
+			exit(EXIT_FAILURE);
+		}
+
+		// Split `--name=value` into its name and its value.
+		char name[64] = {0};
+		const char *value = NULL;
+		const char *equals = strchr(argument, '=');
+		size_t name_length = equals ? (size_t)(equals - argument - 2) : strlen(argument + 2);
+		if (name_length >= sizeof(name)) name_length = sizeof(name) - 1;
+		memcpy(name, argument + 2, name_length);
+		if (equals) value = equals + 1;
+
+		if (!apply_option(options, name, value)) {
+			fprintf(stderr, "[ERROR] invalid option '%s'\n", argument);
+			print_usage(stderr, program);
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	if (options->present_mode == VK_PRESENT_MODE_MAX_ENUM_KHR) {
+		options->present_mode = options->bench_frames > 0 ? VK_PRESENT_MODE_IMMEDIATE_KHR : VK_PRESENT_MODE_MAILBOX_KHR;
+	}
+}
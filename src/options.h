@@ -0,0 +1,190 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "frame_sync.h"
+#include "rendering.h"
+
+typedef enum {
+	DEVICE_SELECTION_AUTO,
+	DEVICE_SELECTION_INDEX,
+	DEVICE_SELECTION_UUID,
+} Device_Selection;
+
+typedef enum {
+	// Geometry is uploaded once into device-local memory through a staging
+	// buffer on the transfer queue.
+	GEOMETRY_STATIC,
+
+	// Geometry is rewritten every frame into persistently mapped
+	// host-visible memory that the GPU reads directly.
+	GEOMETRY_STREAMING,
+} Geometry_Mode;
+
+typedef enum {
+	// Every instance is drawn with a single vkCmdDrawIndexed().
+	CULLING_NONE,
+
+	// A compute shader culls the instances against the viewport, and writes
+	// the indirect commands that draw the visible ones.
+	CULLING_COMPUTE,
+} Culling_Mode;
+
+typedef enum {
+	// The instances tile the viewport, so every one of them is on screen.
+	INSTANCE_LAYOUT_GRID,
+
+	// The instances tile three times the viewport in each axis, centered on
+	// it, so only about one in nine is on screen.
+	INSTANCE_LAYOUT_SPREAD,
+} Instance_Layout;
+
+typedef enum {
+	// Frames are presented to a window through a swapchain.
+	DISPLAY_WINDOW,
+
+	// Frames are rendered into offscreen images and read back to the CPU,
+	// without GLFW, a surface, or a swapchain.
+	DISPLAY_HEADLESS,
+} Display_Mode;
+
+typedef enum {
+	// A new frame is rendered as soon as the previous one allows.
+	RENDER_CONTINUOUS,
+
+	// The loop sleeps in glfwWaitEventsTimeout() until an event dirties the
+	// scene, e.g. input, a resize, or the window being exposed.
+	RENDER_ON_DEMAND,
+} Render_Mode;
+
+typedef enum {
+	// The main thread pumps events, records, submits, and presents in turn.
+	THREADING_SINGLE,
+
+	// The main thread only pumps events, which cross over to a render thread
+	// that records, submits, and presents.
+	THREADING_RENDER_THREAD,
+} Threading_Mode;
+
+typedef enum {
+	// Draws are recorded in the order the scene lists them, which is back to
+	// front, so every layer overdraws the ones behind it.
+	SORT_NONE,
+
+	// Opaque draws are sorted front to back by depth before recording, so the
+	// depth test rejects hidden fragments ahead of shading them.
+	SORT_FRONT_TO_BACK,
+} Sort_Mode;
+
+// Runtime configuration. Every option can be given on the command line as
+// `--name=value` or through the environment as `TRIANGLE_NAME=value`; the
+// command line takes precedence.
+typedef struct {
+	// Preferred presentation mode. If the surface doesn't support it, the
+	// swapchain walks the fallback order documented in swapchain.c. It
+	// defaults to mailbox, or to immediate in benchmark mode so the display
+	// can't cap the frame rate.
+	VkPresentModeKHR present_mode;
+
+	// Maximum number of frames queued for presentation in the FIFO modes. It
+	// requires VK_KHR_present_wait, and 0 disables the limit.
+	uint32_t max_queued_presents;
+
+	// Number of frames the CPU may record ahead of the GPU. It's clamped to
+	// the number of swapchain images since extra frames could never acquire
+	// an image anyway.
+	uint32_t frames_in_flight;
+
+	// How the CPU waits on frames in flight. The timeline backend requires
+	// Vulkan 1.2; without it, the binary backend is used instead.
+	Sync_Backend sync_backend;
+
+	// Physical device to render with. By default, the highest scoring device
+	// is used; it can be forced by its index in vkEnumeratePhysicalDevices()
+	// or by its deviceUUID, which stays stable when devices are reordered.
+	Device_Selection device_selection;
+	uint32_t device_index;
+	uint8_t device_uuid[VK_UUID_SIZE];
+
+	// Where vertex and index data lives and how it gets there.
+	Geometry_Mode geometry;
+
+	// Number of worker threads that compile pipelines at startup, where 0
+	// means one fewer than the number of CPUs.
+	uint32_t pipeline_threads;
+
+	// Number of worker threads that record secondary command buffers every
+	// frame, where 0 records the draws inline into the primary command buffer.
+	uint32_t record_threads;
+
+	// Number of draws per frame. Every draw renders the same triangle, which
+	// makes the CPU cost of recording easy to scale up.
+	uint32_t draws;
+
+	// Number of instances of the triangle per draw, each with its own
+	// offset, scale, and color, streamed through a per-frame instance ring.
+	uint32_t instances;
+
+	// Whether the GPU culls the instances ahead of drawing them.
+	Culling_Mode culling;
+
+	// Where the instances are laid out, and so how many of them culling can
+	// reject.
+	Instance_Layout instance_layout;
+
+	// Seconds between profiler reports on the console, where 0 reports only
+	// once at exit.
+	uint32_t profile_interval;
+
+	// Benchmark mode renders `warmup_frames` unmeasured frames and then
+	// `bench_frames` measured frames, and exits; 0 measured frames disables
+	// it. The frame time statistics are written to `bench_output`, if set.
+	uint32_t warmup_frames;
+	uint32_t bench_frames;
+	const char *bench_output;
+
+	// Where frames go once they're rendered. In headless mode, the last frame
+	// read back is written as a binary PPM to `capture`, if set, and the
+	// program runs until interrupted unless benchmark mode ends it.
+	Display_Mode display;
+	const char *capture;
+
+	// When frames are rendered. On-demand rendering only applies to a window
+	// outside of benchmark mode, since nothing else dirties the scene.
+	Render_Mode render;
+
+	// Maximum frames per second, paced with a high-resolution timer on top
+	// of whatever the present mode allows, where 0 disables the cap.
+	uint32_t max_fps;
+
+	// Which threads handle events and render. A render thread only applies
+	// to a window, since headless rendering has no events to pump.
+	Threading_Mode threading;
+
+	// Samples per pixel of the color attachment, where 1 disables
+	// multisampling. It's lowered to the highest count the device supports
+	// for color framebuffers, if necessary.
+	uint32_t samples;
+
+	// The order draws are recorded in.
+	Sort_Mode sort;
+
+	// How frames begin and end rendering. Dynamic rendering requires Vulkan
+	// 1.3, or Vulkan 1.2 with VK_KHR_dynamic_rendering and
+	// VK_KHR_synchronization2; without them, the render pass backend is used
+	// instead.
+	Rendering_Backend rendering;
+
+	// Watch shaders/ for edits to the GLSL sources, recompile them with glslc
+	// on a background thread, and swap the pipelines rebuilt with them in
+	// between frames. On demand, a reload shows once the scene is dirtied.
+	bool hot_reload;
+} Options;
+
+void options_parse(Options *options, int argc, char **argv);
+
+#endif
@@ -0,0 +1,382 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "debug.h"
+#include "pipeline_builder.h"
+#include "shader.h"
+#include "thread_pool.h"
+#include "timer.h"
+
+void
+pipeline_builder_init(Pipeline_Builder *builder, VkDevice device, VkPipelineCache cache, bool warm_cache,
+	VkPipelineLayout layout, VkRenderPass render_pass, const VkPipelineVertexInputStateCreateInfo *vertex_input,
+	Shader_Cache *shaders, Thread_Pool *pool)
+{
+	memset(builder, 0, sizeof(Pipeline_Builder));
+	builder->device = device;
+	builder->cache = cache;
+	builder->warm_cache = warm_cache;
+	builder->layout = layout;
+	builder->render_pass = render_pass;
+	builder->shaders = shaders;
+	builder->pool = pool;
+
+	// Keep a copy of the vertex input layout since builds outlive the
+	// caller's description of it.
+	assert(vertex_input->vertexBindingDescriptionCount <= PIPELINE_BUILDER_MAX_BINDINGS);
+	assert(vertex_input->vertexAttributeDescriptionCount <= PIPELINE_BUILDER_MAX_ATTRIBUTES);
+	builder->n_bindings = vertex_input->vertexBindingDescriptionCount;
+	builder->n_attributes = vertex_input->vertexAttributeDescriptionCount;
+	memcpy(builder->bindings, vertex_input->pVertexBindingDescriptions,
+		builder->n_bindings * sizeof(VkVertexInputBindingDescription));
+	memcpy(builder->attributes, vertex_input->pVertexAttributeDescriptions,
+		builder->n_attributes * sizeof(VkVertexInputAttributeDescription));
+
+	pthread_mutex_init(&builder->shader_mutex, NULL);
+	pthread_mutex_init(&builder->mutex, NULL);
+	pthread_cond_init(&builder->pipeline_finished, NULL);
+}
+
+// Wait for every build, and destroy the pipelines. The pipeline cache then
+// holds all of them, ready to be stored.
+void
+pipeline_builder_destroy(Pipeline_Builder *builder)
+{
+	pipeline_builder_wait_all(builder);
+
+	for (uint32_t i = 0; i < builder->n_pipelines; ++i) {
+		if (builder->pipelines[i].state == PIPELINE_RELEASED) continue;
+		vkDestroyPipeline(builder->device, builder->pipelines[i].pipeline, NULL);
+	}
+
+	pthread_cond_destroy(&builder->pipeline_finished);
+	pthread_mutex_destroy(&builder->mutex);
+	pthread_mutex_destroy(&builder->shader_mutex);
+}
+
+void
+pipeline_builder_use_dynamic_rendering(Pipeline_Builder *builder, VkFormat color_format, VkFormat depth_format)
+{
+	assert(builder->n_pipelines == 0);
+	builder->render_pass = VK_NULL_HANDLE;
+	builder->color_format = color_format;
+	builder->depth_format = depth_format;
+}
+
+static void
+fill_stages(Pipeline_Builder *builder, const Pipeline_Description *description, bool by_identifier,
+	const VkSpecializationInfo *specialization, VkPipelineShaderStageCreateInfo stages[2],
+	VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifiers[2])
+{
+	pthread_mutex_lock(&builder->shader_mutex);
+	shader_stage_info(builder->shaders, description->vert_shader, VK_SHADER_STAGE_VERTEX_BIT, by_identifier,
+		&stages[0], &identifiers[0]);
+	shader_stage_info(builder->shaders, description->frag_shader, VK_SHADER_STAGE_FRAGMENT_BIT, by_identifier,
+		&stages[1], &identifiers[1]);
+	pthread_mutex_unlock(&builder->shader_mutex);
+
+	stages[0].pSpecializationInfo = specialization;
+	stages[1].pSpecializationInfo = specialization;
+}
+
+// Compile a single pipeline. This runs on a worker thread.
+static void
+build_pipeline(void *argument)
+{
+	Pipeline_Build *build = argument;
+	Pipeline_Builder *builder = build->builder;
+	const Pipeline_Description *description = &build->description;
+
+	uint64_t start = timer_now();
+
+	// On a warm pipeline cache, try to create the pipeline from shader module
+	// identifiers alone, skipping module creation altogether.
+	bool by_identifier = builder->shaders->get_identifier && builder->warm_cache;
+
+	// Both stages share the constants; a stage ignores the ones it doesn't
+	// declare.
+	assert(description->n_constants <= PIPELINE_BUILDER_MAX_CONSTANTS);
+	VkSpecializationMapEntry constant_entries[PIPELINE_BUILDER_MAX_CONSTANTS] = {0};
+	for (uint32_t i = 0; i < description->n_constants; ++i) {
+		constant_entries[i] = (VkSpecializationMapEntry){
+			.constantID = i,
+			.offset = i * sizeof(uint32_t),
+			.size = sizeof(uint32_t),
+		};
+	}
+	VkSpecializationInfo specialization = {
+		.mapEntryCount = description->n_constants,
+		.pMapEntries = constant_entries,
+		.dataSize = description->n_constants * sizeof(uint32_t),
+		.pData = description->constants,
+	};
+	const VkSpecializationInfo *specialization_info = description->n_constants ? &specialization : NULL;
+
+	VkPipelineShaderStageCreateInfo stages[2] = {0};
+	VkPipelineShaderStageModuleIdentifierCreateInfoEXT identifiers[2] = {0};
+	fill_stages(builder, description, by_identifier, specialization_info, stages, identifiers);
+
+	VkPipelineVertexInputStateCreateInfo vertex_input_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+		.vertexBindingDescriptionCount = builder->n_bindings,
+		.pVertexBindingDescriptions = builder->bindings,
+		.vertexAttributeDescriptionCount = builder->n_attributes,
+		.pVertexAttributeDescriptions = builder->attributes,
+	};
+
+	VkPipelineInputAssemblyStateCreateInfo input_assembly = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+		.topology = description->topology,
+		.primitiveRestartEnable = VK_FALSE,
+	};
+
+	// Specify viewport and scissor filter dynamically as opposed to statically
+	// in the pipeline. Only their number is part of the pipeline then.
+	VkDynamicState dynamic_states[] = {
+		VK_DYNAMIC_STATE_VIEWPORT,
+		VK_DYNAMIC_STATE_SCISSOR,
+	};
+	VkPipelineDynamicStateCreateInfo dynamic_state = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+		.dynamicStateCount = 2,
+		.pDynamicStates = dynamic_states,
+	};
+	VkPipelineViewportStateCreateInfo viewport_state_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+		.viewportCount = 1,
+		.scissorCount = 1,
+	};
+
+	// Given vertices from the vertex shader, the rasterizer yields fragments
+	// for the fragment shader to transform.
+	VkPipelineRasterizationStateCreateInfo rasterizer = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+		.depthClampEnable = VK_FALSE,
+		.rasterizerDiscardEnable = VK_FALSE,
+		.polygonMode = VK_POLYGON_MODE_FILL,
+		.lineWidth = 1.0f,
+		.cullMode = description->cull_mode,
+		.frontFace = VK_FRONT_FACE_CLOCKWISE,
+		.depthBiasEnable = VK_FALSE,
+	};
+
+	// Multisampling, a form of antialiasing, rasterizes at the sample count
+	// of the render pass's color attachment. Shading stays per pixel.
+	VkPipelineMultisampleStateCreateInfo multisampling = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+		.sampleShadingEnable = VK_FALSE,
+		.rasterizationSamples = description->samples,
+	};
+
+	// Nearer fragments have smaller depth, and the render pass clears depth
+	// to the far plane.
+	VkPipelineDepthStencilStateCreateInfo depth_stencil = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO,
+		.depthTestEnable = VK_TRUE,
+		.depthWriteEnable = description->depth_write ? VK_TRUE : VK_FALSE,
+		.depthCompareOp = VK_COMPARE_OP_LESS,
+		.depthBoundsTestEnable = VK_FALSE,
+		.stencilTestEnable = VK_FALSE,
+	};
+
+	VkPipelineColorBlendAttachmentState color_blend_attachment = {
+		.colorWriteMask =
+			VK_COLOR_COMPONENT_R_BIT |
+			VK_COLOR_COMPONENT_G_BIT |
+			VK_COLOR_COMPONENT_B_BIT |
+			VK_COLOR_COMPONENT_A_BIT,
+		.blendEnable = description->blend ? VK_TRUE : VK_FALSE,
+		.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
+		.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
+		.colorBlendOp = VK_BLEND_OP_ADD,
+		.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
+		.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
+		.alphaBlendOp = VK_BLEND_OP_ADD,
+	};
+	VkPipelineColorBlendStateCreateInfo color_blending = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+		.logicOpEnable = VK_FALSE,
+		.attachmentCount = 1,
+		.pAttachments = &color_blend_attachment,
+	};
+
+	VkGraphicsPipelineCreateInfo pipeline_info = {
+		.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+		.flags = by_identifier ? VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT : 0,
+		.stageCount = 2,
+		.pStages = stages,
+		.pVertexInputState = &vertex_input_info,
+		.pInputAssemblyState = &input_assembly,
+		.pViewportState = &viewport_state_info,
+		.pRasterizationState = &rasterizer,
+		.pMultisampleState = &multisampling,
+		.pDepthStencilState = &depth_stencil,
+		.pColorBlendState = &color_blending,
+		.pDynamicState = &dynamic_state,
+		.layout = builder->layout,
+		.renderPass = builder->render_pass,
+		.subpass = 0,
+	};
+
+	// The stencil aspect of the depth format, if any, goes unused.
+	VkPipelineRenderingCreateInfo rendering_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+		.colorAttachmentCount = 1,
+		.pColorAttachmentFormats = &builder->color_format,
+		.depthAttachmentFormat = builder->depth_format,
+		.stencilAttachmentFormat = VK_FORMAT_UNDEFINED,
+	};
+	if (builder->render_pass == VK_NULL_HANDLE) pipeline_info.pNext = &rendering_info;
+
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkResult result = vkCreateGraphicsPipelines(builder->device, builder->cache, 1, &pipeline_info, NULL,
+		&pipeline);
+	if (by_identifier && result == VK_PIPELINE_COMPILE_REQUIRED) {
+		// The pipeline cache missed after all, so compile from modules.
+		by_identifier = false;
+		fill_stages(builder, description, false, specialization_info, stages, identifiers);
+		pipeline_info.flags = 0;
+		result = vkCreateGraphicsPipelines(builder->device, builder->cache, 1, &pipeline_info, NULL, &pipeline);
+	}
+
+	pthread_mutex_lock(&builder->mutex);
+	build->pipeline = pipeline;
+	build->build_ms = timer_elapsed_ms(start, timer_now());
+	build->by_identifier = by_identifier;
+	build->state = result == VK_SUCCESS ? PIPELINE_READY : PIPELINE_FAILED;
+	pthread_cond_broadcast(&builder->pipeline_finished);
+	pthread_mutex_unlock(&builder->mutex);
+}
+
+// Queue a pipeline for compilation, and return its index in the builder. The
+// slot of a released pipeline is reused before a new one is taken.
+uint32_t
+pipeline_builder_submit(Pipeline_Builder *builder, const Pipeline_Description *description)
+{
+	pthread_mutex_lock(&builder->mutex);
+	uint32_t index = 0;
+	while (index < builder->n_pipelines && builder->pipelines[index].state != PIPELINE_RELEASED) ++index;
+	if (index == PIPELINE_BUILDER_MAX_PIPELINES) {
+		fprintf(stderr, "[ERROR] too many pipelines for the pipeline builder\n");
+		exit(EXIT_FAILURE);
+	}
+	if (index == builder->n_pipelines) ++builder->n_pipelines;
+	Pipeline_Build *build = &builder->pipelines[index];
+	*build = (Pipeline_Build){
+		.builder = builder,
+		.description = *description,
+		.state = PIPELINE_PENDING,
+	};
+	pthread_mutex_unlock(&builder->mutex);
+
+	thread_pool_submit(builder->pool, build_pipeline, build);
+	return index;
+}
+
+// Return the pipeline if it's ready, or VK_NULL_HANDLE while it's still
+// compiling. This never blocks on the compilation.
+VkPipeline
+pipeline_builder_get(Pipeline_Builder *builder, uint32_t index)
+{
+	assert(index < builder->n_pipelines);
+
+	pthread_mutex_lock(&builder->mutex);
+	Pipeline_Build *build = &builder->pipelines[index];
+	VkPipeline pipeline = build->state == PIPELINE_READY ? build->pipeline : VK_NULL_HANDLE;
+	pthread_mutex_unlock(&builder->mutex);
+
+	return pipeline;
+}
+
+// Return the state of a build without blocking on it.
+Pipeline_State
+pipeline_builder_state(Pipeline_Builder *builder, uint32_t index)
+{
+	assert(index < builder->n_pipelines);
+
+	pthread_mutex_lock(&builder->mutex);
+	Pipeline_State state = builder->pipelines[index].state;
+	pthread_mutex_unlock(&builder->mutex);
+
+	return state;
+}
+
+// Destroy a pipeline that's done compiling, and free its slot. The caller
+// must make sure the GPU no longer uses it.
+void
+pipeline_builder_release(Pipeline_Builder *builder, uint32_t index)
+{
+	assert(index < builder->n_pipelines);
+
+	pthread_mutex_lock(&builder->mutex);
+	Pipeline_Build *build = &builder->pipelines[index];
+	assert(build->state == PIPELINE_READY || build->state == PIPELINE_FAILED);
+	vkDestroyPipeline(builder->device, build->pipeline, NULL);
+	build->pipeline = VK_NULL_HANDLE;
+	build->state = PIPELINE_RELEASED;
+	pthread_mutex_unlock(&builder->mutex);
+}
+
+// Whether any pipeline that hasn't been released, compiling or not, was
+// described with the shader.
+bool
+pipeline_builder_uses_shader(Pipeline_Builder *builder, const Shader *shader)
+{
+	bool used = false;
+
+	pthread_mutex_lock(&builder->mutex);
+	for (uint32_t i = 0; i < builder->n_pipelines && !used; ++i) {
+		const Pipeline_Build *build = &builder->pipelines[i];
+		used = build->state != PIPELINE_RELEASED &&
+			(build->description.vert_shader == shader || build->description.frag_shader == shader);
+	}
+	pthread_mutex_unlock(&builder->mutex);
+
+	return used;
+}
+
+static void
+report_build(const Pipeline_Build *build, uint32_t index)
+{
+	printf("[INFO] created graphics pipeline %u in %.3f ms on a worker thread (from %s)\n", index,
+		build->build_ms, build->by_identifier ? "shader module identifiers" : "shader modules");
+}
+
+// Block until the pipeline is compiled. Failing to compile is fatal.
+VkPipeline
+pipeline_builder_wait(Pipeline_Builder *builder, uint32_t index)
+{
+	assert(index < builder->n_pipelines);
+
+	pthread_mutex_lock(&builder->mutex);
+	Pipeline_Build *build = &builder->pipelines[index];
+	while (build->state == PIPELINE_PENDING) {
+		pthread_cond_wait(&builder->pipeline_finished, &builder->mutex);
+	}
+	Pipeline_State state = build->state;
+	VkPipeline pipeline = build->pipeline;
+	pthread_mutex_unlock(&builder->mutex);
+
+	if (state == PIPELINE_FAILED) {
+		fprintf(stderr, "[ERROR] failed to create graphics pipeline %u\n", index);
+		exit(EXIT_FAILURE);
+	}
+
+	return pipeline;
+}
+
+void
+pipeline_builder_wait_all(Pipeline_Builder *builder)
+{
+	for (uint32_t i = 0; i < builder->n_pipelines; ++i) {
+		if (pipeline_builder_state(builder, i) == PIPELINE_RELEASED) continue;
+		pipeline_builder_wait(builder, i);
+		report_build(&builder->pipelines[i], i);
+	}
+}
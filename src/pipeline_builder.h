@@ -0,0 +1,119 @@
+#ifndef PIPELINE_BUILDER_H
+#define PIPELINE_BUILDER_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "shader.h"
+#include "thread_pool.h"
+
+#define PIPELINE_BUILDER_MAX_PIPELINES	32
+#define PIPELINE_BUILDER_MAX_BINDINGS	4
+#define PIPELINE_BUILDER_MAX_ATTRIBUTES	8
+#define PIPELINE_BUILDER_MAX_CONSTANTS	4
+
+// The state that differs between the graphics pipelines of a builder.
+typedef struct {
+	Shader *vert_shader;
+	Shader *frag_shader;
+
+	// Alpha blending over the existing contents of the color attachment.
+	bool blend;
+
+	// Writes to the depth attachment. The depth test is always on, but only
+	// opaque geometry should hide what's behind it.
+	bool depth_write;
+
+	VkCullModeFlags cull_mode;
+	VkPrimitiveTopology topology;
+
+	// This must match the sample count of the attachments the pipeline
+	// renders to.
+	VkSampleCountFlagBits samples;
+
+	// Specialization constants for both shader stages, where constants[i]
+	// is constant_id i. The driver folds them into the compiled shaders, so
+	// a branch on one costs nothing at runtime.
+	uint32_t n_constants;
+	uint32_t constants[PIPELINE_BUILDER_MAX_CONSTANTS];
+} Pipeline_Description;
+
+typedef enum {
+	PIPELINE_PENDING,
+	PIPELINE_READY,
+	PIPELINE_FAILED,
+
+	// The pipeline was destroyed, and its slot is free for another build.
+	PIPELINE_RELEASED,
+} Pipeline_State;
+
+typedef struct Pipeline_Builder Pipeline_Builder;
+
+typedef struct {
+	Pipeline_Builder *builder;
+	Pipeline_Description description;
+
+	// Written by the worker thread before the state leaves PIPELINE_PENDING,
+	// and guarded by the builder's mutex.
+	Pipeline_State state;
+	VkPipeline pipeline;
+	double build_ms;
+	bool by_identifier;
+} Pipeline_Build;
+
+// Compiles batches of graphics pipelines in parallel on a thread pool. All
+// pipelines share a layout, a render pass, a vertex input layout, and the
+// pipeline cache, which Vulkan synchronizes internally.
+struct Pipeline_Builder {
+	VkDevice device;
+	VkPipelineCache cache;
+	bool warm_cache;
+	VkPipelineLayout layout;
+	VkRenderPass render_pass;
+
+	// Without a render pass, pipelines are built for dynamic rendering to
+	// attachments of these formats instead.
+	VkFormat color_format;
+	VkFormat depth_format;
+
+	VkVertexInputBindingDescription bindings[PIPELINE_BUILDER_MAX_BINDINGS];
+	uint32_t n_bindings;
+	VkVertexInputAttributeDescription attributes[PIPELINE_BUILDER_MAX_ATTRIBUTES];
+	uint32_t n_attributes;
+
+	Thread_Pool *pool;
+
+	// Shader modules are created lazily, so workers that need one take turns.
+	Shader_Cache *shaders;
+	pthread_mutex_t shader_mutex;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t pipeline_finished;
+
+	uint32_t n_pipelines;
+	Pipeline_Build pipelines[PIPELINE_BUILDER_MAX_PIPELINES];
+};
+
+void pipeline_builder_init(Pipeline_Builder *builder, VkDevice device, VkPipelineCache cache, bool warm_cache,
+	VkPipelineLayout layout, VkRenderPass render_pass, const VkPipelineVertexInputStateCreateInfo *vertex_input,
+	Shader_Cache *shaders, Thread_Pool *pool);
+void pipeline_builder_destroy(Pipeline_Builder *builder);
+
+// Build pipelines for dynamic rendering instead of the render pass given to
+// pipeline_builder_init(), which should be VK_NULL_HANDLE. This must be
+// called before the first pipeline_builder_submit().
+void pipeline_builder_use_dynamic_rendering(Pipeline_Builder *builder, VkFormat color_format,
+	VkFormat depth_format);
+
+uint32_t pipeline_builder_submit(Pipeline_Builder *builder, const Pipeline_Description *description);
+VkPipeline pipeline_builder_get(Pipeline_Builder *builder, uint32_t index);
+Pipeline_State pipeline_builder_state(Pipeline_Builder *builder, uint32_t index);
+void pipeline_builder_release(Pipeline_Builder *builder, uint32_t index);
+bool pipeline_builder_uses_shader(Pipeline_Builder *builder, const Shader *shader);
+VkPipeline pipeline_builder_wait(Pipeline_Builder *builder, uint32_t index);
+void pipeline_builder_wait_all(Pipeline_Builder *builder);
+
+#endif
@@ -0,0 +1,104 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "file.h"
+#include "pipeline_cache.h"
+
+static bool
+is_compatible_cache(const Mapped_File *file, const VkPhysicalDeviceProperties *properties)
+{
+	// NOTE The header is read field by field rather than cast to a struct
+	// because the mapping makes no promises about alignment and the header
+	// layout is defined by the specification to be tightly packed.
+	const size_t header_length = 16 + VK_UUID_SIZE;
+	if (file->length < header_length) return false;
+
+	const unsigned char *p = file->contents;
+	uint32_t header_size = 0;
+	uint32_t header_version = 0;
+	uint32_t vendor_id = 0;
+	uint32_t device_id = 0;
+	memcpy(&header_size, p + 0, sizeof(uint32_t));
+	memcpy(&header_version, p + 4, sizeof(uint32_t));
+	memcpy(&vendor_id, p + 8, sizeof(uint32_t));
+	memcpy(&device_id, p + 12, sizeof(uint32_t));
+
+	if (header_size < header_length || header_size > file->length) return false;
+	if (header_version != VK_PIPELINE_CACHE_HEADER_VERSION_ONE) return false;
+	if (vendor_id != properties->vendorID) return false;
+	if (device_id != properties->deviceID) return false;
+	if (memcmp(p + 16, properties->pipelineCacheUUID, VK_UUID_SIZE) != 0) return false;
+
+	return true;
+}
+
+// Create the cache from a file that was mapped ahead of time, which is
+// unmapped here. An empty mapping means the file is missing, which just
+// makes this a cold start. A cache from another GPU or driver version is
+// discarded as well; drivers are required to reject incompatible data anyway,
+// but checking the header here avoids relying on every driver getting that
+// right.
+Pipeline_Cache
+pipeline_cache_create(VkDevice device, const VkPhysicalDeviceProperties *properties, Mapped_File *file,
+	const char *filename)
+{
+	Pipeline_Cache cache = {0};
+
+	if (file->contents) {
+		if (is_compatible_cache(file, properties)) {
+			cache.warm = true;
+		} else {
+			fprintf(stderr, "[WARNING] ignoring incompatible pipeline cache %s\n", filename);
+		}
+	}
+
+	VkPipelineCacheCreateInfo cache_info = {
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+		.initialDataSize = cache.warm ? file->length : 0,
+		.pInitialData = cache.warm ? file->contents : NULL,
+	};
+	if (vkCreatePipelineCache(device, &cache_info, NULL, &cache.handle) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create pipeline cache\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// The driver copies the initial data, so the file is no longer needed.
+	unmap_file(file);
+	return cache;
+}
+
+void
+pipeline_cache_store(VkDevice device, Pipeline_Cache cache, const char *filename)
+{
+	size_t length = 0;
+	if (vkGetPipelineCacheData(device, cache.handle, &length, NULL) != VK_SUCCESS || length == 0) {
+		fprintf(stderr, "[WARNING] failed to query size of pipeline cache\n");
+		return;
+	}
+
+	// NOTE The cache may be several megabytes, far more than the global arena
+	// holds, and it's only needed for the duration of this call.
+	void *contents = malloc(length);
+	if (!contents) {
+		fprintf(stderr, "[WARNING] failed to allocate memory for pipeline cache\n");
+		return;
+	}
+
+	if (vkGetPipelineCacheData(device, cache.handle, &length, contents) != VK_SUCCESS) {
+		fprintf(stderr, "[WARNING] failed to retrieve pipeline cache data\n");
+	} else if (!write_file_atomic(filename, contents, length)) {
+		fprintf(stderr, "[WARNING] failed to write pipeline cache %s\n", filename);
+	}
+
+	free(contents);
+}
+
+void
+pipeline_cache_destroy(VkDevice device, Pipeline_Cache cache)
+{
+	vkDestroyPipelineCache(device, cache.handle, NULL);
+}
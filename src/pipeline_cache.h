@@ -0,0 +1,22 @@
+#ifndef PIPELINE_CACHE_H
+#define PIPELINE_CACHE_H
+
+#include <stdbool.h>
+
+#include <vulkan/vulkan.h>
+
+#include "file.h"
+
+typedef struct {
+	VkPipelineCache handle;
+
+	// True if the cache was seeded with data from a previous run.
+	bool warm;
+} Pipeline_Cache;
+
+Pipeline_Cache pipeline_cache_create(VkDevice device, const VkPhysicalDeviceProperties *properties,
+	Mapped_File *file, const char *filename);
+void pipeline_cache_store(VkDevice device, Pipeline_Cache cache, const char *filename);
+void pipeline_cache_destroy(VkDevice device, Pipeline_Cache cache);
+
+#endif
@@ -0,0 +1,294 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "debug.h"
+#include "pipeline_builder.h"
+#include "pipeline_variants.h"
+#include "shader.h"
+
+#define KEY_BLEND_SHIFT		0
+#define KEY_BLEND_MASK		0x1u
+#define KEY_CULL_SHIFT		1
+#define KEY_CULL_MASK		0x3u
+#define KEY_TOPOLOGY_SHIFT	3
+#define KEY_TOPOLOGY_MASK	0xfu
+#define KEY_SAMPLES_SHIFT	7
+#define KEY_SAMPLES_MASK	0x7u
+
+// The constant_id of each specialization constant the shaders declare.
+enum {
+	CONSTANT_TRANSLUCENT,
+	N_CONSTANTS,
+};
+
+Pipeline_Key
+pipeline_key(Blend_Mode blend, VkCullModeFlags cull_mode, VkPrimitiveTopology topology, VkSampleCountFlagBits samples)
+{
+	assert((uint32_t)blend <= KEY_BLEND_MASK);
+	assert(cull_mode <= KEY_CULL_MASK);
+	assert((uint32_t)topology <= KEY_TOPOLOGY_MASK);
+	assert(samples != 0 && (samples & (samples - 1)) == 0);
+
+	uint32_t log2_samples = 0;
+	while ((1u << log2_samples) < (uint32_t)samples) ++log2_samples;
+	assert(log2_samples <= KEY_SAMPLES_MASK);
+
+	return (uint32_t)blend << KEY_BLEND_SHIFT |
+		cull_mode << KEY_CULL_SHIFT |
+		(uint32_t)topology << KEY_TOPOLOGY_SHIFT |
+		log2_samples << KEY_SAMPLES_SHIFT;
+}
+
+Blend_Mode
+pipeline_key_blend(Pipeline_Key key)
+{
+	return (Blend_Mode)(key >> KEY_BLEND_SHIFT & KEY_BLEND_MASK);
+}
+
+VkCullModeFlags
+pipeline_key_cull_mode(Pipeline_Key key)
+{
+	return key >> KEY_CULL_SHIFT & KEY_CULL_MASK;
+}
+
+VkPrimitiveTopology
+pipeline_key_topology(Pipeline_Key key)
+{
+	return (VkPrimitiveTopology)(key >> KEY_TOPOLOGY_SHIFT & KEY_TOPOLOGY_MASK);
+}
+
+VkSampleCountFlagBits
+pipeline_key_samples(Pipeline_Key key)
+{
+	return (VkSampleCountFlagBits)(1u << (key >> KEY_SAMPLES_SHIFT & KEY_SAMPLES_MASK));
+}
+
+void
+pipeline_variants_init(Pipeline_Variants *variants, Pipeline_Builder *builder, Shader *vert_shader,
+	Shader *frag_shader)
+{
+	memset(variants, 0, sizeof(Pipeline_Variants));
+	variants->builder = builder;
+	variants->vert_shader = vert_shader;
+	variants->frag_shader = frag_shader;
+}
+
+// Find the key's slot, or the empty slot where it belongs, probing linearly.
+// Multiplying by 2^32 / phi spreads keys that differ only in a few low bits
+// over the whole table.
+static Pipeline_Variant *
+find_slot(Pipeline_Variants *variants, Pipeline_Key key)
+{
+	uint32_t mask = PIPELINE_VARIANTS_CAPACITY - 1;
+	uint32_t slot = (uint32_t)(key * 2654435769u) >> 16 & mask;
+	for (;;) {
+		Pipeline_Variant *variant = &variants->table[slot];
+		if (!variant->used || variant->key == key) return variant;
+		slot = (slot + 1) & mask;
+	}
+}
+
+// Everything but the shaders follows from the key: opaque variants write
+// depth and leave blending off, and the shaders are specialized to match.
+static Pipeline_Description
+describe_variant(const Pipeline_Variants *variants, Pipeline_Key key)
+{
+	bool translucent = pipeline_key_blend(key) == BLEND_ALPHA;
+	return (Pipeline_Description){
+		.vert_shader = variants->vert_shader,
+		.frag_shader = variants->frag_shader,
+		.blend = translucent,
+		.depth_write = !translucent,
+		.cull_mode = pipeline_key_cull_mode(key),
+		.topology = pipeline_key_topology(key),
+		.samples = pipeline_key_samples(key),
+		.n_constants = N_CONSTANTS,
+		.constants = {
+			[CONSTANT_TRANSLUCENT] = translucent ? VK_TRUE : VK_FALSE,
+		},
+	};
+}
+
+// Queue the variant on the builder, unless it's already been requested.
+// Variants are built in the order they're requested.
+void
+pipeline_variants_request(Pipeline_Variants *variants, Pipeline_Key key)
+{
+	Pipeline_Variant *variant = find_slot(variants, key);
+	if (variant->used) return;
+
+	// The builder runs out of room well before the table fills up.
+	assert(variants->n_variants < PIPELINE_VARIANTS_CAPACITY / 2);
+
+	Pipeline_Description description = describe_variant(variants, key);
+	*variant = (Pipeline_Variant){
+		.key = key,
+		.used = true,
+		.build = pipeline_builder_submit(variants->builder, &description),
+	};
+	++variants->n_variants;
+}
+
+// Return the variant's pipeline, blocking until it's compiled if it hasn't
+// been yet. A variant that was never requested is requested on the spot,
+// which is a stall worth knowing about.
+VkPipeline
+pipeline_variants_get(Pipeline_Variants *variants, Pipeline_Key key)
+{
+	Pipeline_Variant *variant = find_slot(variants, key);
+	if (variant->pipeline) return variant->pipeline;
+
+	if (!variant->used) {
+		fprintf(stderr, "[WARNING] pipeline variant 0x%03x wasn't requested ahead of use\n", key);
+		pipeline_variants_request(variants, key);
+	}
+
+	variant->pipeline = pipeline_builder_wait(variants->builder, variant->build);
+	return variant->pipeline;
+}
+
+static void
+retire(Pipeline_Variants *variants, uint32_t build, uint64_t frame)
+{
+	assert(variants->n_retired < PIPELINE_BUILDER_MAX_PIPELINES);
+	variants->retired[variants->n_retired++] = (Retired_Pipeline){
+		.build = build,
+		.frame = frame,
+	};
+}
+
+// Queue a replaced shader for eviction, unless it already is. Reverting an
+// edit can bring it back as the current shader, which keeps it cached.
+static void
+supersede(Pipeline_Variants *variants, Shader *shader)
+{
+	for (uint32_t i = 0; i < variants->n_superseded; ++i) {
+		if (variants->superseded[i] == shader) return;
+	}
+	assert(variants->n_superseded < SHADER_CACHE_CAPACITY);
+	variants->superseded[variants->n_superseded++] = shader;
+}
+
+// Evict the replaced shaders that neither the variants nor any pipeline
+// still refer to.
+static void
+evict_superseded(Pipeline_Variants *variants)
+{
+	Pipeline_Builder *builder = variants->builder;
+
+	uint32_t n_kept = 0;
+	for (uint32_t i = 0; i < variants->n_superseded; ++i) {
+		Shader *shader = variants->superseded[i];
+		if (shader == variants->vert_shader || shader == variants->frag_shader ||
+				pipeline_builder_uses_shader(builder, shader)) {
+			variants->superseded[n_kept++] = shader;
+			continue;
+		}
+
+		// The pipeline workers create modules in the cache as they go.
+		pthread_mutex_lock(&builder->shader_mutex);
+		shader_cache_remove(builder->shaders, shader);
+		pthread_mutex_unlock(&builder->shader_mutex);
+	}
+	variants->n_superseded = n_kept;
+}
+
+// Load the recompiled code of a graphics stage, and rebuild every variant
+// with it in the background. Nothing here waits on a compilation.
+void
+pipeline_variants_reload(Pipeline_Variants *variants, Shader_Cache *cache, VkShaderStageFlagBits stage,
+	const char *filename)
+{
+	assert(stage == VK_SHADER_STAGE_VERTEX_BIT || stage == VK_SHADER_STAGE_FRAGMENT_BIT);
+	Shader **current = stage == VK_SHADER_STAGE_VERTEX_BIT ? &variants->vert_shader : &variants->frag_shader;
+
+	// Shaders that were replaced stay loaded until the pipelines that refer
+	// to them are destroyed, so reloads faster than the frames in flight
+	// retire them can still fill the cache.
+	if (cache->n_shaders == SHADER_CACHE_CAPACITY) {
+		fprintf(stderr, "[WARNING] shader cache is full, restart to reload %s\n", filename);
+		return;
+	}
+
+	// The pipeline workers create modules in the cache as they go.
+	pthread_mutex_lock(&variants->builder->shader_mutex);
+	Shader *shader = shader_cache_load(cache, filename);
+	pthread_mutex_unlock(&variants->builder->shader_mutex);
+
+	// The cache is keyed by code, so an edit that compiles to the same SPIR-V
+	// finds the shader in use.
+	if (shader == *current) {
+		printf("[INFO] %s is unchanged\n", filename);
+		return;
+	}
+	supersede(variants, *current);
+	*current = shader;
+
+	for (uint32_t i = 0; i < PIPELINE_VARIANTS_CAPACITY; ++i) {
+		Pipeline_Variant *variant = &variants->table[i];
+		if (!variant->used) continue;
+
+		// A rebuild that an even newer one supersedes was never drawn with.
+		if (variant->rebuilding) {
+			retire(variants, variant->rebuild, 0);
+		} else {
+			++variants->n_rebuilding;
+		}
+
+		Pipeline_Description description = describe_variant(variants, variant->key);
+		variant->rebuild = pipeline_builder_submit(variants->builder, &description);
+		variant->rebuilding = true;
+	}
+	printf("[INFO] reloaded %s, rebuilding %u pipeline variants\n", filename, variants->n_variants);
+}
+
+// Swap in the rebuilds that are ready, and destroy the pipelines no frame in
+// flight uses anymore. It's called at the start of `frame`, once the frame
+// that last used its resources is complete; at that point, the frames before
+// `frame - n_frames_in_flight` are complete too.
+void
+pipeline_variants_update(Pipeline_Variants *variants, uint64_t frame, uint32_t n_frames_in_flight)
+{
+	if (variants->n_rebuilding == 0 && variants->n_retired == 0 && variants->n_superseded == 0) return;
+
+	uint32_t n_kept = 0;
+	for (uint32_t i = 0; i < variants->n_retired; ++i) {
+		Retired_Pipeline retired = variants->retired[i];
+		if (retired.frame + n_frames_in_flight <= frame &&
+				pipeline_builder_state(variants->builder, retired.build) != PIPELINE_PENDING) {
+			pipeline_builder_release(variants->builder, retired.build);
+		} else {
+			variants->retired[n_kept++] = retired;
+		}
+	}
+	variants->n_retired = n_kept;
+
+	for (uint32_t i = 0; i < PIPELINE_VARIANTS_CAPACITY && variants->n_rebuilding > 0; ++i) {
+		Pipeline_Variant *variant = &variants->table[i];
+		if (!variant->used || !variant->rebuilding) continue;
+
+		Pipeline_State state = pipeline_builder_state(variants->builder, variant->rebuild);
+		if (state == PIPELINE_PENDING) continue;
+
+		if (state == PIPELINE_READY) {
+			retire(variants, variant->build, frame);
+			variant->build = variant->rebuild;
+			variant->pipeline = pipeline_builder_get(variants->builder, variant->rebuild);
+		} else {
+			// Unlike at startup, a broken shader isn't fatal; the variant keeps
+			// drawing with the pipeline it has.
+			fprintf(stderr, "[WARNING] failed to rebuild pipeline variant 0x%03x\n", variant->key);
+			retire(variants, variant->rebuild, 0);
+		}
+		variant->rebuilding = false;
+		--variants->n_rebuilding;
+	}
+
+	evict_superseded(variants);
+}
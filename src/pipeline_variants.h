@@ -0,0 +1,102 @@
+#ifndef PIPELINE_VARIANTS_H
+#define PIPELINE_VARIANTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "pipeline_builder.h"
+#include "shader.h"
+
+// Must be a power of two. Twice the builder's capacity keeps the table at
+// most half full, so lookups rarely probe past their first slot.
+#define PIPELINE_VARIANTS_CAPACITY	64
+
+typedef enum {
+	// No blending, and depth writes. The fragment shader writes alpha 1.
+	BLEND_OPAQUE,
+
+	// Alpha blending over the color attachment, without depth writes. The
+	// fragment shader writes the alpha of the draw's tint.
+	BLEND_ALPHA,
+} Blend_Mode;
+
+// Everything a variant of the triangle pipeline varies in, packed into the
+// low 10 bits:
+//
+//	bit  0		blend mode
+//	bits 1-2	cull mode
+//	bits 3-6	primitive topology
+//	bits 7-9	log2 of the sample count
+//
+// Two descriptions of the same pipeline always pack to the same key, so it
+// doubles as the variant's identity in the table.
+typedef uint32_t Pipeline_Key;
+
+Pipeline_Key pipeline_key(Blend_Mode blend, VkCullModeFlags cull_mode, VkPrimitiveTopology topology,
+	VkSampleCountFlagBits samples);
+Blend_Mode pipeline_key_blend(Pipeline_Key key);
+VkCullModeFlags pipeline_key_cull_mode(Pipeline_Key key);
+VkPrimitiveTopology pipeline_key_topology(Pipeline_Key key);
+VkSampleCountFlagBits pipeline_key_samples(Pipeline_Key key);
+
+typedef struct {
+	Pipeline_Key key;
+	bool used;
+
+	// The variant's index in the builder, and the pipeline once it's been
+	// waited on, so later lookups skip the builder's lock.
+	uint32_t build;
+	VkPipeline pipeline;
+
+	// A rebuild with reloaded shaders, swapped in once it's compiled.
+	bool rebuilding;
+	uint32_t rebuild;
+} Pipeline_Variant;
+
+// A pipeline swapped out at the start of `frame`, which the frames in flight
+// before it may still use.
+typedef struct {
+	uint32_t build;
+	uint64_t frame;
+} Retired_Pipeline;
+
+// An open-addressing hash table from keys to the pipelines built for them.
+// Variants are requested up front, which fills in their create info once and
+// queues them on the builder; after that, looking one up is a hash and a
+// compare. It's not thread-safe: only the thread that renders touches it.
+//
+// Reloading a shader rebuilds the variants that use it in the background,
+// while the old pipelines keep drawing. Each rebuild is swapped in between
+// frames once it's ready, and the pipeline it replaces is destroyed once no
+// frame in flight can use it. The shader the reload replaced is evicted from
+// the cache once the last pipeline built with it is destroyed.
+typedef struct {
+	Pipeline_Builder *builder;
+	Shader *vert_shader;
+	Shader *frag_shader;
+
+	uint32_t n_variants;
+	Pipeline_Variant table[PIPELINE_VARIANTS_CAPACITY];
+
+	uint32_t n_rebuilding;
+	uint32_t n_retired;
+	Retired_Pipeline retired[PIPELINE_BUILDER_MAX_PIPELINES];
+
+	// Shaders that reloads replaced, which stay cached while pipelines still
+	// refer to them.
+	uint32_t n_superseded;
+	Shader *superseded[SHADER_CACHE_CAPACITY];
+} Pipeline_Variants;
+
+void pipeline_variants_init(Pipeline_Variants *variants, Pipeline_Builder *builder, Shader *vert_shader,
+	Shader *frag_shader);
+void pipeline_variants_request(Pipeline_Variants *variants, Pipeline_Key key);
+VkPipeline pipeline_variants_get(Pipeline_Variants *variants, Pipeline_Key key);
+
+void pipeline_variants_reload(Pipeline_Variants *variants, Shader_Cache *cache, VkShaderStageFlagBits stage,
+	const char *filename);
+void pipeline_variants_update(Pipeline_Variants *variants, uint64_t frame, uint32_t n_frames_in_flight);
+
+#endif
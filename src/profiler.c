@@ -0,0 +1,198 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "profiler.h"
+#include "timer.h"
+#include "util.h"
+
+// Every scope may be timed at most once per frame, with two timestamps.
+#define PROFILER_MAX_QUERIES	(2 * PROFILER_MAX_SCOPES)
+
+void
+profiler_create(Profiler *profiler, VkDevice device, const VkPhysicalDeviceLimits *limits,
+	uint32_t timestamp_valid_bits, uint32_t n_frames, Arena *arena)
+{
+	memset(profiler, 0, sizeof(Profiler));
+	profiler->device = device;
+	profiler->n_frames = n_frames;
+	profiler->gpu_enabled = timestamp_valid_bits > 0;
+	profiler->timestamp_period = limits->timestampPeriod;
+	profiler->timestamp_mask = timestamp_valid_bits >= 64 ? UINT64_MAX : (UINT64_C(1) << timestamp_valid_bits) - 1;
+
+	if (!profiler->gpu_enabled) {
+		fprintf(stderr, "[WARNING] the graphics queue doesn't support timestamps, profiling the CPU only\n");
+		return;
+	}
+
+	profiler->query_pools = arena_alloc(arena, n_frames * sizeof(VkQueryPool));
+	profiler->frame_scopes = arena_alloc(arena, n_frames * PROFILER_MAX_SCOPES * sizeof(uint32_t));
+	profiler->n_frame_queries = arena_alloc(arena, n_frames * sizeof(uint32_t));
+	profiler->frame_pending = arena_alloc(arena, n_frames * sizeof(bool));
+	assert(profiler->query_pools && profiler->frame_scopes && profiler->n_frame_queries && profiler->frame_pending);
+
+	for (uint32_t i = 0; i < n_frames; ++i) {
+		VkQueryPoolCreateInfo pool_info = {
+			.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+			.queryType = VK_QUERY_TYPE_TIMESTAMP,
+			.queryCount = PROFILER_MAX_QUERIES,
+		};
+		if (vkCreateQueryPool(device, &pool_info, NULL, &profiler->query_pools[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create timestamp query pool\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void
+profiler_destroy(Profiler *profiler)
+{
+	if (!profiler->gpu_enabled) return;
+
+	for (uint32_t i = 0; i < profiler->n_frames; ++i) {
+		vkDestroyQueryPool(profiler->device, profiler->query_pools[i], NULL);
+	}
+}
+
+static uint32_t
+find_scope(Profiler *profiler, const char *name, bool gpu)
+{
+	for (uint32_t i = 0; i < profiler->n_scopes; ++i) {
+		Profiler_Scope *scope = &profiler->scopes[i];
+		if (scope->gpu == gpu && strcmp(scope->name, name) == 0) return i;
+	}
+
+	if (profiler->n_scopes == PROFILER_MAX_SCOPES) {
+		fprintf(stderr, "[ERROR] too many profiler scopes\n");
+		exit(EXIT_FAILURE);
+	}
+
+	uint32_t index = profiler->n_scopes++;
+	profiler->scopes[index] = (Profiler_Scope){
+		.name = name,
+		.gpu = gpu,
+	};
+	return index;
+}
+
+static void
+add_sample(Profiler_Scope *scope, double ms)
+{
+	scope->history[scope->n_samples % PROFILER_HISTORY_LENGTH] = (float)ms;
+	++scope->n_samples;
+}
+
+void
+profiler_begin_frame(Profiler *profiler, uint32_t frame, VkCommandBuffer command_buffer)
+{
+	if (!profiler->gpu_enabled) return;
+	assert(frame < profiler->n_frames);
+
+	uint32_t n_queries = profiler->n_frame_queries[frame];
+	if (profiler->frame_pending[frame] && n_queries > 0) {
+		// NOTE Without VK_QUERY_RESULT_WAIT_BIT, this returns VK_NOT_READY
+		// instead of blocking, which never happens once the frame's
+		// submission is complete.
+		uint64_t timestamps[PROFILER_MAX_QUERIES] = {0};
+		VkResult result = vkGetQueryPoolResults(profiler->device, profiler->query_pools[frame], 0, n_queries,
+			sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+		if (result == VK_SUCCESS) {
+			const uint32_t *scopes = &profiler->frame_scopes[frame * PROFILER_MAX_SCOPES];
+			for (uint32_t i = 0; i < n_queries / 2; ++i) {
+				uint64_t ticks = (timestamps[2 * i + 1] - timestamps[2 * i]) & profiler->timestamp_mask;
+				add_sample(&profiler->scopes[scopes[i]], ticks * profiler->timestamp_period / 1e6);
+			}
+		}
+	}
+
+	vkCmdResetQueryPool(command_buffer, profiler->query_pools[frame], 0, PROFILER_MAX_QUERIES);
+	profiler->n_frame_queries[frame] = 0;
+	profiler->frame_pending[frame] = true;
+}
+
+uint32_t
+profiler_gpu_begin(Profiler *profiler, uint32_t frame, VkCommandBuffer command_buffer, const char *name)
+{
+	if (!profiler->gpu_enabled) return 0;
+	assert(frame < profiler->n_frames);
+
+	uint32_t query = profiler->n_frame_queries[frame];
+	if (query == PROFILER_MAX_QUERIES) {
+		fprintf(stderr, "[ERROR] too many profiler scopes in a single frame\n");
+		exit(EXIT_FAILURE);
+	}
+	profiler->frame_scopes[frame * PROFILER_MAX_SCOPES + query / 2] = find_scope(profiler, name, true);
+	profiler->n_frame_queries[frame] += 2;
+
+	// The earliest stage is written once all prior commands have begun.
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, profiler->query_pools[frame], query);
+	return query;
+}
+
+void
+profiler_gpu_end(Profiler *profiler, uint32_t frame, VkCommandBuffer command_buffer, uint32_t query)
+{
+	if (!profiler->gpu_enabled) return;
+	assert(frame < profiler->n_frames);
+
+	// The last stage is written once all prior commands have completed.
+	vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, profiler->query_pools[frame],
+		query + 1);
+}
+
+void
+profiler_cpu_scope(Profiler *profiler, const char *name, uint64_t start, uint64_t end)
+{
+	add_sample(&profiler->scopes[find_scope(profiler, name, false)], timer_elapsed_ms(start, end));
+}
+
+static int
+compare_floats(const void *a, const void *b)
+{
+	float x = *(const float *)a;
+	float y = *(const float *)b;
+	return (x > y) - (x < y);
+}
+
+bool
+profiler_scope_stats(const Profiler_Scope *scope, Profiler_Stats *stats)
+{
+	uint32_t n = MIN(scope->n_samples, PROFILER_HISTORY_LENGTH);
+	if (n == 0) return false;
+
+	float sorted[PROFILER_HISTORY_LENGTH];
+	memcpy(sorted, scope->history, n * sizeof(float));
+	qsort(sorted, n, sizeof(float), compare_floats);
+
+	double sum = 0.0;
+	for (uint32_t i = 0; i < n; ++i) sum += sorted[i];
+
+	// The nearest-rank percentile.
+	uint32_t p99 = (99 * n + 99) / 100;
+	*stats = (Profiler_Stats){
+		.min_ms = sorted[0],
+		.avg_ms = sum / n,
+		.p99_ms = sorted[p99 - 1],
+	};
+	return true;
+}
+
+void
+profiler_print(const Profiler *profiler)
+{
+	for (uint32_t i = 0; i < profiler->n_scopes; ++i) {
+		const Profiler_Scope *scope = &profiler->scopes[i];
+
+		Profiler_Stats stats = {0};
+		if (!profiler_scope_stats(scope, &stats)) continue;
+
+		printf("[INFO] %s %-12s min %7.3f ms  avg %7.3f ms  p99 %7.3f ms\n", scope->gpu ? "gpu" : "cpu",
+			scope->name, stats.min_ms, stats.avg_ms, stats.p99_ms);
+	}
+}
@@ -0,0 +1,81 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+
+#define PROFILER_MAX_SCOPES	16
+
+// Number of most recent samples that the statistics of a scope cover.
+#define PROFILER_HISTORY_LENGTH	256
+
+// A named span of time on either the CPU or the GPU timeline, e.g. a pass.
+typedef struct {
+	const char *name;
+	bool gpu;
+
+	// A ring of the latest durations in milliseconds.
+	float history[PROFILER_HISTORY_LENGTH];
+	uint32_t n_samples;
+} Profiler_Scope;
+
+typedef struct {
+	double min_ms;
+	double avg_ms;
+	double p99_ms;
+} Profiler_Stats;
+
+// Times GPU work with timestamp queries and CPU work with the host clock.
+//
+// Every frame in flight owns a query pool. Its timestamps are read back only
+// once the frame's previous submission is known to be complete, at the start
+// of the frame, so the readback never waits on the GPU.
+typedef struct {
+	VkDevice device;
+	uint32_t n_frames;
+
+	// GPU timing requires timestamp support on the graphics queue.
+	bool gpu_enabled;
+	double timestamp_period;
+	uint64_t timestamp_mask;
+
+	VkQueryPool *query_pools;
+
+	// The scope of every pair of timestamps that each frame wrote, and
+	// whether the frame has results that are yet to be read back.
+	uint32_t *frame_scopes;
+	uint32_t *n_frame_queries;
+	bool *frame_pending;
+
+	uint32_t n_scopes;
+	Profiler_Scope scopes[PROFILER_MAX_SCOPES];
+} Profiler;
+
+// Create a profiler for `n_frames` frames in flight. GPU timing is disabled
+// if the graphics queue family has no valid timestamp bits. The arrays are
+// allocated from `arena`.
+void profiler_create(Profiler *profiler, VkDevice device, const VkPhysicalDeviceLimits *limits,
+	uint32_t timestamp_valid_bits, uint32_t n_frames, Arena *arena);
+void profiler_destroy(Profiler *profiler);
+
+// Read back the frame's previous timestamps, and reset its query pool. This
+// must be recorded outside of a render pass before any other profiler command
+// of the frame, and the frame's previous submission must be complete.
+void profiler_begin_frame(Profiler *profiler, uint32_t frame, VkCommandBuffer command_buffer);
+
+// Write timestamps around GPU work. The value returned by the former is
+// passed to the latter.
+uint32_t profiler_gpu_begin(Profiler *profiler, uint32_t frame, VkCommandBuffer command_buffer, const char *name);
+void profiler_gpu_end(Profiler *profiler, uint32_t frame, VkCommandBuffer command_buffer, uint32_t query);
+
+// Record a span of CPU time measured with timer_now().
+void profiler_cpu_scope(Profiler *profiler, const char *name, uint64_t start, uint64_t end);
+
+bool profiler_scope_stats(const Profiler_Scope *scope, Profiler_Stats *stats);
+void profiler_print(const Profiler *profiler);
+
+#endif
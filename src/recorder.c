@@ -0,0 +1,152 @@
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "frame_context.h"
+#include "recorder.h"
+#include "thread_pool.h"
+#include "timer.h"
+
+void
+recorder_create(Recorder *recorder, VkDevice device, uint32_t queue_family, Thread_Pool *pool,
+	uint32_t n_frames, Arena *arena)
+{
+	*recorder = (Recorder){
+		.device = device,
+		.pool = pool,
+		.n_frames = n_frames,
+		.n_slices = pool->n_threads,
+	};
+
+	recorder->slices = arena_alloc(arena, recorder->n_slices * sizeof(Recorder_Slice));
+	assert(recorder->slices);
+
+	for (uint32_t i = 0; i < recorder->n_slices; ++i) {
+		Recorder_Slice *slice = &recorder->slices[i];
+		slice->recorder = recorder;
+		slice->frames = arena_alloc(arena, n_frames * sizeof(Frame_Context));
+		slice->command_buffers = arena_alloc(arena, n_frames * sizeof(VkCommandBuffer));
+		assert(slice->frames && slice->command_buffers);
+
+		for (uint32_t frame = 0; frame < n_frames; ++frame) {
+			frame_context_create(&slice->frames[frame], device, queue_family, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+		}
+	}
+}
+
+void
+recorder_destroy(Recorder *recorder)
+{
+	for (uint32_t i = 0; i < recorder->n_slices; ++i) {
+		for (uint32_t frame = 0; frame < recorder->n_frames; ++frame) {
+			frame_context_destroy(&recorder->slices[i].frames[frame]);
+		}
+	}
+}
+
+// Record a single slice. This runs on a worker thread.
+static void
+record_slice(void *argument)
+{
+	Recorder_Slice *slice = argument;
+	Recorder *recorder = slice->recorder;
+	uint32_t frame = recorder->frame;
+
+	uint64_t start = timer_now();
+
+	frame_context_reset(&slice->frames[frame]);
+	VkCommandBuffer command_buffer = frame_context_allocate(&slice->frames[frame]);
+	slice->command_buffers[frame] = command_buffer;
+
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT,
+		.pInheritanceInfo = &recorder->inheritance,
+	};
+	if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to begin recording secondary command buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	recorder->record(command_buffer, slice->first_draw, slice->n_draws, recorder->context);
+
+	if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to record secondary command buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// NOTE Only this slice's job writes its statistics, and the main thread
+	// reads them after waiting for the pool to go idle.
+	slice->recording_ns += timer_now() - start;
+	slice->n_draws_recorded += slice->n_draws;
+}
+
+void
+recorder_record(Recorder *recorder, uint32_t frame, const VkCommandBufferInheritanceInfo *inheritance,
+	uint32_t n_draws, Record_Function record, void *context)
+{
+	assert(frame < recorder->n_frames);
+
+	uint64_t start = timer_now();
+
+	recorder->frame = frame;
+	recorder->inheritance = *inheritance;
+	recorder->record = record;
+	recorder->context = context;
+
+	// Split the draw list into contiguous slices whose sizes differ by at most
+	// one draw.
+	uint32_t first_draw = 0;
+	for (uint32_t i = 0; i < recorder->n_slices; ++i) {
+		Recorder_Slice *slice = &recorder->slices[i];
+		slice->first_draw = first_draw;
+		slice->n_draws = n_draws / recorder->n_slices + (i < n_draws % recorder->n_slices ? 1 : 0);
+		first_draw += slice->n_draws;
+
+		thread_pool_submit(recorder->pool, record_slice, slice);
+	}
+	assert(first_draw == n_draws);
+
+	thread_pool_wait_idle(recorder->pool);
+
+	recorder->recording_ns += timer_now() - start;
+	++recorder->n_frames_recorded;
+}
+
+void
+recorder_execute(Recorder *recorder, uint32_t frame, VkCommandBuffer primary)
+{
+	assert(frame < recorder->n_frames);
+
+	VkCommandBuffer command_buffers[THREAD_POOL_MAX_THREADS] = {0};
+	for (uint32_t i = 0; i < recorder->n_slices; ++i) {
+		command_buffers[i] = recorder->slices[i].command_buffers[frame];
+	}
+	vkCmdExecuteCommands(primary, recorder->n_slices, command_buffers);
+}
+
+void
+recorder_print_stats(const Recorder *recorder)
+{
+	if (recorder->n_frames_recorded == 0) return;
+
+	double n_frames = (double)recorder->n_frames_recorded;
+	printf("[INFO] recorded %" PRIu64 " frames in %u slices, %.3f ms per frame\n",
+		recorder->n_frames_recorded, recorder->n_slices, recorder->recording_ns / 1e6 / n_frames);
+
+	// A slice's share of the wall time shows how evenly the work spreads, and
+	// its time per draw how much it slows down as the workers contend. Slices
+	// aren't pinned to workers, so a worker may record more than one.
+	for (uint32_t i = 0; i < recorder->n_slices; ++i) {
+		const Recorder_Slice *slice = &recorder->slices[i];
+		double per_draw_us = slice->n_draws_recorded ? slice->recording_ns / 1e3 / slice->n_draws_recorded : 0.0;
+		printf("[INFO]   slice %u: %.3f ms per frame, %.3f us per draw, %.1f%% of the wall time\n", i,
+			slice->recording_ns / 1e6 / n_frames, per_draw_us,
+			recorder->recording_ns ? 100.0 * slice->recording_ns / recorder->recording_ns : 0.0);
+	}
+}
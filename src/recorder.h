@@ -0,0 +1,81 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "frame_context.h"
+#include "thread_pool.h"
+
+// Record draws [first_draw, first_draw + n_draws) of the draw list into a
+// command buffer. All bound state must be set by the function itself since
+// secondary command buffers don't inherit any from the primary.
+typedef void (*Record_Function)(VkCommandBuffer command_buffer, uint32_t first_draw, uint32_t n_draws,
+	void *context);
+
+typedef struct Recorder Recorder;
+
+// A contiguous slice of the draw list, recorded by a single job. Every slice
+// owns a frame context per frame in flight, so no two threads ever touch the
+// same command pool and the pools need no locking.
+typedef struct {
+	Recorder *recorder;
+
+	Frame_Context *frames;
+
+	// The secondary command buffer recorded for each frame.
+	VkCommandBuffer *command_buffers;
+
+	uint32_t first_draw;
+	uint32_t n_draws;
+
+	// Time spent recording, summed over every frame.
+	uint64_t recording_ns;
+	uint64_t n_draws_recorded;
+} Recorder_Slice;
+
+// Records a draw list into secondary command buffers, one per slice, in
+// parallel on a thread pool. The primary command buffer then executes them
+// within its render pass.
+struct Recorder {
+	VkDevice device;
+	Thread_Pool *pool;
+	uint32_t n_frames;
+
+	uint32_t n_slices;
+	Recorder_Slice *slices;
+
+	// The frame being recorded, and what to record into it.
+	uint32_t frame;
+	VkCommandBufferInheritanceInfo inheritance;
+	Record_Function record;
+	void *context;
+
+	// Wall time of recording all slices, summed over every frame.
+	uint64_t recording_ns;
+	uint64_t n_frames_recorded;
+};
+
+// Create a recorder with one slice per worker thread of `pool`. The slices and
+// their arrays are allocated from `arena`.
+void recorder_create(Recorder *recorder, VkDevice device, uint32_t queue_family, Thread_Pool *pool,
+	uint32_t n_frames, Arena *arena);
+void recorder_destroy(Recorder *recorder);
+
+// Record `n_draws` draws for the frame in the render pass described by
+// `inheritance`, or in the dynamic rendering described by a
+// VkCommandBufferInheritanceRenderingInfo chained onto it. This blocks until
+// every slice is recorded. The frame's previous command buffers must no longer
+// be in use by the GPU.
+void recorder_record(Recorder *recorder, uint32_t frame, const VkCommandBufferInheritanceInfo *inheritance,
+	uint32_t n_draws, Record_Function record, void *context);
+
+// Execute the frame's secondary command buffers from a primary command buffer
+// within a render pass begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS.
+void recorder_execute(Recorder *recorder, uint32_t frame, VkCommandBuffer primary);
+
+void recorder_print_stats(const Recorder *recorder);
+
+#endif
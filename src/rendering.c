@@ -0,0 +1,170 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "attachments.h"
+#include "rendering.h"
+
+const char *
+rendering_backend_name(Rendering_Backend backend)
+{
+	switch (backend) {
+	case RENDERING_BACKEND_RENDER_PASS: return "render-pass";
+	case RENDERING_BACKEND_DYNAMIC: return "dynamic";
+	default: return "auto";
+	}
+}
+
+void
+dynamic_rendering_load(Dynamic_Rendering *rendering, VkDevice device, bool core)
+{
+	*rendering = (Dynamic_Rendering){
+		.begin_rendering = (PFN_vkCmdBeginRendering)
+			vkGetDeviceProcAddr(device, core ? "vkCmdBeginRendering" : "vkCmdBeginRenderingKHR"),
+		.end_rendering = (PFN_vkCmdEndRendering)
+			vkGetDeviceProcAddr(device, core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR"),
+		.pipeline_barrier2 = (PFN_vkCmdPipelineBarrier2)
+			vkGetDeviceProcAddr(device, core ? "vkCmdPipelineBarrier2" : "vkCmdPipelineBarrier2KHR"),
+	};
+
+	if (!rendering->begin_rendering || !rendering->end_rendering || !rendering->pipeline_barrier2) {
+		fprintf(stderr, "[ERROR] failed to load the dynamic rendering commands\n");
+		exit(EXIT_FAILURE);
+	}
+}
+
+static VkImageMemoryBarrier2
+image_barrier(VkImage image, VkImageAspectFlags aspect, VkPipelineStageFlags2 src_stage, VkAccessFlags2 src_access,
+	VkPipelineStageFlags2 dst_stage, VkAccessFlags2 dst_access, VkImageLayout old_layout, VkImageLayout new_layout)
+{
+	return (VkImageMemoryBarrier2){
+		.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+		.srcStageMask = src_stage,
+		.srcAccessMask = src_access,
+		.dstStageMask = dst_stage,
+		.dstAccessMask = dst_access,
+		.oldLayout = old_layout,
+		.newLayout = new_layout,
+		.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+		.image = image,
+		.subresourceRange = {
+			.aspectMask = aspect,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+}
+
+void
+dynamic_rendering_begin(const Dynamic_Rendering *rendering, VkCommandBuffer command_buffer,
+	const Rendering_Target *target, const Render_Attachments *attachments, VkExtent2D extent,
+	VkClearColorValue clear_color, VkRenderingFlags flags)
+{
+	bool multisampled = attachments->samples != VK_SAMPLE_COUNT_1_BIT;
+
+	// Every image starts out UNDEFINED since none of their previous contents
+	// are needed. Each barrier only waits on what last touched its image:
+	// - A presented image is acquired by a semaphore that the submission
+	//   waits on at the color attachment output stage, so the barrier chains
+	//   onto that wait rather than blocking earlier stages.
+	// - An offscreen image was last read by the frame's previous readback
+	//   copy.
+	// - The multisampled color and depth images are shared by every frame,
+	//   so they wait on the previous frame's writes to them.
+	VkPipelineStageFlags2 target_stage = target->final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL ?
+		VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT;
+	VkImageMemoryBarrier2 barriers[3] = {
+		image_barrier(target->image, VK_IMAGE_ASPECT_COLOR_BIT,
+			target_stage, VK_ACCESS_2_NONE,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+		image_barrier(attachments->depth.handle, format_has_stencil(attachments->depth_format) ?
+				VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT : VK_IMAGE_ASPECT_DEPTH_BIT,
+			VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+			VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL),
+		image_barrier(attachments->color.handle, VK_IMAGE_ASPECT_COLOR_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL),
+	};
+	VkDependencyInfo dependency = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = multisampled ? 3 : 2,
+		.pImageMemoryBarriers = barriers,
+	};
+	rendering->pipeline_barrier2(command_buffer, &dependency);
+
+	// With multisampling, the samples are resolved into the target at the end
+	// of rendering and never stored, like the render pass's resolve
+	// attachment.
+	VkRenderingAttachmentInfo color_attachment = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.imageView = target->view,
+		.imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+		.resolveMode = VK_RESOLVE_MODE_NONE,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+		.clearValue = { .color = clear_color },
+	};
+	if (multisampled) {
+		color_attachment.imageView = attachments->color.view;
+		color_attachment.resolveMode = VK_RESOLVE_MODE_AVERAGE_BIT;
+		color_attachment.resolveImageView = target->view;
+		color_attachment.resolveImageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
+		color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+	}
+	VkRenderingAttachmentInfo depth_attachment = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+		.imageView = attachments->depth.view,
+		.imageLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL,
+		.resolveMode = VK_RESOLVE_MODE_NONE,
+		.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+		.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
+		.clearValue = { .depthStencil = { 1.0f, 0 } },
+	};
+
+	VkRenderingInfo rendering_info = {
+		.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+		.flags = flags,
+		.renderArea = {
+			.offset = {0, 0},
+			.extent = extent,
+		},
+		.layerCount = 1,
+		.colorAttachmentCount = 1,
+		.pColorAttachments = &color_attachment,
+		.pDepthAttachment = &depth_attachment,
+	};
+	rendering->begin_rendering(command_buffer, &rendering_info);
+}
+
+void
+dynamic_rendering_end(const Dynamic_Rendering *rendering, VkCommandBuffer command_buffer,
+	const Rendering_Target *target)
+{
+	rendering->end_rendering(command_buffer);
+
+	// A presented image is handed over through the semaphore that the
+	// submission signals, which waits for every prior stage anyway, while the
+	// readback copy needs the color writes made visible to it.
+	bool readback = target->final_layout == VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	VkImageMemoryBarrier2 barrier = image_barrier(target->image, VK_IMAGE_ASPECT_COLOR_BIT,
+		VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+		readback ? VK_PIPELINE_STAGE_2_COPY_BIT : VK_PIPELINE_STAGE_2_NONE,
+		readback ? VK_ACCESS_2_TRANSFER_READ_BIT : VK_ACCESS_2_NONE,
+		VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, target->final_layout);
+	VkDependencyInfo dependency = {
+		.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+		.imageMemoryBarrierCount = 1,
+		.pImageMemoryBarriers = &barrier,
+	};
+	rendering->pipeline_barrier2(command_buffer, &dependency);
+}
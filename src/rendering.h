@@ -0,0 +1,65 @@
+#ifndef RENDERING_H
+#define RENDERING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "attachments.h"
+
+typedef enum {
+	// Pick the dynamic rendering backend if the device supports it.
+	RENDERING_BACKEND_AUTO,
+
+	// A VkRenderPass, and a VkFramebuffer per swapchain or offscreen image
+	// that's rebuilt along with the swapchain. Its subpass dependencies and
+	// attachment layouts stand in for barriers.
+	RENDERING_BACKEND_RENDER_PASS,
+
+	// vkCmdBeginRendering() straight on image views, from Vulkan 1.3 or
+	// VK_KHR_dynamic_rendering, with layout transitions recorded as explicit
+	// VK_KHR_synchronization2 barriers. There are no framebuffers to rebuild.
+	RENDERING_BACKEND_DYNAMIC,
+} Rendering_Backend;
+
+// The commands of dynamic rendering and synchronization2, which are core in
+// Vulkan 1.3 and otherwise come from the KHR extensions under other names.
+typedef struct {
+	PFN_vkCmdBeginRendering begin_rendering;
+	PFN_vkCmdEndRendering end_rendering;
+	PFN_vkCmdPipelineBarrier2 pipeline_barrier2;
+} Dynamic_Rendering;
+
+// The image a frame renders to, i.e. what a framebuffer's own attachment is
+// to the render pass backend.
+typedef struct {
+	VkImage image;
+	VkImageView view;
+
+	// Presented images end in VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, and offscreen
+	// ones in VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL for their readback copy.
+	VkImageLayout final_layout;
+} Rendering_Target;
+
+const char *rendering_backend_name(Rendering_Backend backend);
+
+// Load the commands for a device created with dynamicRendering and
+// synchronization2, either from core Vulkan 1.3 or the extensions.
+void dynamic_rendering_load(Dynamic_Rendering *rendering, VkDevice device, bool core);
+
+// Transition the target and `attachments` for rendering, and begin rendering
+// to them, clearing color to `clear_color` and depth to the far plane. The
+// attachments are laid out like the render pass backend's: the target is
+// resolved into from the multisampled color image, if any. `flags` may ask for
+// the contents to come from secondary command buffers.
+void dynamic_rendering_begin(const Dynamic_Rendering *rendering, VkCommandBuffer command_buffer,
+	const Rendering_Target *target, const Render_Attachments *attachments, VkExtent2D extent,
+	VkClearColorValue clear_color, VkRenderingFlags flags);
+
+// End rendering, and transition the target into its final layout for
+// presentation or readback.
+void dynamic_rendering_end(const Dynamic_Rendering *rendering, VkCommandBuffer command_buffer,
+	const Rendering_Target *target);
+
+#endif
@@ -0,0 +1,223 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "debug.h"
+#include "file.h"
+#include "shader.h"
+
+#define SPIRV_MAGIC	0x07230203
+
+// A SPIR-V module starts with five words: the magic number, the version, the
+// generator, the bound on IDs, and a reserved word.
+#define SPIRV_HEADER_LENGTH	(5 * sizeof(uint32_t))
+
+// 64-bit FNV-1a.
+static uint64_t
+hash_code(const uint32_t *code, size_t size)
+{
+	const unsigned char *bytes = (const unsigned char *)code;
+	uint64_t hash = 0xcbf29ce484222325;
+	for (size_t i = 0; i < size; ++i) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3;
+	}
+	return hash;
+}
+
+void
+shader_cache_init(Shader_Cache *cache, VkDevice device, bool use_identifiers)
+{
+	memset(cache, 0, sizeof(Shader_Cache));
+	cache->device = device;
+
+	if (use_identifiers) {
+		cache->get_identifier = (PFN_vkGetShaderModuleCreateInfoIdentifierEXT)
+			vkGetDeviceProcAddr(device, "vkGetShaderModuleCreateInfoIdentifierEXT");
+	}
+}
+
+void
+shader_cache_destroy(Shader_Cache *cache)
+{
+	for (size_t i = 0; i < SHADER_CACHE_CAPACITY; ++i) {
+		Shader *shader = &cache->shaders[i];
+		if (!shader->code) continue;
+
+		vkDestroyShaderModule(cache->device, shader->module, NULL);
+		unmap_file(&shader->file);
+	}
+	memset(cache->shaders, 0, sizeof(cache->shaders));
+	cache->n_shaders = 0;
+}
+
+// Map SPIR-V code from a file. The code is used in place from the mapping,
+// without copies, so it's validated up front: vkCreateShaderModule() requires
+// pCode to be 4-byte aligned and its size a multiple of 4. Hashing the code
+// also faults in every page of it.
+void
+shader_code_read(const char *filename, Shader_Code *code)
+{
+	if (!shader_code_read_optional(filename, code)) {
+		fprintf(stderr, "[ERROR] failed to map shader %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+}
+
+// Like shader_code_read(), for shaders the renderer can do without: return
+// false if the file can't be mapped. A file that isn't SPIR-V is still fatal.
+bool
+shader_code_read_optional(const char *filename, Shader_Code *code)
+{
+	Mapped_File file = {0};
+	if (!map_file(filename, &file)) return false;
+
+	const uint32_t *words = file.contents;
+	if (file.length < SPIRV_HEADER_LENGTH || file.length % sizeof(uint32_t) != 0 ||
+			(uintptr_t)words % sizeof(uint32_t) != 0) {
+		fprintf(stderr, "[ERROR] shader %s is not a word-aligned SPIR-V module\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	if (words[0] != SPIRV_MAGIC) {
+		fprintf(stderr, "[ERROR] shader %s lacks the SPIR-V magic number\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	*code = (Shader_Code){
+		.file = file,
+		.code = words,
+		.size = file.length,
+		.hash = hash_code(words, file.length),
+	};
+	return true;
+}
+
+void
+shader_code_free(Shader_Code *code)
+{
+	unmap_file(&code->file);
+	*code = (Shader_Code){0};
+}
+
+// Add code to the cache, which takes ownership of it, or return the cached
+// shader with the same code and free the duplicate.
+Shader *
+shader_cache_add(Shader_Cache *cache, Shader_Code *code, const char *filename)
+{
+	// Probe linearly from the hash's home slot for the same code or a free
+	// slot. The code may sit past a removed shader's slot, so the first of
+	// those is only taken once the code is known not to be cached.
+	uint64_t hash = code->hash;
+	Shader *free_slot = NULL;
+	for (uint32_t i = 0; i < SHADER_CACHE_CAPACITY; ++i) {
+		Shader *shader = &cache->shaders[(hash + i) & (SHADER_CACHE_CAPACITY - 1)];
+
+		if (shader->code && shader->hash == hash && shader->size == code->size &&
+				memcmp(shader->code, code->code, code->size) == 0) {
+			shader_code_free(code);
+			return shader;
+		}
+
+		if (!shader->code && !free_slot) free_slot = shader;
+		if (!shader->code && !shader->removed) break;
+	}
+
+	if (!free_slot) {
+		fprintf(stderr, "[ERROR] shader cache is full, failed to load %s\n", filename);
+		exit(EXIT_FAILURE);
+	}
+
+	Shader *shader = free_slot;
+	*shader = (Shader){
+		.file = code->file,
+		.code = code->code,
+		.size = code->size,
+		.hash = hash,
+		.identifier = { .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_IDENTIFIER_EXT },
+	};
+	*code = (Shader_Code){0};
+
+	// The identifier is derived from the code alone, so it's available
+	// without creating the module.
+	if (cache->get_identifier) {
+		VkShaderModuleCreateInfo module_info = {
+			.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+			.codeSize = shader->size,
+			.pCode = shader->code,
+		};
+		cache->get_identifier(cache->device, &module_info, &shader->identifier);
+	}
+
+	++cache->n_shaders;
+	return shader;
+}
+
+// Load SPIR-V code from a file, or return the cached shader with the same
+// code.
+Shader *
+shader_cache_load(Shader_Cache *cache, const char *filename)
+{
+	Shader_Code code = {0};
+	shader_code_read(filename, &code);
+	return shader_cache_add(cache, &code, filename);
+}
+
+// Destroy the shader's module and unmap its code, and free its slot for
+// another shader. No pipeline that's compiling or in use may refer to it.
+void
+shader_cache_remove(Shader_Cache *cache, Shader *shader)
+{
+	assert(shader->code);
+
+	vkDestroyShaderModule(cache->device, shader->module, NULL);
+	unmap_file(&shader->file);
+	*shader = (Shader){ .removed = true };
+	--cache->n_shaders;
+}
+
+VkShaderModule
+shader_get_module(Shader_Cache *cache, Shader *shader)
+{
+	if (shader->module != VK_NULL_HANDLE) return shader->module;
+
+	VkShaderModuleCreateInfo module_info = {
+		.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+		.codeSize = shader->size,
+		.pCode = shader->code,
+	};
+	if (vkCreateShaderModule(cache->device, &module_info, NULL, &shader->module) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create shader module\n");
+		exit(EXIT_FAILURE);
+	}
+
+	return shader->module;
+}
+
+// Describe a pipeline stage running the shader's `main` entry point. By
+// identifier, the stage refers to the shader without a module, and
+// `identifier_info` is chained onto it; pipeline creation must then pass
+// VK_PIPELINE_CREATE_FAIL_ON_PIPELINE_COMPILE_REQUIRED_BIT and fall back to
+// modules if the pipeline cache misses.
+void
+shader_stage_info(Shader_Cache *cache, Shader *shader, VkShaderStageFlagBits stage, bool by_identifier,
+	VkPipelineShaderStageCreateInfo *stage_info, VkPipelineShaderStageModuleIdentifierCreateInfoEXT *identifier_info)
+{
+	by_identifier = by_identifier && shader->identifier.identifierSize > 0;
+
+	*identifier_info = (VkPipelineShaderStageModuleIdentifierCreateInfoEXT){
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_MODULE_IDENTIFIER_CREATE_INFO_EXT,
+		.identifierSize = shader->identifier.identifierSize,
+		.pIdentifier = shader->identifier.identifier,
+	};
+	*stage_info = (VkPipelineShaderStageCreateInfo){
+		.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+		.pNext = by_identifier ? identifier_info : NULL,
+		.stage = stage,
+		.module = by_identifier ? VK_NULL_HANDLE : shader_get_module(cache, shader),
+		.pName = "main",
+	};
+}
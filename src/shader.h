@@ -0,0 +1,69 @@
+#ifndef SHADER_H
+#define SHADER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "file.h"
+
+// Number of distinct shaders a cache holds. It must be a power of two.
+#define SHADER_CACHE_CAPACITY	64
+
+// SPIR-V code that's been mapped from its file and validated, but that isn't
+// in a cache yet. Reading code needs no device, so it can happen ahead of
+// device creation.
+typedef struct {
+	Mapped_File file;
+	const uint32_t *code;
+	size_t size;
+	uint64_t hash;
+} Shader_Code;
+
+// SPIR-V code, mapped straight from its file, along with the module created
+// from it. The module is only created once a pipeline needs it.
+typedef struct {
+	Mapped_File file;
+	const uint32_t *code;
+	size_t size;
+	uint64_t hash;
+
+	VkShaderModule module;
+
+	// With VK_EXT_shader_module_identifier, pipelines can be created from the
+	// identifier alone if the pipeline cache already holds them.
+	VkShaderModuleIdentifierEXT identifier;
+
+	// Set on a free slot that used to hold a shader, so that probing for code
+	// goes on past it.
+	bool removed;
+} Shader;
+
+// Shaders keyed by a hash of their code, so pipelines that share a stage
+// share a single VkShaderModule even if it's loaded more than once.
+typedef struct {
+	VkDevice device;
+
+	// NULL unless the device supports VK_EXT_shader_module_identifier.
+	PFN_vkGetShaderModuleCreateInfoIdentifierEXT get_identifier;
+
+	uint32_t n_shaders;
+	Shader shaders[SHADER_CACHE_CAPACITY];
+} Shader_Cache;
+
+void shader_cache_init(Shader_Cache *cache, VkDevice device, bool use_identifiers);
+void shader_cache_destroy(Shader_Cache *cache);
+
+void shader_code_read(const char *filename, Shader_Code *code);
+bool shader_code_read_optional(const char *filename, Shader_Code *code);
+void shader_code_free(Shader_Code *code);
+
+Shader *shader_cache_add(Shader_Cache *cache, Shader_Code *code, const char *filename);
+Shader *shader_cache_load(Shader_Cache *cache, const char *filename);
+void shader_cache_remove(Shader_Cache *cache, Shader *shader);
+VkShaderModule shader_get_module(Shader_Cache *cache, Shader *shader);
+void shader_stage_info(Shader_Cache *cache, Shader *shader, VkShaderStageFlagBits stage, bool by_identifier,
+	VkPipelineShaderStageCreateInfo *stage_info, VkPipelineShaderStageModuleIdentifierCreateInfoEXT *identifier_info);
+
+#endif
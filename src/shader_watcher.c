@@ -0,0 +1,219 @@
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <pthread.h>
+#include <spawn.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <vulkan/vulkan.h>
+
+#include "debug.h"
+#include "shader_watcher.h"
+#include "timer.h"
+
+// An editor's save may take several writes and renames, so the events that
+// follow the first one by less than this are handled together with it.
+#define SETTLE_TIMEOUT_MS	50
+
+extern char **environ;
+
+void
+shader_watcher_init(Shader_Watcher *watcher, const char *directory, const char *compiler)
+{
+	memset(watcher, 0, sizeof(Shader_Watcher));
+	watcher->directory = directory;
+	watcher->compiler = compiler;
+	watcher->inotify_fd = -1;
+	watcher->stop_pipe[0] = -1;
+	watcher->stop_pipe[1] = -1;
+	atomic_init(&watcher->compiled, 0);
+}
+
+// Add a source to recompile whenever it changes. The strings must outlive the
+// watcher, and sources can only be added before it starts.
+void
+shader_watcher_add(Shader_Watcher *watcher, const char *source, const char *output, VkShaderStageFlagBits stage)
+{
+	assert(watcher->inotify_fd < 0);
+	assert(watcher->n_sources < SHADER_WATCHER_MAX_SOURCES);
+	watcher->sources[watcher->n_sources++] = (Shader_Source){
+		.source = source,
+		.output = output,
+		.stage = stage,
+	};
+}
+
+static const char *
+base_name(const char *path)
+{
+	const char *slash = strrchr(path, '/');
+	return slash ? slash + 1 : path;
+}
+
+// Compile to a temporary file and rename it over the output. Besides never
+// exposing a partial file, this leaves the shader cache's mapping of the
+// previous SPIR-V intact, since that keeps the old inode alive.
+static bool
+compile_source(const Shader_Watcher *watcher, const Shader_Source *source)
+{
+	char temporary[PATH_MAX] = {0};
+	if (snprintf(temporary, sizeof(temporary), "%s.tmp", source->output) >= (int)sizeof(temporary)) {
+		fprintf(stderr, "[WARNING] shader path %s is too long\n", source->output);
+		return false;
+	}
+
+	uint64_t start = timer_now();
+
+	char *argv[] = {
+		(char *)watcher->compiler,
+		"-o", temporary,
+		(char *)source->source,
+		NULL,
+	};
+	pid_t pid = 0;
+	int error = posix_spawnp(&pid, watcher->compiler, NULL, NULL, argv, environ);
+	if (error != 0) {
+		fprintf(stderr, "[WARNING] failed to run %s: %s\n", watcher->compiler, strerror(error));
+		return false;
+	}
+
+	int status = 0;
+	while (waitpid(pid, &status, 0) < 0) {
+		if (errno != EINTR) {
+			fprintf(stderr, "[WARNING] failed to wait for %s: %s\n", watcher->compiler, strerror(errno));
+			return false;
+		}
+	}
+
+	// The compiler reports its own errors.
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+		fprintf(stderr, "[WARNING] failed to compile %s, keeping the previous shader\n", source->source);
+		unlink(temporary);
+		return false;
+	}
+
+	if (rename(temporary, source->output) != 0) {
+		fprintf(stderr, "[WARNING] failed to replace %s: %s\n", source->output, strerror(errno));
+		unlink(temporary);
+		return false;
+	}
+
+	printf("[INFO] compiled %s in %.3f ms\n", source->source, timer_elapsed_ms(start, timer_now()));
+	return true;
+}
+
+// Read the pending events, and return the mask of sources they touched.
+static uint32_t
+read_events(const Shader_Watcher *watcher)
+{
+	_Alignas(struct inotify_event) char buffer[4096];
+	ssize_t length = read(watcher->inotify_fd, buffer, sizeof(buffer));
+	if (length <= 0) return 0;
+
+	uint32_t changed = 0;
+	for (ssize_t offset = 0; offset < length; ) {
+		const struct inotify_event *event = (const struct inotify_event *)&buffer[offset];
+		offset += sizeof(struct inotify_event) + event->len;
+		if (event->len == 0) continue;
+
+		for (uint32_t i = 0; i < watcher->n_sources; ++i) {
+			if (strcmp(event->name, base_name(watcher->sources[i].source)) == 0) changed |= 1u << i;
+		}
+	}
+
+	return changed;
+}
+
+static void *
+watcher_main(void *argument)
+{
+	Shader_Watcher *watcher = argument;
+
+	for (;;) {
+		struct pollfd fds[] = {
+			{ .fd = watcher->inotify_fd, .events = POLLIN },
+			{ .fd = watcher->stop_pipe[0], .events = POLLIN },
+		};
+		if (poll(fds, 2, -1) < 0) {
+			if (errno == EINTR) continue;
+			fprintf(stderr, "[WARNING] stopped watching %s: %s\n", watcher->directory, strerror(errno));
+			break;
+		}
+		if (fds[1].revents) break;
+		if (!(fds[0].revents & POLLIN)) continue;
+
+		// Let the save settle before compiling, so each source compiles once.
+		uint32_t changed = read_events(watcher);
+		while (poll(fds, 1, SETTLE_TIMEOUT_MS) > 0) changed |= read_events(watcher);
+
+		for (uint32_t i = 0; i < watcher->n_sources; ++i) {
+			if (!(changed & 1u << i)) continue;
+			if (compile_source(watcher, &watcher->sources[i])) {
+				atomic_fetch_or_explicit(&watcher->compiled, 1u << i, memory_order_release);
+			}
+		}
+	}
+
+	return NULL;
+}
+
+// Start watching. Failing to is only a warning: the shaders loaded at
+// startup keep working, they just won't be reloaded.
+bool
+shader_watcher_start(Shader_Watcher *watcher)
+{
+	watcher->inotify_fd = inotify_init1(IN_CLOEXEC);
+	if (watcher->inotify_fd < 0) {
+		fprintf(stderr, "[WARNING] failed to initialize inotify: %s\n", strerror(errno));
+		return false;
+	}
+
+	// Editors either write the file in place or rename a new one over it.
+	if (inotify_add_watch(watcher->inotify_fd, watcher->directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0) {
+		fprintf(stderr, "[WARNING] failed to watch %s: %s\n", watcher->directory, strerror(errno));
+		close(watcher->inotify_fd);
+		watcher->inotify_fd = -1;
+		return false;
+	}
+
+	if (pipe(watcher->stop_pipe) != 0 || pthread_create(&watcher->thread, NULL, watcher_main, watcher) != 0) {
+		fprintf(stderr, "[WARNING] failed to start the shader watcher thread\n");
+		if (watcher->stop_pipe[0] >= 0) close(watcher->stop_pipe[0]);
+		if (watcher->stop_pipe[1] >= 0) close(watcher->stop_pipe[1]);
+		close(watcher->inotify_fd);
+		watcher->inotify_fd = -1;
+		return false;
+	}
+
+	printf("[INFO] watching %s for shader changes\n", watcher->directory);
+	return true;
+}
+
+// Stop a started watcher, after any compilation it's running.
+void
+shader_watcher_stop(Shader_Watcher *watcher)
+{
+	char byte = 0;
+	while (write(watcher->stop_pipe[1], &byte, 1) < 0 && errno == EINTR) continue;
+	pthread_join(watcher->thread, NULL);
+
+	close(watcher->stop_pipe[0]);
+	close(watcher->stop_pipe[1]);
+	close(watcher->inotify_fd);
+}
+
+uint32_t
+shader_watcher_take(Shader_Watcher *watcher)
+{
+	// Pairs with the release in watcher_main(), so the SPIR-V the compiler
+	// wrote is complete by the time the caller maps it.
+	return (uint32_t)atomic_exchange_explicit(&watcher->compiled, 0, memory_order_acquire);
+}
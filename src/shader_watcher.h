@@ -0,0 +1,49 @@
+#ifndef SHADER_WATCHER_H
+#define SHADER_WATCHER_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+// At most one bit per source in the mask of compiled sources.
+#define SHADER_WATCHER_MAX_SOURCES	8
+
+// A GLSL source and the SPIR-V it compiles to, both relative to the working
+// directory.
+typedef struct {
+	const char *source;
+	const char *output;
+	VkShaderStageFlagBits stage;
+} Shader_Source;
+
+// Watches a directory of GLSL sources with inotify, and recompiles the ones
+// that change on a thread of its own, so that whoever renders only ever
+// picks up finished SPIR-V.
+typedef struct {
+	const char *directory;
+	const char *compiler;
+
+	uint32_t n_sources;
+	Shader_Source sources[SHADER_WATCHER_MAX_SOURCES];
+
+	int inotify_fd;
+	int stop_pipe[2];
+	pthread_t thread;
+
+	// Bit i is set once sources[i] compiled successfully, until it's taken.
+	atomic_uint_fast32_t compiled;
+} Shader_Watcher;
+
+void shader_watcher_init(Shader_Watcher *watcher, const char *directory, const char *compiler);
+void shader_watcher_add(Shader_Watcher *watcher, const char *source, const char *output,
+	VkShaderStageFlagBits stage);
+bool shader_watcher_start(Shader_Watcher *watcher);
+void shader_watcher_stop(Shader_Watcher *watcher);
+
+// Return the mask of sources compiled since the last call.
+uint32_t shader_watcher_take(Shader_Watcher *watcher);
+
+#endif
@@ -0,0 +1,73 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "debug.h"
+#include "startup.h"
+#include "timer.h"
+
+const char *
+startup_phase_name(Startup_Phase phase)
+{
+	switch (phase) {
+	case STARTUP_WINDOW: return "window";
+	case STARTUP_INSTANCE: return "instance";
+	case STARTUP_SURFACE: return "surface";
+	case STARTUP_DEVICE_SELECTION: return "device selection";
+	case STARTUP_DEVICE_CREATION: return "device creation";
+	case STARTUP_SWAPCHAIN: return "swapchain";
+	case STARTUP_SHADER_LOAD: return "shader load";
+	case STARTUP_PIPELINE_CACHE_READ: return "pipeline cache read";
+	case STARTUP_PIPELINE_CREATION: return "pipeline creation";
+	case STARTUP_SYNC_OBJECTS: return "sync objects";
+	case STARTUP_FIRST_PRESENT: return "first present";
+	default: return "unknown";
+	}
+}
+
+void
+startup_timer_init(Startup_Timer *timer)
+{
+	memset(timer, 0, sizeof(Startup_Timer));
+	timer->origin = timer_now();
+}
+
+// Only the first start of a phase counts, so a phase that's retried, e.g. the
+// first frame after an out-of-date swapchain, is timed from its first try.
+void
+startup_begin(Startup_Timer *timer, Startup_Phase phase)
+{
+	assert(phase < N_STARTUP_PHASES);
+	if (timer->start[phase] == 0) timer->start[phase] = timer_now();
+}
+
+void
+startup_end(Startup_Timer *timer, Startup_Phase phase)
+{
+	assert(phase < N_STARTUP_PHASES);
+	assert(timer->start[phase] != 0);
+	timer->end[phase] = timer_now();
+}
+
+// Print every phase that ran, in order, with when it started relative to the
+// start of the program. The phases add up to more than the time to the first
+// frame by at least however much of them overlapped; less, since the time
+// between phases doesn't count.
+void
+startup_timer_print(const Startup_Timer *timer)
+{
+	double total_ms = 0.0;
+	for (uint32_t i = 0; i < N_STARTUP_PHASES; ++i) {
+		if (timer->end[i] == 0) continue;
+
+		double duration_ms = timer_elapsed_ms(timer->start[i], timer->end[i]);
+		total_ms += duration_ms;
+		printf("[INFO] startup %-20s at %8.3f ms  took %8.3f ms\n", startup_phase_name(i),
+			timer_elapsed_ms(timer->origin, timer->start[i]), duration_ms);
+	}
+
+	if (timer->end[STARTUP_FIRST_PRESENT] == 0) return;
+	double first_frame_ms = timer_elapsed_ms(timer->origin, timer->end[STARTUP_FIRST_PRESENT]);
+	printf("[INFO] first frame after %.3f ms, with at least %.3f ms of phases overlapping\n",
+		first_frame_ms, total_ms > first_frame_ms ? total_ms - first_frame_ms : 0.0);
+}
@@ -0,0 +1,42 @@
+#ifndef STARTUP_H
+#define STARTUP_H
+
+#include <stdint.h>
+
+// The phases of startup, from main() to the first frame on screen. Phases
+// that don't depend on each other may overlap, on different threads.
+typedef enum {
+	STARTUP_WINDOW,
+	STARTUP_INSTANCE,
+	STARTUP_SURFACE,
+	STARTUP_DEVICE_SELECTION,
+	STARTUP_DEVICE_CREATION,
+	STARTUP_SWAPCHAIN,
+	STARTUP_SHADER_LOAD,
+	STARTUP_PIPELINE_CACHE_READ,
+	STARTUP_PIPELINE_CREATION,
+	STARTUP_SYNC_OBJECTS,
+
+	// Until the first frame is presented, or submitted when headless.
+	STARTUP_FIRST_PRESENT,
+
+	N_STARTUP_PHASES,
+} Startup_Phase;
+
+// Wall-clock start and end of every phase, as timer_now() timestamps. Each
+// phase belongs to a single thread, and the timer is only printed once the
+// threads are done with it.
+typedef struct {
+	uint64_t origin;
+	uint64_t start[N_STARTUP_PHASES];
+	uint64_t end[N_STARTUP_PHASES];
+} Startup_Timer;
+
+const char *startup_phase_name(Startup_Phase phase);
+
+void startup_timer_init(Startup_Timer *timer);
+void startup_begin(Startup_Timer *timer, Startup_Phase phase);
+void startup_end(Startup_Timer *timer, Startup_Phase phase);
+void startup_timer_print(const Startup_Timer *timer);
+
+#endif
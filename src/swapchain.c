@@ -0,0 +1,443 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+#include "debug.h"
+#include "swapchain.h"
+#include "util.h"
+
+// Don't wait indefinitely for a present to complete. An occluded or
+// minimized window may never display the frame at all.
+#define PRESENT_WAIT_TIMEOUT	100000000ull
+
+// The order in which presentation modes are tried for each requested mode.
+// Every list ends with VK_PRESENT_MODE_FIFO_KHR, the only mode the
+// specification guarantees.
+//
+// - FIFO waits for vertical blank and never tears.
+// - FIFO_RELAXED waits for vertical blank, but a late frame is displayed
+//   right away and may tear. It falls back to FIFO.
+// - MAILBOX waits for vertical blank without blocking the application; a new
+//   frame replaces the one queued. It falls back to FIFO rather than to a
+//   mode that tears.
+// - IMMEDIATE never waits and may tear. It falls back to the remaining modes
+//   in order of increasing latency: MAILBOX, FIFO_RELAXED and then FIFO.
+static const VkPresentModeKHR fifo_fallbacks[] = {
+	VK_PRESENT_MODE_FIFO_KHR,
+};
+static const VkPresentModeKHR fifo_relaxed_fallbacks[] = {
+	VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+	VK_PRESENT_MODE_FIFO_KHR,
+};
+static const VkPresentModeKHR mailbox_fallbacks[] = {
+	VK_PRESENT_MODE_MAILBOX_KHR,
+	VK_PRESENT_MODE_FIFO_KHR,
+};
+static const VkPresentModeKHR immediate_fallbacks[] = {
+	VK_PRESENT_MODE_IMMEDIATE_KHR,
+	VK_PRESENT_MODE_MAILBOX_KHR,
+	VK_PRESENT_MODE_FIFO_RELAXED_KHR,
+	VK_PRESENT_MODE_FIFO_KHR,
+};
+
+const char *
+present_mode_name(VkPresentModeKHR present_mode)
+{
+	switch (present_mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR: return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR: return "mailbox";
+	case VK_PRESENT_MODE_FIFO_KHR: return "fifo";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR: return "fifo-relaxed";
+	default: return "unknown";
+	}
+}
+
+typedef struct {
+	VkSurfaceCapabilitiesKHR capabilities;
+
+	uint32_t n_formats;
+	VkSurfaceFormatKHR *formats;
+
+	uint32_t n_presentation_modes;
+	VkPresentModeKHR *presentation_modes;
+} Swapchain_Support_Details;
+
+static void
+destroy_image_resources(Swapchain *swapchain)
+{
+	for (size_t i = 0; i < swapchain->n_images; ++i) {
+		if (swapchain->framebuffers) vkDestroyFramebuffer(swapchain->device, swapchain->framebuffers[i], NULL);
+		vkDestroyImageView(swapchain->device, swapchain->image_views[i], NULL);
+	}
+
+	swapchain->n_images = 0;
+	swapchain->images = NULL;
+	swapchain->image_views = NULL;
+	swapchain->framebuffers = NULL;
+	swapchain->images_in_flight = NULL;
+	arena_free(&swapchain->arena);
+}
+
+/* ---
+ * Choose the most optimal settings for the swapchain. The swap extent
+ * determines the resolution of images in the swapchain; the surface format
+ * determines their color depth; and the presentation mode determines the
+ * conditions for swapping images onto the screen.
+ * ---
+ */
+static void
+create_swapchain(Swapchain *swapchain, VkExtent2D window_extent, VkSwapchainKHR old_swapchain)
+{
+	Swapchain_Support_Details details = {0};
+
+	// The details are only needed while choosing settings, so they live on the
+	// swapchain arena just until the image arrays are allocated below.
+	Arena_Checkpoint checkpoint = arena_create_checkpoint(&swapchain->arena);
+
+	// Query selected physical device for its supported surface capabilities.
+	// The remainder of this block ensures the device supports the ones
+	// required.
+	vkGetPhysicalDeviceSurfaceCapabilitiesKHR(swapchain->physical_device, swapchain->surface,
+		&details.capabilities);
+
+	/* Determine proper resolution for swap chain images. */
+	{
+		VkSurfaceCapabilitiesKHR capabilities = details.capabilities;
+
+		if (capabilities.currentExtent.width != UINT32_MAX) {
+			swapchain->extent = capabilities.currentExtent;
+		} else {
+			swapchain->extent.width = CLAMP(window_extent.width, capabilities.minImageExtent.width,
+				capabilities.maxImageExtent.width);
+			swapchain->extent.height = CLAMP(window_extent.height, capabilities.minImageExtent.height,
+				capabilities.maxImageExtent.height);
+		}
+	}
+
+	/* Confirm supported surface formats. */
+	if (swapchain->surface_format.format == VK_FORMAT_UNDEFINED) {
+		// Get the number of supported surface formats.
+		vkGetPhysicalDeviceSurfaceFormatsKHR(swapchain->physical_device, swapchain->surface,
+			&details.n_formats, NULL);
+		if (details.n_formats == 0) {
+			fprintf(stderr, "[ERROR] the selected physical device does not support any common surface formats\n");
+			exit(EXIT_FAILURE);
+		}
+
+		// Allocate an array and store the supported surface formats in it.
+		details.formats = arena_alloc_uninitialized(&swapchain->arena, details.n_formats * sizeof(VkSurfaceFormatKHR));
+		assert(details.formats);
+		vkGetPhysicalDeviceSurfaceFormatsKHR(swapchain->physical_device, swapchain->surface,
+			&details.n_formats, details.formats);
+
+		// Ideally, choose an SRGB color space because for more accurate color
+		// production. Otherwise, default to whichever color space is available.
+		for (size_t i = 0; i < details.n_formats; ++i) {
+			VkSurfaceFormatKHR this_format = details.formats[i];
+			if (this_format.format == VK_FORMAT_B8G8R8A8_SRGB &&
+					this_format.colorSpace == VK_COLOR_SPACE_SRGB_NONLINEAR_KHR) {
+				swapchain->surface_format = this_format;
+				break;
+			}
+		}
+		if (swapchain->surface_format.format == VK_FORMAT_UNDEFINED) {
+			swapchain->surface_format = details.formats[0];
+		}
+	}
+	// NOTE The surface format is chosen once and kept across recreations
+	// because the render pass and the pipeline are built against it.
+
+	/* Confirm supported present modes. */
+	{
+		// Get the number of supported present modes.
+		vkGetPhysicalDeviceSurfacePresentModesKHR(swapchain->physical_device, swapchain->surface,
+			&details.n_presentation_modes, NULL);
+
+		// Allocate an array and store the supported present modes in it.
+		details.presentation_modes = arena_alloc_uninitialized(&swapchain->arena,
+			details.n_presentation_modes * sizeof(VkPresentModeKHR));
+		assert(details.presentation_modes);
+		vkGetPhysicalDeviceSurfacePresentModesKHR(swapchain->physical_device, swapchain->surface,
+			&details.n_presentation_modes, details.presentation_modes);
+
+		const VkPresentModeKHR *fallbacks = NULL;
+		size_t n_fallbacks = 0;
+		switch (swapchain->requested_present_mode) {
+		case VK_PRESENT_MODE_IMMEDIATE_KHR:
+			fallbacks = immediate_fallbacks;
+			n_fallbacks = sizeof(immediate_fallbacks) / sizeof(VkPresentModeKHR);
+			break;
+		case VK_PRESENT_MODE_MAILBOX_KHR:
+			fallbacks = mailbox_fallbacks;
+			n_fallbacks = sizeof(mailbox_fallbacks) / sizeof(VkPresentModeKHR);
+			break;
+		case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+			fallbacks = fifo_relaxed_fallbacks;
+			n_fallbacks = sizeof(fifo_relaxed_fallbacks) / sizeof(VkPresentModeKHR);
+			break;
+		default:
+			fallbacks = fifo_fallbacks;
+			n_fallbacks = sizeof(fifo_fallbacks) / sizeof(VkPresentModeKHR);
+			break;
+		}
+
+		// Take the first mode in the fallback order that the surface supports.
+		// VK_PRESENT_MODE_FIFO_KHR is guaranteed, so it's the default.
+		swapchain->present_mode = VK_PRESENT_MODE_FIFO_KHR;
+		bool found = false;
+		for (size_t i = 0; i < n_fallbacks && !found; ++i) {
+			for (size_t j = 0; j < details.n_presentation_modes; ++j) {
+				if (details.presentation_modes[j] == fallbacks[i]) {
+					swapchain->present_mode = fallbacks[i];
+					found = true;
+					break;
+				}
+			}
+		}
+
+		if (swapchain->present_mode != swapchain->requested_present_mode && swapchain->handle == VK_NULL_HANDLE) {
+			fprintf(stderr, "[WARNING] present mode %s is unsupported, falling back to %s\n",
+				present_mode_name(swapchain->requested_present_mode), present_mode_name(swapchain->present_mode));
+		}
+	}
+
+	// Specify the number of images in the swapchain. This value is bounded
+	// below by the capabilities of the physical device, but it's better for
+	// performance to allow at least one additional image in the swapchain.
+	uint32_t n_images = details.capabilities.minImageCount + 1;
+	if (details.capabilities.maxImageCount > 0 && n_images > details.capabilities.maxImageCount) {
+		// NOTE A maximum image count of 0 in this case means the number of
+		// images in the swapchain is not explicitly bounded above by the
+		// device.
+		n_images = details.capabilities.maxImageCount;
+	}
+
+	VkSwapchainCreateInfoKHR swapchain_info = {
+		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
+		.surface = swapchain->surface,
+		.minImageCount = n_images,
+		.imageFormat = swapchain->surface_format.format,
+		.imageColorSpace = swapchain->surface_format.colorSpace,
+		.imageExtent = swapchain->extent,
+		.imageArrayLayers = 1,
+		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
+		.preTransform = details.capabilities.currentTransform,
+		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
+		.presentMode = swapchain->present_mode,
+		.clipped = VK_TRUE,
+
+		// A window resize invalidates the current swapchain. Handing the
+		// retired swapchain to the driver lets it reuse the old images' memory
+		// and keep presenting them until the new swapchain takes over.
+		.oldSwapchain = old_swapchain,
+
+		// NOTE This assumes indices for graphics family and presentation
+		// family are the same.
+		.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE,
+	};
+
+	arena_restore(checkpoint);
+
+	if (vkCreateSwapchainKHR(swapchain->device, &swapchain_info, NULL, &swapchain->handle) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create swapchain\n");
+		exit(EXIT_FAILURE);
+	}
+
+	vkGetSwapchainImagesKHR(swapchain->device, swapchain->handle, &swapchain->n_images, NULL);
+	swapchain->images = arena_alloc_uninitialized(&swapchain->arena, swapchain->n_images * sizeof(VkImage));
+	assert(swapchain->images);
+	vkGetSwapchainImagesKHR(swapchain->device, swapchain->handle, &swapchain->n_images, swapchain->images);
+
+	// NOTE The arena zeroes the allocation, i.e. no image is owned by a frame.
+	swapchain->images_in_flight = arena_alloc(&swapchain->arena, swapchain->n_images * sizeof(uint64_t));
+	assert(swapchain->images_in_flight);
+}
+
+/* ---
+ * Create image views.
+ *
+ * Image views are handles to the images in the swapchain -- they're used
+ * during render operations.
+ * ---
+ */
+static void
+create_image_views(Swapchain *swapchain)
+{
+	swapchain->image_views = arena_alloc(&swapchain->arena, swapchain->n_images * sizeof(VkImageView));
+	assert(swapchain->image_views);
+
+	VkImageViewCreateInfo image_view_info = {
+		.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+		.viewType = VK_IMAGE_VIEW_TYPE_2D,
+		.format = swapchain->surface_format.format,
+		.components = {
+			.r = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.g = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.b = VK_COMPONENT_SWIZZLE_IDENTITY,
+			.a = VK_COMPONENT_SWIZZLE_IDENTITY,
+		},
+		.subresourceRange = {
+			.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+			.baseMipLevel = 0,
+			.levelCount = 1,
+			.baseArrayLayer = 0,
+			.layerCount = 1,
+		},
+	};
+	for (size_t i = 0; i < swapchain->n_images; ++i) {
+		image_view_info.image = swapchain->images[i];
+		if (vkCreateImageView(swapchain->device, &image_view_info, NULL, &swapchain->image_views[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create image view\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void
+swapchain_init(Swapchain *swapchain, VkPhysicalDevice physical_device, VkDevice device, VkSurfaceKHR surface,
+	VkPresentModeKHR requested_present_mode)
+{
+	*swapchain = (Swapchain){
+		.physical_device = physical_device,
+		.device = device,
+		.surface = surface,
+		.surface_format = { .format = VK_FORMAT_UNDEFINED },
+		.requested_present_mode = requested_present_mode,
+	};
+	arena_init(&swapchain->arena, swapchain->arena_buffer, SWAPCHAIN_ARENA_LENGTH);
+}
+
+void
+swapchain_enable_present_wait(Swapchain *swapchain)
+{
+	swapchain->wait_for_present = (PFN_vkWaitForPresentKHR)vkGetDeviceProcAddr(swapchain->device,
+		"vkWaitForPresentKHR");
+}
+
+void
+swapchain_create(Swapchain *swapchain, VkExtent2D window_extent)
+{
+	create_swapchain(swapchain, window_extent, VK_NULL_HANDLE);
+	create_image_views(swapchain);
+}
+
+/* ---
+ * Create framebuffers.
+ * ---
+ */
+void
+swapchain_create_framebuffers(Swapchain *swapchain, VkRenderPass render_pass, uint32_t n_shared_attachments,
+	const VkImageView *shared_attachments)
+{
+	assert(n_shared_attachments <= SWAPCHAIN_MAX_SHARED_ATTACHMENTS);
+
+	swapchain->framebuffers = arena_alloc(&swapchain->arena, swapchain->n_images * sizeof(VkFramebuffer));
+	assert(swapchain->framebuffers);
+	for (size_t i = 0; i < swapchain->n_images; ++i) {
+		VkImageView attachments[1 + SWAPCHAIN_MAX_SHARED_ATTACHMENTS] = { swapchain->image_views[i] };
+		for (uint32_t j = 0; j < n_shared_attachments; ++j) attachments[1 + j] = shared_attachments[j];
+
+		VkFramebufferCreateInfo framebuffer_info = {
+			.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+			.renderPass = render_pass,
+			.attachmentCount = 1 + n_shared_attachments,
+			.pAttachments = attachments,
+			.width = swapchain->extent.width,
+			.height = swapchain->extent.height,
+			.layers = 1,
+		};
+
+		if (vkCreateFramebuffer(swapchain->device, &framebuffer_info, NULL,
+					&swapchain->framebuffers[i]) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create framebuffer\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+uint64_t
+swapchain_latest_submission(Swapchain *swapchain)
+{
+	uint64_t latest = 0;
+	for (size_t i = 0; i < swapchain->n_images; ++i) latest = MAX(latest, swapchain->images_in_flight[i]);
+	return latest;
+}
+
+void
+swapchain_recreate(Swapchain *swapchain, VkExtent2D window_extent)
+{
+	// The views and framebuffers of the old images are released first -- only
+	// the swapchain handle itself is needed to create its replacement.
+	destroy_image_resources(swapchain);
+
+	VkSwapchainKHR old_swapchain = swapchain->handle;
+	create_swapchain(swapchain, window_extent, old_swapchain);
+	vkDestroySwapchainKHR(swapchain->device, old_swapchain, NULL);
+	swapchain->present_id = 0;
+
+	create_image_views(swapchain);
+}
+
+void
+swapchain_destroy(Swapchain *swapchain)
+{
+	destroy_image_resources(swapchain);
+	vkDestroySwapchainKHR(swapchain->device, swapchain->handle, NULL);
+	swapchain->handle = VK_NULL_HANDLE;
+}
+
+VkResult
+swapchain_acquire(Swapchain *swapchain, VkSemaphore signal_semaphore, uint32_t *image_index)
+{
+	return vkAcquireNextImageKHR(swapchain->device, swapchain->handle, UINT64_MAX, signal_semaphore,
+		VK_NULL_HANDLE, image_index);
+}
+
+VkResult
+swapchain_present(Swapchain *swapchain, VkQueue queue, VkSemaphore wait_semaphore, uint32_t image_index)
+{
+	// NOTE IDs must increase strictly, so one is consumed even if the present
+	// below fails.
+	uint64_t present_id = ++swapchain->present_id;
+	VkPresentIdKHR present_id_info = {
+		.sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR,
+		.swapchainCount = 1,
+		.pPresentIds = &present_id,
+	};
+
+	VkPresentInfoKHR present_info = {
+		.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+		.pNext = swapchain->wait_for_present ? &present_id_info : NULL,
+		.waitSemaphoreCount = 1,
+		.pWaitSemaphores = &wait_semaphore,
+		.swapchainCount = 1,
+		.pSwapchains = &swapchain->handle,
+		.pImageIndices = &image_index,
+		.pResults = NULL,
+	};
+	return vkQueuePresentKHR(queue, &present_info);
+}
+
+void
+swapchain_pace(Swapchain *swapchain, uint32_t max_queued_presents)
+{
+	if (!swapchain->wait_for_present || max_queued_presents == 0) return;
+
+	// MAILBOX and IMMEDIATE never queue more than a frame, so there's nothing
+	// to limit.
+	if (swapchain->present_mode != VK_PRESENT_MODE_FIFO_KHR &&
+			swapchain->present_mode != VK_PRESENT_MODE_FIFO_RELAXED_KHR) {
+		return;
+	}
+
+	if (swapchain->present_id <= max_queued_presents) return;
+
+	// A timeout or an out-of-date swapchain isn't an error here. In both
+	// cases, the frame just proceeds, and the acquire reports the latter.
+	uint64_t present_id = swapchain->present_id - max_queued_presents;
+	swapchain->wait_for_present(swapchain->device, swapchain->handle, present_id, PRESENT_WAIT_TIMEOUT);
+}
@@ -0,0 +1,100 @@
+#ifndef SWAPCHAIN_H
+#define SWAPCHAIN_H
+
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "arena.h"
+
+// Backing storage for the per-image arrays of a swapchain. This comfortably
+// fits the handful of images a presentation engine hands out.
+#define SWAPCHAIN_ARENA_LENGTH	4096
+
+// Upper bound on the attachments that every framebuffer shares alongside its
+// own swapchain image.
+#define SWAPCHAIN_MAX_SHARED_ATTACHMENTS	4
+
+// A swapchain along with every object whose lifetime is tied to its images.
+// All of it is thrown away and rebuilt when the surface changes, e.g. on a
+// window resize, so it's kept apart from the rest of the renderer.
+typedef struct {
+	VkPhysicalDevice physical_device;
+	VkDevice device;
+	VkSurfaceKHR surface;
+
+	VkSwapchainKHR handle;
+	VkSurfaceFormatKHR surface_format;
+	VkPresentModeKHR present_mode;
+	VkExtent2D extent;
+
+	// The presentation mode asked for by the user. The mode in use above may
+	// differ if the surface doesn't support this one.
+	VkPresentModeKHR requested_present_mode;
+
+	// Presentation pacing through VK_KHR_present_id and VK_KHR_present_wait.
+	// The function is NULL when the device doesn't support them. IDs are per
+	// swapchain, so the counter restarts whenever the swapchain is rebuilt.
+	PFN_vkWaitForPresentKHR wait_for_present;
+	uint64_t present_id;
+
+	uint32_t n_images;
+	VkImage *images;
+	VkImageView *image_views;
+	VkFramebuffer *framebuffers;
+
+	// The submission that last rendered to each image, or 0 if none has yet;
+	// see Frame_Sync. Acquire may return images out of order, and there may be
+	// more images than frames in flight, so a frame must wait on whichever
+	// submission owns its image before reusing it.
+	uint64_t *images_in_flight;
+
+	// The arrays above are allocated from this arena. It's reset on every
+	// recreation, so swapchain churn never leaks into the global arena.
+	Arena arena;
+	unsigned char arena_buffer[SWAPCHAIN_ARENA_LENGTH];
+} Swapchain;
+
+const char *present_mode_name(VkPresentModeKHR present_mode);
+
+void swapchain_init(Swapchain *swapchain, VkPhysicalDevice physical_device, VkDevice device,
+	VkSurfaceKHR surface, VkPresentModeKHR requested_present_mode);
+
+// Tag every present with an ID so swapchain_pace() can wait on it. The device
+// must have been created with VK_KHR_present_id and VK_KHR_present_wait.
+void swapchain_enable_present_wait(Swapchain *swapchain);
+
+// Create the swapchain and its image views. The window extent is only used
+// when the surface lets the application choose the resolution.
+void swapchain_create(Swapchain *swapchain, VkExtent2D window_extent);
+
+// Framebuffers need a render pass, which in turn needs the surface format of
+// the swapchain, so they're created separately after swapchain_create() and
+// after every swapchain_recreate(). Each framebuffer has its swapchain image
+// as attachment 0, followed by the attachments shared by all of them, e.g. a
+// multisampled color image, which must match the new extent.
+void swapchain_create_framebuffers(Swapchain *swapchain, VkRenderPass render_pass, uint32_t n_shared_attachments,
+	const VkImageView *shared_attachments);
+
+// Return the latest submission that renders to any image of the swapchain,
+// or 0 if there's none.
+uint64_t swapchain_latest_submission(Swapchain *swapchain);
+
+// Rebuild the swapchain for the current state of the surface, without its
+// framebuffers. The caller must ensure the GPU no longer uses any of the old
+// images.
+void swapchain_recreate(Swapchain *swapchain, VkExtent2D window_extent);
+
+void swapchain_destroy(Swapchain *swapchain);
+
+VkResult swapchain_acquire(Swapchain *swapchain, VkSemaphore signal_semaphore, uint32_t *image_index);
+VkResult swapchain_present(Swapchain *swapchain, VkQueue queue, VkSemaphore wait_semaphore,
+	uint32_t image_index);
+
+// Block until no more than `max_queued_presents` frames wait to be displayed.
+// Calling this before sampling input for a new frame keeps input-to-photon
+// latency low in the FIFO modes, where frames otherwise pile up behind vsync.
+// It does nothing without present wait support or in the other modes.
+void swapchain_pace(Swapchain *swapchain, uint32_t max_queued_presents);
+
+#endif
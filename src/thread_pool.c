@@ -0,0 +1,119 @@
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "debug.h"
+#include "thread_pool.h"
+#include "util.h"
+
+// One fewer worker than there are CPUs since the main thread keeps running
+// too, e.g. to render while the pool compiles pipelines.
+uint32_t
+thread_pool_default_threads(void)
+{
+	long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n_cpus < 2) return 1;
+	return MIN((uint32_t)n_cpus - 1, THREAD_POOL_MAX_THREADS);
+}
+
+static void *
+worker_main(void *argument)
+{
+	Thread_Pool *pool = argument;
+
+	pthread_mutex_lock(&pool->mutex);
+	for (;;) {
+		while (pool->n_queued == 0 && !pool->stopping) {
+			pthread_cond_wait(&pool->job_available, &pool->mutex);
+		}
+
+		// Drain the queue before stopping so no submitted job is lost.
+		if (pool->n_queued == 0) break;
+
+		Job job = pool->jobs[pool->head];
+		pool->head = (pool->head + 1) % THREAD_POOL_QUEUE_LENGTH;
+		--pool->n_queued;
+		++pool->n_running;
+
+		pthread_mutex_unlock(&pool->mutex);
+		job.function(job.argument);
+		pthread_mutex_lock(&pool->mutex);
+
+		--pool->n_running;
+		pthread_cond_broadcast(&pool->job_finished);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
+}
+
+void
+thread_pool_init(Thread_Pool *pool, uint32_t n_threads)
+{
+	*pool = (Thread_Pool){0};
+	pthread_mutex_init(&pool->mutex, NULL);
+	pthread_cond_init(&pool->job_available, NULL);
+	pthread_cond_init(&pool->job_finished, NULL);
+
+	n_threads = CLAMP(n_threads, 1, THREAD_POOL_MAX_THREADS);
+	for (uint32_t i = 0; i < n_threads; ++i) {
+		if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+			fprintf(stderr, "[ERROR] failed to create worker thread\n");
+			exit(EXIT_FAILURE);
+		}
+		++pool->n_threads;
+	}
+}
+
+// Finish every queued job, and then join the workers.
+void
+thread_pool_destroy(Thread_Pool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	pool->stopping = true;
+	pthread_cond_broadcast(&pool->job_available);
+	pthread_mutex_unlock(&pool->mutex);
+
+	for (uint32_t i = 0; i < pool->n_threads; ++i) {
+		pthread_join(pool->threads[i], NULL);
+	}
+
+	pthread_cond_destroy(&pool->job_finished);
+	pthread_cond_destroy(&pool->job_available);
+	pthread_mutex_destroy(&pool->mutex);
+}
+
+// Queue a job. This blocks while the queue is full.
+void
+thread_pool_submit(Thread_Pool *pool, Job_Function function, void *argument)
+{
+	pthread_mutex_lock(&pool->mutex);
+	assert(!pool->stopping);
+
+	while (pool->n_queued == THREAD_POOL_QUEUE_LENGTH) {
+		pthread_cond_wait(&pool->job_finished, &pool->mutex);
+	}
+
+	uint32_t tail = (pool->head + pool->n_queued) % THREAD_POOL_QUEUE_LENGTH;
+	pool->jobs[tail] = (Job){
+		.function = function,
+		.argument = argument,
+	};
+	++pool->n_queued;
+
+	pthread_cond_signal(&pool->job_available);
+	pthread_mutex_unlock(&pool->mutex);
+}
+
+void
+thread_pool_wait_idle(Thread_Pool *pool)
+{
+	pthread_mutex_lock(&pool->mutex);
+	while (pool->n_queued > 0 || pool->n_running > 0) {
+		pthread_cond_wait(&pool->job_finished, &pool->mutex);
+	}
+	pthread_mutex_unlock(&pool->mutex);
+}
@@ -0,0 +1,46 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define THREAD_POOL_MAX_THREADS		16
+#define THREAD_POOL_QUEUE_LENGTH	256
+
+typedef void (*Job_Function)(void *argument);
+
+typedef struct {
+	Job_Function function;
+	void *argument;
+} Job;
+
+// A fixed set of worker threads that run jobs from a FIFO queue.
+typedef struct {
+	pthread_t threads[THREAD_POOL_MAX_THREADS];
+	uint32_t n_threads;
+
+	pthread_mutex_t mutex;
+	pthread_cond_t job_available;
+	pthread_cond_t job_finished;
+
+	// A ring of queued jobs.
+	Job jobs[THREAD_POOL_QUEUE_LENGTH];
+	uint32_t head;
+	uint32_t n_queued;
+
+	// Jobs that a worker has taken off the queue but not yet finished.
+	uint32_t n_running;
+
+	bool stopping;
+} Thread_Pool;
+
+uint32_t thread_pool_default_threads(void);
+
+void thread_pool_init(Thread_Pool *pool, uint32_t n_threads);
+void thread_pool_destroy(Thread_Pool *pool);
+
+void thread_pool_submit(Thread_Pool *pool, Job_Function function, void *argument);
+void thread_pool_wait_idle(Thread_Pool *pool);
+
+#endif
@@ -0,0 +1,32 @@
+#include <errno.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "timer.h"
+
+uint64_t
+timer_now(void)
+{
+	struct timespec ts = {0};
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// NOTE An absolute deadline on the same clock as timer_now() doesn't drift
+// when the sleep is interrupted and restarted, and Linux backs it with a
+// high-resolution timer that wakes within tens of microseconds of it.
+void
+timer_sleep_until(uint64_t deadline)
+{
+	struct timespec ts = {
+		.tv_sec = deadline / 1000000000ull,
+		.tv_nsec = deadline % 1000000000ull,
+	};
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+}
+
+double
+timer_elapsed_ms(uint64_t start, uint64_t end)
+{
+	return (double)(end - start) / 1e6;
+}
@@ -0,0 +1,16 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stdint.h>
+
+// Return a monotonic timestamp in nanoseconds. Only differences between two
+// timestamps are meaningful.
+uint64_t timer_now(void);
+
+double timer_elapsed_ms(uint64_t start, uint64_t end);
+
+// Sleep until the given timestamp from timer_now(), or return right away if
+// it's already past.
+void timer_sleep_until(uint64_t deadline);
+
+#endif
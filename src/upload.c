@@ -0,0 +1,232 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "debug.h"
+#include "gpu_memory.h"
+#include "upload.h"
+#include "util.h"
+
+// Alignment of every allocation in the staging ring. Copies don't require
+// any, but it keeps the CPU's writes on whole cache lines.
+#define STAGING_ALIGNMENT	64
+
+void
+uploader_create(Uploader *uploader, Gpu_Allocator *allocator, uint32_t queue_family, VkQueue queue,
+	VkDeviceSize staging_size)
+{
+	VkDevice device = allocator->device;
+	*uploader = (Uploader){
+		.device = device,
+		.allocator = allocator,
+		.queue = queue,
+	};
+
+	// Coherent memory spares explicit flushes of the staged data.
+	uploader->ring.buffer = gpu_buffer_create(allocator, staging_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 0, 0, NULL);
+	assert(uploader->ring.buffer.allocation.mapped);
+
+	VkCommandPoolCreateInfo pool_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+		.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+		.queueFamilyIndex = queue_family,
+	};
+	if (vkCreateCommandPool(device, &pool_info, NULL, &uploader->command_pool) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to create upload command pool\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkCommandBuffer command_buffers[UPLOAD_BATCHES] = {0};
+	VkCommandBufferAllocateInfo command_buffer_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+		.commandPool = uploader->command_pool,
+		.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+		.commandBufferCount = UPLOAD_BATCHES,
+	};
+	if (vkAllocateCommandBuffers(device, &command_buffer_info, command_buffers) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to allocate upload command buffers\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkFenceCreateInfo fence_info = {
+		.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO,
+	};
+	for (size_t i = 0; i < UPLOAD_BATCHES; ++i) {
+		uploader->batches[i].command_buffer = command_buffers[i];
+		if (vkCreateFence(device, &fence_info, NULL, &uploader->batches[i].fence) != VK_SUCCESS) {
+			fprintf(stderr, "[ERROR] failed to create upload fence\n");
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+void
+uploader_destroy(Uploader *uploader)
+{
+	uploader_wait_idle(uploader);
+
+	for (size_t i = 0; i < UPLOAD_BATCHES; ++i) {
+		vkDestroyFence(uploader->device, uploader->batches[i].fence, NULL);
+	}
+	vkDestroyCommandPool(uploader->device, uploader->command_pool, NULL);
+	gpu_buffer_destroy(uploader->allocator, &uploader->ring.buffer);
+}
+
+// Wait for a submitted batch and release its part of the staging ring.
+static void
+complete_batch(Uploader *uploader, Upload_Batch *batch)
+{
+	assert(batch->pending);
+	vkWaitForFences(uploader->device, 1, &batch->fence, VK_TRUE, UINT64_MAX);
+	batch->pending = false;
+	uploader->ring.tail = MAX(uploader->ring.tail, batch->ring_end);
+}
+
+// Complete the oldest batch in flight. Batches are submitted in order, so
+// it's the first pending one starting from the current batch, which was
+// submitted the longest ago if it's still in flight. Returns false if no
+// batch is in flight.
+static bool
+complete_oldest_batch(Uploader *uploader)
+{
+	for (uint32_t i = 0; i < UPLOAD_BATCHES; ++i) {
+		Upload_Batch *batch = &uploader->batches[(uploader->current_batch + i) % UPLOAD_BATCHES];
+		if (batch->pending) {
+			complete_batch(uploader, batch);
+			return true;
+		}
+	}
+	return false;
+}
+
+// Reserve `size` bytes in the staging ring, and return their offset into
+// the staging buffer. If the ring is full, this waits for earlier batches,
+// submitting the current one first if it holds the space.
+static VkDeviceSize
+staging_reserve(Uploader *uploader, VkDeviceSize size)
+{
+	Staging_Ring *ring = &uploader->ring;
+	assert(size <= ring->buffer.size);
+
+	for (;;) {
+		// Restart at the beginning of the buffer whenever the ring is empty,
+		// so the counters stay small and allocations rarely wrap.
+		if (ring->tail == ring->head) ring->head = ring->tail = 0;
+
+		// An allocation must not straddle the end of the buffer since copies
+		// read a contiguous range.
+		VkDeviceSize head = (ring->head + STAGING_ALIGNMENT - 1) & ~(VkDeviceSize)(STAGING_ALIGNMENT - 1);
+		VkDeviceSize wrapped = head % ring->buffer.size;
+		if (wrapped + size > ring->buffer.size) head += ring->buffer.size - wrapped;
+
+		if (head + size - ring->tail <= ring->buffer.size) {
+			ring->head = head + size;
+			return head % ring->buffer.size;
+		}
+
+		if (!complete_oldest_batch(uploader)) {
+			assert(uploader->batches[uploader->current_batch].recording);
+			uploader_submit(uploader);
+		}
+	}
+}
+
+// Start recording the current batch if it isn't already.
+static Upload_Batch *
+begin_batch(Uploader *uploader)
+{
+	Upload_Batch *batch = &uploader->batches[uploader->current_batch];
+	if (batch->recording) return batch;
+
+	// The batch may still be in flight from the previous trip around.
+	if (batch->pending) complete_batch(uploader, batch);
+
+	vkResetCommandBuffer(batch->command_buffer, 0);
+	VkCommandBufferBeginInfo begin_info = {
+		.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+		.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+	};
+	if (vkBeginCommandBuffer(batch->command_buffer, &begin_info) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to begin recording upload command buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	batch->recording = true;
+	batch->ring_end = uploader->ring.head;
+	return batch;
+}
+
+// Copy `size` bytes of `data` to `destination` at `offset`. The copy is only
+// recorded; it executes once the current batch is submitted. Uploads larger
+// than the staging ring are split into several copies.
+void
+uploader_upload_buffer(Uploader *uploader, VkBuffer destination, VkDeviceSize offset, const void *data,
+	VkDeviceSize size)
+{
+	const unsigned char *bytes = data;
+	while (size > 0) {
+		VkDeviceSize chunk_size = MIN(size, uploader->ring.buffer.size);
+
+		// Reserve first: a full ring may force the current batch out, in which
+		// case the copy is recorded into the next one.
+		VkDeviceSize staging_offset = staging_reserve(uploader, chunk_size);
+		Upload_Batch *batch = begin_batch(uploader);
+		memcpy((unsigned char *)uploader->ring.buffer.allocation.mapped + staging_offset, bytes, chunk_size);
+
+		VkBufferCopy region = {
+			.srcOffset = staging_offset,
+			.dstOffset = offset,
+			.size = chunk_size,
+		};
+		vkCmdCopyBuffer(batch->command_buffer, uploader->ring.buffer.handle, destination, 1, &region);
+		batch->ring_end = uploader->ring.head;
+
+		bytes += chunk_size;
+		offset += chunk_size;
+		size -= chunk_size;
+		uploader->bytes_uploaded += chunk_size;
+	}
+}
+
+// Submit the copies recorded so far to the transfer queue.
+void
+uploader_submit(Uploader *uploader)
+{
+	Upload_Batch *batch = &uploader->batches[uploader->current_batch];
+	if (!batch->recording) return;
+
+	if (vkEndCommandBuffer(batch->command_buffer) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to record upload command buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	VkSubmitInfo submit_info = {
+		.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+		.commandBufferCount = 1,
+		.pCommandBuffers = &batch->command_buffer,
+	};
+	vkResetFences(uploader->device, 1, &batch->fence);
+	if (vkQueueSubmit(uploader->queue, 1, &submit_info, batch->fence) != VK_SUCCESS) {
+		fprintf(stderr, "[ERROR] failed to submit upload command buffer\n");
+		exit(EXIT_FAILURE);
+	}
+
+	batch->recording = false;
+	batch->pending = true;
+	uploader->current_batch = (uploader->current_batch + 1) % UPLOAD_BATCHES;
+}
+
+// Submit outstanding copies and wait until all of them have completed, after
+// which the uploaded buffers may be used on any queue.
+void
+uploader_wait_idle(Uploader *uploader)
+{
+	uploader_submit(uploader);
+	while (complete_oldest_batch(uploader)) {}
+}
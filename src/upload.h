@@ -0,0 +1,65 @@
+#ifndef UPLOAD_H
+#define UPLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <vulkan/vulkan.h>
+
+#include "buffer.h"
+#include "gpu_memory.h"
+
+// Number of upload submissions that may be in flight at once. While the GPU
+// copies out of the staging ring for one batch, the CPU fills the next.
+#define UPLOAD_BATCHES	4
+
+typedef struct {
+	VkCommandBuffer command_buffer;
+	VkFence fence;
+
+	// Position in the staging ring just past the data staged for this batch.
+	// Once the batch completes, the ring may reuse everything before it.
+	VkDeviceSize ring_end;
+
+	bool recording;
+	bool pending;
+} Upload_Batch;
+
+// Host-visible memory that uploads are staged in before they're copied to
+// device-local memory. It stays mapped for its entire lifetime.
+//
+// The head and the tail count bytes since the ring was last empty, so the
+// difference between them is the number of bytes in use; the offset into
+// the buffer is the count modulo its size.
+typedef struct {
+	Gpu_Buffer buffer;
+	VkDeviceSize head;
+	VkDeviceSize tail;
+} Staging_Ring;
+
+// Copies data into device-local buffers through a staging ring on the
+// transfer queue.
+typedef struct {
+	VkDevice device;
+	Gpu_Allocator *allocator;
+	VkQueue queue;
+	VkCommandPool command_pool;
+
+	Staging_Ring ring;
+	Upload_Batch batches[UPLOAD_BATCHES];
+	uint32_t current_batch;
+
+	// Total number of bytes uploaded, for statistics.
+	VkDeviceSize bytes_uploaded;
+} Uploader;
+
+void uploader_create(Uploader *uploader, Gpu_Allocator *allocator, uint32_t queue_family, VkQueue queue,
+	VkDeviceSize staging_size);
+void uploader_destroy(Uploader *uploader);
+
+void uploader_upload_buffer(Uploader *uploader, VkBuffer destination, VkDeviceSize offset, const void *data,
+	VkDeviceSize size);
+void uploader_submit(Uploader *uploader);
+void uploader_wait_idle(Uploader *uploader);
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef UTIL_H
+#define UTIL_H
+
+#define MAX(a, b)	(a > b ? a : b)
+#define MIN(a, b)	(a < b ? a : b)
+#define CLAMP(n, low, high)	MIN(high, MAX(low, n))
+
+#endif